@@ -1,45 +1,63 @@
 #include "json.hpp"
+#include "runtime.h"
+#include <climits>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <optional>
-#include <regex>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(__linux__) && defined(__x86_64__)
+#include <sys/mman.h>
+#endif
 using json = nlohmann::json;
 using namespace std;
 namespace fs = std::filesystem;
 
-struct ValueHolder;
-
 string resolveImportPath(const string& currentFilePath, const string& importFilePath) {
     fs::path base = fs::path(currentFilePath).parent_path(); // path ของไฟล์แม่
     fs::path full = base / importFilePath;                   // join path ใหม่
     return fs::absolute(full).string();                      // คืน path แบบเต็ม
 }
 
+// value is a slice of the source buffer passed to lexer(), which must stay
+// alive as long as the tokens and the AST built from them. For STRING_VALUE
+// it is the raw text between the quotes; see unescapeStringLiteral().
 struct Token {
-	string type;
-	string value;
+	TokenType type;
 	int line;
 	int column;
+	string_view value;
 };
 
 
 std::filesystem::path getExeDir() {
+#ifdef _WIN32
     char buffer[MAX_PATH];
     GetModuleFileNameA(NULL, buffer, MAX_PATH);
+#else
+    char buffer[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", buffer, sizeof buffer - 1);
+    buffer[length < 0 ? 0 : length] = '\0';
+#endif
     return std::filesystem::path(buffer).parent_path();
 }
 
@@ -49,90 +67,42 @@ public:
 	Token token;
 	ASTNode(const Token &t) :
 		token(t) {}
+	// the node as json text: what mmt file.thl out.json writes and what an
+	// imported module is read back from (nodeFromJson)
 	virtual string print() const = 0;
 	virtual ~ASTNode() = default;
 };
-string ast_json(string content);
-
-using Value = std::shared_ptr<ValueHolder>;
-string valueToString(const Value& val); // ประกาศก่อน เพราะใช้แบบเรียกซ้ำได้
+string ast_json(const string &content);
+string unescapeStringLiteral(string_view raw);
 
 using ASTNodePtr = shared_ptr<ASTNode>; // to manage memory
-struct functionDef {
-	string name;
-	vector<string> parameter;
-	json body;
-};
 
-Value evalFunctionFromParts(const vector<string> &params, const json &body,
-							const vector<Value> &args);
+ASTNodePtr nodeFromJson(const json &j);
+Value evalFunctionFromParts(const functionDef &def, size_t argc);
 
  //shared_ptr<ASTNode> parseFunctionFromJSON(const json &j);
 
-Value evalFunctionFromNode(const json &funcNode, const vector<Value> &args);
-void evalProgram(const json &programAST);
+void evalProgram(const ASTNodePtr &programAST, bool entry);
+void runProgram(ExecNodePtr lowered, bool entry);
 
-struct ValueHolder {
-	using ArraY = vector<Value>;
-	using ObjecT = unordered_map<string, Value>;
-	variant<monostate, int, double, string, bool, ArraY, ObjecT> data;
-	ValueHolder() = default;
-	ValueHolder(const decltype(data) &d) :
-		data(d) {}
-};
-struct EnvStruct {
-	Value value;
-	// std::string type;
-	bool isConst;
-};
+// Native code for one expression, made by the JIT: returns 0 without
+// touching out when a variable does not hold the type it was compiled for.
+using JitCode = int (*)(EnvStruct *variables, Value *out);
 
 
 
-template<class... Ts>
-struct overloaded : Ts... { using Ts::operator()...; };
-template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
-
-string valueToString(const Value& val) {
-    return std::visit(overloaded{
-        [](int v) -> std::string { return std::to_string(v); },
-        [](double v) -> std::string { return std::to_string(v); },
-        [](const std::string& v) -> std::string { return "\"" + v + "\""; },
-        [](bool v) -> std::string { return v ? "true" : "false"; },
-        [](const ValueHolder::ArraY& vec) -> std::string {
-            std::string result = "[";
-            bool first = true;
-            for (const auto& item : vec) {
-                if (!first) result += ", ";
-                result += valueToString(item);
-                first = false;
-            }
-            result += "]";
-            return result;
-        },
-        [](const ValueHolder::ObjecT& obj) -> std::string {
-            std::string result = "{";
-            bool first = true;
-            for (const auto& [key, val] : obj) {
-                if (!first) result += ", ";
-                result += "\"" + key + "\": " + valueToString(val);
-                first = false;
-            }
-            result += "}";
-            return result;
-        },
-        [](std::monostate) -> std::string {
-            return "null";
-        }
-    }, val->data);
+// The token as the script means it, for messages: a string with its
+// escapes already applied.
+string tokenText(const Token &token) {
+	return token.type == TokenType::STRING_VALUE
+			   ? unescapeStringLiteral(token.value)
+			   : string(token.value);
 }
 
-
-
-
 void syntaxError(const Token &token, const string &msg) {
 	stringstream ss;
 	ss << "ไวยากรณ์ผิดพลาดที่บรรทัด " << token.line << " คอลัมน์ " << token.column
-	   << ": " << msg << " (พบ '" << token.value << "')";
+	   << ": " << msg << " (พบ '" << tokenText(token) << "')";
 	cerr << ss.str() << "";
 	std::exit(1);
 }
@@ -145,1434 +115,5901 @@ void lexerError(size_t line, size_t col, const string &msg,
 	std::exit(1);
 }
 
-unordered_map<string, unordered_map<string, functionDef>> importModules;
-unordered_map<string, functionDef> exportedFunctions;
-std::vector<std::unordered_map<std::string, EnvStruct>> env;
-unordered_map<string, functionDef> functionTable;
+// Command-line switches that choose how a script is run.
+struct RunOptions {
+	bool useVM = false; // --vm: bytecode VM instead of the tree walker
+	// --jit: compile the arithmetic of a function to x86-64 once it has been
+	// called jitThreshold times (--jit-threshold=N). Tree walker only.
+	bool jit = false;
+	uint32_t jitThreshold = 1000;
+	// --osr: a loop the tree walker has taken round osrThreshold times
+	// (--osr-threshold=N) carries on in the VM from its next iteration. With
+	// --jit the loop's arithmetic is compiled then instead, and it stays in
+	// the tree walker, since the VM does not run compiled code.
+	bool osr = false;
+	uint32_t osrThreshold = 1000;
+	// --opt=N: 0 runs programs as they were lowered, 1 folds constants
+	// first (foldProgram)
+	size_t optLevel = 1;
+	// --inline-size=N: the most expression nodes a function inlined into
+	// its calls may have; 0 inlines nothing
+	size_t inlineSize = 24;
+	// --report-types: print how many operators inferTypes specialized
+	bool reportTypes = false;
+	// --dump-ir: print the IR optimizeIr builds for each body to stderr,
+	// before and after each of its passes
+	bool dumpIr = false;
+};
+RunOptions runOptions;
+
+// Execution tree
+//
+// evalProgram() lowers the AST (the parsed nodes, or a module's JSON) once
+// into these nodes, so the evaluator switches on an enum and follows child
+// pointers instead of looking up "type", "left" or "line" strings in a json
+// object on every visit.
+// Operators keep their TokenType and literals are parsed up front. JSON that
+// is not an object becomes an Invalid node and a node type the evaluator
+// does not know becomes Unknown, so both still fail only when they are run.
+enum class ExecKind : uint8_t {
+	// expressions
+	Int, Float, Bool, String, Null, Variable, ArrayLiteral, ObjectLiteral,
+	UnaryOp, Ln, BinaryOp, Convert, ObjectAccess, ArrayAccess, FunctionCall,
+	Length, Temp,
+	// statements
+	Print, Block, If, Assignment, Input, Break, Continue, WhileLoop, DoWhileLoop,
+	ForLoop, Return, FunctionDeclaration, Push, Pop, Insert, Erase, ExitProcess,
+	Export, Import, Comment, Program,
+	Invalid, Unknown
+};
 
-bool getBool(Value val) {
-	if (!val) {
-		cerr << "ค่าที่ส่งมาตรวจสอบเป็น nullptr\n";
-		exit(1);
-	}
+struct ExecNode {
+	ExecKind kind = ExecKind::Unknown;
+	int line = 0;
+	int column = 0;
+	virtual ~ExecNode() = default;
+};
 
-	if (holds_alternative<bool>(val->data)) {
-		return get<bool>(val->data);
+struct ExecInvalid : ExecNode {
+	string text; // the offending JSON, for the error message
+};
+struct ExecInt : ExecNode {
+	int value = 0;
+};
+struct ExecFloat : ExecNode {
+	double value = 0;
+};
+struct ExecBool : ExecNode {
+	bool value = false;
+};
+struct ExecString : ExecNode {
+	string value;
+};
+struct ExecVariable : ExecNode {
+	string name;
+	int slot = 0;
+};
+struct ExecArrayLiteral : ExecNode {
+	vector<ExecNodePtr> elements;
+};
+struct ExecObjectLiteral : ExecNode {
+	vector<pair<ExecNodePtr, ExecNodePtr>> properties;
+};
+struct ExecUnary : ExecNode {
+	TokenType op = TokenType::NOT;
+	bool knownOp = false;
+	ExecNodePtr operand;
+};
+struct ExecLn : ExecNode {
+	ExecNodePtr value;
+};
+// applyBinary for one operator and one pair of operand types; no value
+// (None) when the operands are not of those types
+using BinaryHandler = Value (*)(const Value &left, const Value &right);
+BinaryHandler specializedHandler(TokenType op, Value::Type left, Value::Type right);
+
+struct ExecBinary : ExecNode {
+	TokenType op = TokenType::ADDITION;
+	bool knownOp = false;
+	ExecNodePtr left;
+	ExecNodePtr right;
+	// the operand types seen here, None before the first evaluation; mixed
+	// once they changed between evaluations
+	mutable Value::Type seenLeft = Value::Type::None;
+	mutable Value::Type seenRight = Value::Type::None;
+	mutable bool mixed = false;
+	// a handler for the first types seen, dropped once they change; a
+	// strength reduction foldConstants put here (reduced) stays
+	mutable BinaryHandler handler = nullptr;
+	bool reduced = false;
+	mutable JitCode jit = nullptr;
+	mutable uint32_t jitMisses = 0;
+	// the operand types inferTypes proved and the result's, which
+	// evalProven computes unboxed; None when it could not
+	Value::Type provenLeft = Value::Type::None;
+	Value::Type provenRight = Value::Type::None;
+	Value::Type proven = Value::Type::None;
+
+	void observe(const Value &l, const Value &r) const {
+		if (seenLeft == Value::Type::None) {
+			seenLeft = l.type();
+			seenRight = r.type();
+			if (!reduced) {
+				handler = specializedHandler(op, seenLeft, seenRight);
+			}
+		} else if (seenLeft != l.type() || seenRight != r.type()) {
+			mixed = true;
+			if (!reduced) {
+				handler = nullptr;
+			}
+		}
 	}
+};
+struct ExecConvert : ExecNode {
+	string target;
+	ExecNodePtr expression;
+};
+struct ExecObjectAccess : ExecNode {
+	ExecNodePtr object;
+	ExecNodePtr key;
+	bool dotKey = false; // o.name: key is the variable node's name
+	string keyName;
+};
+struct ExecArrayAccess : ExecNode {
+	ExecNodePtr array;
+	ExecNodePtr index;
+	// optimizeIr proved the index an int within the array, if it is one
+	bool inBounds = false;
+};
+// A callee small enough for its calls to run it in place (see inlineCalls):
+// its parameters' slots and its returns in order, each taken when its
+// condition (none for the last) holds. They point at the slots of the
+// function's nodes, which folding may replace.
+struct InlineBody {
+	vector<int> parameters;
+	vector<pair<const ExecNodePtr *, const ExecNodePtr *>> returns;
+};
 
-	cerr << "ค่าที่ส่งมาตรวจสอบไม่ใช่ boolean\n";
-	exit(1);
-}
+struct ExecCall : ExecNode {
+	string name;
+	string ns;
+	bool badName = false;
+	bool badNamespace = false;
+	vector<ExecNodePtr> args;
+	mutable CallCache cache;
+	const InlineBody *inlined = nullptr;
+};
+struct ExecLength : ExecNode {
+	ExecNodePtr target;
+};
+// A value optimizeIr keeps for reuse: with a value, evaluating it stores
+// the result in temps[index]; without one, it reads what was stored there.
+struct ExecTemp : ExecNode {
+	int index = 0;
+	ExecNodePtr value;
+};
+vector<Value> temps;
+struct ExecPrint : ExecNode {
+	bool hasList = false;
+	vector<ExecNodePtr> expressions;
+};
+struct ExecBlock : ExecNode {
+	vector<ExecNodePtr> statements;
+};
+struct ExecBranch {
+	ExecNodePtr condition;
+	vector<ExecNodePtr> body;
+};
+struct ExecIf : ExecNode {
+	ExecBranch then;
+	vector<ExecBranch> elifs;
+	bool hasElse = false;
+	vector<ExecNodePtr> elseBody;
+};
+struct ExecAssignment : ExecNode {
+	ExecNodePtr target;
+	ExecNodePtr value;
+	bool isConst = false;
+};
+struct ExecInput : ExecNode {
+	int slot = 0;
+};
+// --osr: the back edges a loop has taken in the tree walker, and the chunk
+// it moves to once they reach osrThreshold. A loop holding a คืนค่า stays
+// where it is, since its chunk could not return from the enclosing function.
+struct Chunk;
+struct LoopTier {
+	bool holdsReturn = false;
+	uint32_t backEdges = 0;
+	const Chunk *chunk = nullptr;
+};
+// hoisted: the ExecTemps optimizeIr moved out of the loop, evaluated each
+// time the loop starts (after the step, for a for loop)
+struct ExecLoop : ExecNode { // whileloop and dowhileloop
+	ExecNodePtr condition;
+	vector<ExecNodePtr> body;
+	vector<ExecNodePtr> hoisted;
+	mutable LoopTier tier;
+};
+struct ExecFor : ExecNode {
+	int variable = 0; // slot
+	ExecNodePtr init;
+	ExecNodePtr stop;
+	ExecNodePtr step;
+	vector<ExecNodePtr> body;
+	vector<ExecNodePtr> hoisted;
+	mutable LoopTier tier;
+};
+struct ExecReturn : ExecNode {
+	ExecNodePtr value;
+	bool inFunction = false;
+	bool tailCall = false; // คืนค่า f(...) inside a function
+};
+struct ExecJump : ExecNode { // Break and Continue
+	bool inLoop = false;
+};
+struct ExecFunction : ExecNode {
+	string name;
+	vector<int> parameters; // slots
+	vector<ExecNodePtr> body;
+};
+struct ExecExport : ExecNode {
+	vector<unique_ptr<ExecFunction>> functions;
+};
+struct ExecImport : ExecNode {
+	string file;
+	string name;
+	string currentFilePath; // file holding this import, for nested imports
+};
+struct ExecArrayOp : ExecNode { // Push, Pop, Insert, Erase
+	ExecNodePtr array;
+	ExecNodePtr index;
+	ExecNodePtr value;
+};
+struct ExecProgram : ExecNode {
+	vector<ExecNodePtr> statements;
+};
 
-EnvStruct *lookvar(const string &name, int line, int column) {
-	for (int i = env.size() - 1; i >= 0; i--) {
+// Calls f on every child that runs as part of node: operands, conditions
+// and bodies, but not the body of a โปรแกรม declared inside it.
+template <class F> void forEachChild(ExecNode &node, F &&f) {
+	auto one = [&](ExecNodePtr &child) {
+		if (child) {
+			f(child);
+		}
+	};
+	auto list = [&](vector<ExecNodePtr> &children) {
+		for (auto &child : children) {
+			one(child);
+		}
+	};
+	switch (node.kind) {
+	case ExecKind::ArrayLiteral:
+		list(static_cast<ExecArrayLiteral &>(node).elements);
+		break;
+	case ExecKind::ObjectLiteral:
+		for (auto &[key, value] : static_cast<ExecObjectLiteral &>(node).properties) {
+			one(key);
+			one(value);
+		}
+		break;
+	case ExecKind::UnaryOp:
+		one(static_cast<ExecUnary &>(node).operand);
+		break;
+	case ExecKind::Ln:
+		one(static_cast<ExecLn &>(node).value);
+		break;
+	case ExecKind::BinaryOp: {
+		auto &n = static_cast<ExecBinary &>(node);
+		one(n.left);
+		one(n.right);
+		break;
+	}
+	case ExecKind::Convert:
+		one(static_cast<ExecConvert &>(node).expression);
+		break;
+	case ExecKind::ObjectAccess: {
+		auto &n = static_cast<ExecObjectAccess &>(node);
+		one(n.object);
+		if (!n.dotKey) {
+			one(n.key);
+		}
+		break;
+	}
+	case ExecKind::ArrayAccess: {
+		auto &n = static_cast<ExecArrayAccess &>(node);
+		one(n.array);
+		one(n.index);
+		break;
+	}
+	case ExecKind::FunctionCall:
+		list(static_cast<ExecCall &>(node).args);
+		break;
+	case ExecKind::Length:
+		one(static_cast<ExecLength &>(node).target);
+		break;
+	case ExecKind::Temp:
+		one(static_cast<ExecTemp &>(node).value);
+		break;
+	case ExecKind::Print:
+		list(static_cast<ExecPrint &>(node).expressions);
+		break;
+	case ExecKind::Block:
+		list(static_cast<ExecBlock &>(node).statements);
+		break;
+	case ExecKind::If: {
+		auto &n = static_cast<ExecIf &>(node);
+		one(n.then.condition);
+		list(n.then.body);
+		for (auto &elif : n.elifs) {
+			one(elif.condition);
+			list(elif.body);
+		}
+		list(n.elseBody);
+		break;
+	}
+	case ExecKind::Assignment: {
+		auto &n = static_cast<ExecAssignment &>(node);
+		one(n.target);
+		one(n.value);
+		break;
+	}
+	case ExecKind::WhileLoop:
+	case ExecKind::DoWhileLoop: {
+		auto &n = static_cast<ExecLoop &>(node);
+		list(n.hoisted);
+		one(n.condition);
+		list(n.body);
+		break;
+	}
+	case ExecKind::ForLoop: {
+		auto &n = static_cast<ExecFor &>(node);
+		one(n.init);
+		one(n.stop);
+		one(n.step);
+		list(n.hoisted);
+		list(n.body);
+		break;
+	}
+	case ExecKind::Return:
+		one(static_cast<ExecReturn &>(node).value);
+		break;
+	case ExecKind::Push:
+	case ExecKind::Pop:
+	case ExecKind::Insert:
+	case ExecKind::Erase: {
+		auto &n = static_cast<ExecArrayOp &>(node);
+		one(n.array);
+		one(n.index);
+		one(n.value);
+		break;
+	}
+	case ExecKind::Program:
+		list(static_cast<ExecProgram &>(node).statements);
+		break;
+	default:
+		break;
+	}
+}
 
-		if (env[i].count(name)) {
+// Calls f on node and on everything under it, the bodies of functions
+// declared or exported there included.
+template <class F> void forEachNode(ExecNode &node, F &&f) {
+	f(node);
+	if (node.kind == ExecKind::FunctionDeclaration) {
+		for (auto &stmt : static_cast<ExecFunction &>(node).body) {
+			forEachNode(*stmt, f);
+		}
+	} else if (node.kind == ExecKind::Export) {
+		for (auto &function : static_cast<ExecExport &>(node).functions) {
+			forEachNode(*function, f);
+		}
+	}
+	forEachChild(node, [&](ExecNodePtr &child) { forEachNode(*child, f); });
+}
 
-			return &env[i][name];
+// Lowered programs own every function body that functionTable and
+// importModules point at, so they are kept until the process exits.
+vector<unique_ptr<ExecProgram>> loadedPrograms;
+
+// Where lowerNode is: how many loops of the current function body (or
+// program) enclose the node, and whether that is a function body. returns
+// counts the คืนค่า lowered in it so far.
+struct LoweringContext {
+	int loops = 0;
+	bool inFunction = false;
+	int returns = 0;
+};
+LoweringContext lowering;
+
+ExecNodePtr lowerNode(const ASTNodePtr &node);
+
+const unordered_map<string, TokenType> &operatorKinds() {
+	static const unordered_map<string, TokenType> kinds = [] {
+		unordered_map<string, TokenType> m;
+		for (TokenType t : {TokenType::EXPONENTIATION, TokenType::ROOT,
+							TokenType::MULTIPLICATION, TokenType::DIVISION,
+							TokenType::FLOORDIVISION, TokenType::MODULAS,
+							TokenType::ADDITION, TokenType::SUBTRACTION,
+							TokenType::SHIFT_LEFT, TokenType::SHIFT_RIGHT,
+							TokenType::GREATER, TokenType::LESSER,
+							TokenType::GREATEROREQUAL, TokenType::LESSEROREQUAL,
+							TokenType::EQUALTO, TokenType::NOTEQUAL,
+							TokenType::BITWISE_AND, TokenType::XOR,
+							TokenType::BITWISE_OR, TokenType::AND, TokenType::OR,
+							TokenType::NOT, TokenType::BITWISE_NOT,
+							TokenType::INCREMENT, TokenType::DECREMENT}) {
+			m[tokenTypeName(t)] = t;
 		}
+		return m;
+	}();
+	return kinds;
+}
 
+// Type feedback for binaryOp sites, in both engines. The first evaluation of
+// a site picks a handler for the operand types it saw; from then on those
+// types take one guard and the arithmetic instead of applyBinary's cascade of
+// holds<> pairs. A site that sees another pair goes back to applyBinary.
+template <TokenType op, class L, class R>
+Value binaryHandler(const Value &left, const Value &right) {
+	if (!left.holds<L>() || !right.holds<R>()) {
+		return nullptr;
+	}
+	if constexpr (is_same_v<L, string>) {
+		const string &a = left.as<string>();
+		const string &b = right.as<string>();
+		if constexpr (op == TokenType::ADDITION) {
+			return Value(a + b);
+		} else if constexpr (op == TokenType::EQUALTO) {
+			return Value(a == b);
+		} else {
+			return Value(a != b);
+		}
+	} else {
+		L a = left.as<L>();
+		R b = right.as<R>();
+		if constexpr (op == TokenType::ADDITION) {
+			return Value(a + b);
+		} else if constexpr (op == TokenType::SUBTRACTION) {
+			return Value(a - b);
+		} else if constexpr (op == TokenType::MULTIPLICATION) {
+			return Value(a * b);
+		} else if constexpr (op == TokenType::DIVISION) {
+			return Value(static_cast<double>(a) / static_cast<double>(b));
+		} else if constexpr (op == TokenType::MODULAS) {
+			if (b == 0) {
+				return nullptr;
+			}
+			return Value(a % b);
+		} else if constexpr (op == TokenType::GREATER) {
+			return Value(a > b);
+		} else if constexpr (op == TokenType::LESSER) {
+			return Value(a < b);
+		} else if constexpr (op == TokenType::GREATEROREQUAL) {
+			return Value(a >= b);
+		} else if constexpr (op == TokenType::LESSEROREQUAL) {
+			return Value(a <= b);
+		} else if constexpr (op == TokenType::EQUALTO) {
+			return Value(a == b);
+		} else if constexpr (op == TokenType::NOTEQUAL) {
+			return Value(a != b);
+		} else if constexpr (op == TokenType::AND) {
+			return Value(a && b);
+		} else {
+			return Value(a || b);
+		}
 	}
-	cerr << "ไม่พบตัวแปร " << name << " ในขอบเขตนี้ ที่บรรทัด " << line << "คอลัม์"
-		 << column << "";
-	exit(1);
 }
-Value getVar(const string &name, int line, int column) {
-    // เริ่มจาก scope สุดท้าย (ลึกที่สุด) ไปหาส่วนนอก
-    for (auto it = env.rbegin(); it != env.rend(); ++it) {
-        if (it->count(name)) {
-            return (*it)[name].value;
-        }
-    }
 
-    cerr << "ไม่พบตัวแปร " << name << " ในขอบเขตนี้ ที่บรรทัด "
-         << line << " คอลัมน์ " << column << endl;
-    exit(1);
+// = and != compare values of different types as unequal, so only pairs of
+// one type get them.
+template <class L, class R> BinaryHandler numericHandler(TokenType op) {
+	switch (op) {
+	case TokenType::ADDITION:
+		return binaryHandler<TokenType::ADDITION, L, R>;
+	case TokenType::SUBTRACTION:
+		return binaryHandler<TokenType::SUBTRACTION, L, R>;
+	case TokenType::MULTIPLICATION:
+		return binaryHandler<TokenType::MULTIPLICATION, L, R>;
+	case TokenType::DIVISION:
+		return binaryHandler<TokenType::DIVISION, L, R>;
+	case TokenType::GREATER:
+		return binaryHandler<TokenType::GREATER, L, R>;
+	case TokenType::LESSER:
+		return binaryHandler<TokenType::LESSER, L, R>;
+	case TokenType::GREATEROREQUAL:
+		return binaryHandler<TokenType::GREATEROREQUAL, L, R>;
+	case TokenType::LESSEROREQUAL:
+		return binaryHandler<TokenType::LESSEROREQUAL, L, R>;
+	default:
+		break;
+	}
+	if constexpr (is_same_v<L, R>) {
+		if (op == TokenType::EQUALTO) {
+			return binaryHandler<TokenType::EQUALTO, L, R>;
+		} else if (op == TokenType::NOTEQUAL) {
+			return binaryHandler<TokenType::NOTEQUAL, L, R>;
+		}
+	}
+	if constexpr (is_same_v<L, int> && is_same_v<R, int>) {
+		if (op == TokenType::MODULAS) {
+			return binaryHandler<TokenType::MODULAS, int, int>;
+		}
+	}
+	return nullptr;
 }
 
+// nullptr where applyBinary is left to do it
+BinaryHandler specializedHandler(TokenType op, Value::Type left, Value::Type right) {
+	using T = Value::Type;
+	if (left == T::Int && right == T::Int) {
+		return numericHandler<int, int>(op);
+	} else if (left == T::Double && right == T::Double) {
+		return numericHandler<double, double>(op);
+	} else if (left == T::Int && right == T::Double) {
+		return numericHandler<int, double>(op);
+	} else if (left == T::Double && right == T::Int) {
+		return numericHandler<double, int>(op);
+	} else if (left == T::String && right == T::String) {
+		switch (op) {
+		case TokenType::ADDITION:
+			return binaryHandler<TokenType::ADDITION, string, string>;
+		case TokenType::EQUALTO:
+			return binaryHandler<TokenType::EQUALTO, string, string>;
+		case TokenType::NOTEQUAL:
+			return binaryHandler<TokenType::NOTEQUAL, string, string>;
+		default:
+			return nullptr;
+		}
+	} else if (left == T::Bool && right == T::Bool) {
+		switch (op) {
+		case TokenType::AND:
+			return binaryHandler<TokenType::AND, bool, bool>;
+		case TokenType::OR:
+			return binaryHandler<TokenType::OR, bool, bool>;
+		case TokenType::EQUALTO:
+			return binaryHandler<TokenType::EQUALTO, bool, bool>;
+		case TokenType::NOTEQUAL:
+			return binaryHandler<TokenType::NOTEQUAL, bool, bool>;
+		default:
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
 
+inline Value evalBinary(const ExecBinary &site, const Value &left,
+						const Value &right) {
+	if (site.handler) {
+		if (Value out = site.handler(left, right)) {
+			return out;
+		}
+	}
+	site.observe(left, right);
+	return applyBinary(site.op, left, right, site.line, site.column);
+}
 
+// Constant folding
+//
+// With --opt=1 (the default) evalProgram rewrites each lowered program
+// before running it. An operator or ln whose operands are literals becomes
+// the literal it evaluates to, as long as evaluating it can not fail and
+// gives an int, a finite double, a bool or a string; anything that would
+// stop with an error is left to do that when it runs. In the entry program a
+// top-level ค่าคงที่ set to an int, double or bool that nothing else writes
+// is substituted into the top-level code after it, which may fold further.
+// x ** 2, x ** 3 and ราก(2, x) get a handler that skips pow when the result
+// is one a double holds exactly, where pow would give the same.
+
+// x ** n for an int x small enough that x to the n fits a double's 53 bits
+template <int n> Value powerHandler(const Value &left, const Value &) {
+	constexpr int limit = n == 2 ? 94906265 : 208063;
+	if (!left.holds<int>() || left.as<int>() > limit || left.as<int>() < -limit) {
+		return nullptr;
+	}
+	double x = left.as<int>();
+	return Value(n == 2 ? x * x : x * x * x);
+}
 
+// ราก(2, x) for an int x that is a perfect square
+Value squareRootHandler(const Value &, const Value &right) {
+	if (!right.holds<int>() || right.as<int>() < 0) {
+		return nullptr;
+	}
+	double root = sqrt(right.as<int>());
+	if (root != floor(root)) {
+		return nullptr;
+	}
+	return Value(root);
+}
 
-void setvar(const string &name, Value val, int line, int column, bool isconst) {
-    // หาตำแหน่งตัวแปรใน scope ที่อยู่ลึกสุดที่เจอชื่อ name
-    for (int i = env.size() - 1; i >= 0; i--) {
-        if (env[i].count(name)) {
-            // Found the variable in this scope
-            if (env[i][name].isConst) {
-                cerr << "ไม่สามารถเปลี่ยนแปลงค่าคงที่ " << name << " ได้ ที่บรรทัด " << line
-                     << " คอลัมน์ " << column << "";
-                std::exit(1);
-            }
-            env[i][name].value = val;  // อัปเดตค่าตัวแปร
-            return;
-        }
-    }
-
-    // Variable not found, create new one
-    env.back()[name] = {val, isconst};
+Value literalValue(const ExecNode *node) {
+	switch (node->kind) {
+	case ExecKind::Int:
+		return Value(static_cast<const ExecInt *>(node)->value);
+	case ExecKind::Float:
+		return Value(static_cast<const ExecFloat *>(node)->value);
+	case ExecKind::Bool:
+		return Value(static_cast<const ExecBool *>(node)->value);
+	case ExecKind::String:
+		return Value(static_cast<const ExecString *>(node)->value);
+	default:
+		return nullptr;
+	}
 }
 
+// nullptr for a value that has no literal node
+ExecNodePtr literalNode(const Value &val, const ExecNode &at) {
+	ExecNodePtr node;
+	if (val.holds<int>()) {
+		auto n = make_unique<ExecInt>();
+		n->kind = ExecKind::Int;
+		n->value = val.as<int>();
+		node = std::move(n);
+	} else if (val.holds<double>() && isfinite(val.as<double>())) {
+		auto n = make_unique<ExecFloat>();
+		n->kind = ExecKind::Float;
+		n->value = val.as<double>();
+		node = std::move(n);
+	} else if (val.holds<bool>()) {
+		auto n = make_unique<ExecBool>();
+		n->kind = ExecKind::Bool;
+		n->value = val.as<bool>();
+		node = std::move(n);
+	} else if (val.holds<string>()) {
+		auto n = make_unique<ExecString>();
+		n->kind = ExecKind::String;
+		n->value = val.as<string>();
+		node = std::move(n);
+	} else {
+		return nullptr;
+	}
+	node->line = at.line;
+	node->column = at.column;
+	return node;
+}
 
-// evalExper
-// shared_ptr<ASTNode> parseFunctionFromJSON(const json &j);
-Value evalExpr(const json &expr) {
+bool isNumber(const Value &val) {
+	return val.holds<int>() || val.holds<double>();
+}
 
-	if (!expr.is_object()) {
-		cerr << "❌ expr ไม่ใช่ json object แต่เป็น: " << expr << "";
-		exit(1);
+// None where applyBinary could stop the program, or trap on an int division
+Value foldBinary(const ExecBinary &n, const Value &left, const Value &right) {
+	bool numbers = isNumber(left) && isNumber(right);
+	bool ints = left.holds<int>() && right.holds<int>();
+	switch (n.op) {
+	case TokenType::EQUALTO:
+	case TokenType::NOTEQUAL:
+		return applyBinary(n.op, left, right, n.line, n.column);
+	case TokenType::EXPONENTIATION:
+	case TokenType::ROOT:
+		return numbers ? applyBinary(n.op, left, right, n.line, n.column) : nullptr;
+	case TokenType::FLOORDIVISION:
+	case TokenType::MODULAS:
+		if (!numbers || (ints && (right.as<int>() == 0 || right.as<int>() == -1))) {
+			return nullptr;
+		}
+		return applyBinary(n.op, left, right, n.line, n.column);
+	case TokenType::BITWISE_AND:
+	case TokenType::XOR:
+	case TokenType::BITWISE_OR:
+		if ((left.holds<int>() || left.holds<bool>()) &&
+			(right.holds<int>() || right.holds<bool>())) {
+			return applyBinary(n.op, left, right, n.line, n.column);
+		}
+		return nullptr;
+	default: {
+		BinaryHandler handler = specializedHandler(n.op, left.type(), right.type());
+		return handler ? handler(left, right) : nullptr;
 	}
-
-	string type = expr["type"];
-	if (type == "int") {
-		return make_shared<ValueHolder>(expr["value"].get<int>());
-	} else if (type == "float") {
-		return make_shared<ValueHolder>(expr["value"].get<double>());
-	} else if (type == "bool") {
-		return make_shared<ValueHolder>(expr["value"].get<bool>());
-	} else if (type == "string") {
-		return make_shared<ValueHolder>(expr["value"].get<string>());
-	} else if (type == "null") {
-		return make_shared<ValueHolder>(monostate{});
-	} else if (type == "variable") {
-		EnvStruct *var =  lookvar(expr["name"], expr["line"], expr["column"]);
-		return var->value;
 	}
+}
 
-	else if (type == "ArrayLiterel") {
-		ValueHolder::ArraY arr;
-		for (const auto &a : expr["element"]) {
-			arr.push_back(evalExpr(a));
+Value foldUnary(const ExecUnary &n, const Value &operand) {
+	switch (n.op) {
+	case TokenType::NOT:
+		if (isNumber(operand) || operand.holds<bool>()) {
+			return applyUnary(n.op, operand, n.line, n.column);
 		}
-		return make_shared<ValueHolder>(arr);
-	} else if (type == "ObjectLiteral") {
-		ValueHolder::ObjecT obj;
+		return nullptr;
+	case TokenType::BITWISE_NOT:
+		if (operand.holds<int>() || operand.holds<bool>()) {
+			return applyUnary(n.op, operand, n.line, n.column);
+		}
+		return nullptr;
+	case TokenType::SUBTRACTION:
+		if ((operand.holds<int>() && operand.as<int>() != INT_MIN) ||
+			operand.holds<double>()) {
+			return applyUnary(n.op, operand, n.line, n.column);
+		}
+		return nullptr;
+	default:
+		return nullptr;
+	}
+}
 
-		for (const auto &prop : expr["properties"]) {
-			Value keyVal = evalExpr(prop["key"]);
+// The variable an assignment, ++/-- or array method writes through: x for
+// x, x[i] or x.k; -1 for anything else
+int writtenSlot(const ExecNode *place) {
+	while (place) {
+		switch (place->kind) {
+		case ExecKind::Variable:
+			return static_cast<const ExecVariable *>(place)->slot;
+		case ExecKind::ArrayAccess:
+			place = static_cast<const ExecArrayAccess *>(place)->array.get();
+			break;
+		case ExecKind::ObjectAccess:
+			place = static_cast<const ExecObjectAccess *>(place)->object.get();
+			break;
+		default:
+			return -1;
+		}
+	}
+	return -1;
+}
 
-			if (!holds_alternative<string>(keyVal->data)) {
-				cerr << "ผิดพลาด: คีย์ในออบเจ็กต์ต้องเป็นข้อความ ที่บรรทัด: "
-					 << prop["key"]["line"]
-					 << " คอลัมน์: " << prop["key"]["column"] << "";
-				std::exit(1);
-			}
+// What a whole program, function bodies included, may write: how many
+// places write each slot, and whether it imports anything, since a module
+// shares the slots.
+struct ProgramWrites {
+	vector<int> counts = vector<int>(variableNames.size());
+	bool imports = false;
 
-			string key = get<string>(keyVal->data);
-			Value val = evalExpr(prop["value"]);
-			obj[key] = val;
+	void note(int slot) {
+		if (slot >= 0) {
+			counts[slot]++;
 		}
-
-		return make_shared<ValueHolder>(obj);
 	}
-
-	// pimary
-	else if (type == "unaryOp") {
-		Value operand = evalExpr(expr["operand"]);
-		string op = expr["operator"];
-		if (op == "NOT") {
-			if (holds_alternative<bool>(operand->data)) {
-				return make_shared<ValueHolder>(!get<bool>(operand->data));
-			} else if (holds_alternative<int>(operand->data)) {
-				return make_shared<ValueHolder>(!get<int>(operand->data));
-			} else if (holds_alternative<double>(operand->data)) {
-				return make_shared<ValueHolder>(!get<double>(operand->data));
-			}
-			cerr << "ไม่สามารถหา นิเสธของ " << valueToString(operand) << "";
-			exit(1);
-		} else if (op == "BITWISE_NOT") {
-			if (holds_alternative<bool>(operand->data)) {
-				return make_shared<ValueHolder>(~get<bool>(operand->data));
-			} else if (holds_alternative<int>(operand->data)) {
-				return make_shared<ValueHolder>(~get<int>(operand->data));
-			}
-			cerr << "ไม่สามารถ สลับบิต ของ " << valueToString(operand) << "";
-			exit(1);
-		} else if (op == "INCREMENT") {
-			if (holds_alternative<int>(operand->data)) {
-				return make_shared<ValueHolder>(get<int>(operand->data)++);
+	void scan(ExecNode &node) {
+		switch (node.kind) {
+		case ExecKind::Assignment:
+			note(writtenSlot(static_cast<ExecAssignment &>(node).target.get()));
+			break;
+		case ExecKind::Input:
+			note(static_cast<ExecInput &>(node).slot);
+			break;
+		case ExecKind::ForLoop:
+			note(static_cast<ExecFor &>(node).variable);
+			break;
+		case ExecKind::UnaryOp: {
+			auto &n = static_cast<ExecUnary &>(node);
+			if (n.op == TokenType::INCREMENT || n.op == TokenType::DECREMENT) {
+				note(writtenSlot(n.operand.get()));
 			}
-			cerr << "ไม่สามารถ เพิ่มค่า ของ " << valueToString(operand) << "";
-			exit(1);
-		} else if (op == "DECREMENT") {
-			if (holds_alternative<int>(operand->data)) {
-				return make_shared<ValueHolder>(get<int>(operand->data)--);
+			break;
+		}
+		case ExecKind::Push:
+		case ExecKind::Pop:
+		case ExecKind::Insert:
+		case ExecKind::Erase:
+			note(writtenSlot(static_cast<ExecArrayOp &>(node).array.get()));
+			break;
+		case ExecKind::FunctionDeclaration:
+			function(static_cast<ExecFunction &>(node));
+			break;
+		case ExecKind::Export:
+			for (auto &f : static_cast<ExecExport &>(node).functions) {
+				function(*f);
 			}
-			cerr << "ไม่สามารถ ลดค่า ของ " << valueToString(operand) << "";
-			exit(1);
+			break;
+		case ExecKind::Import:
+			imports = true;
+			break;
+		default:
+			break;
 		}
-		 else if (op == "SUBTRACTION") {
-					if (holds_alternative<int>(operand->data)) {
-						return make_shared<ValueHolder>(-(get<int>(operand->data)));
-					}else if (holds_alternative<double>(operand->data)) {
-						return make_shared<ValueHolder>(-(get<double>(operand->data))--);
-					}
-					cerr << "ค่านี้ " << valueToString(operand) <<"ไม่สามารถติดลบได้"<< "";
-					exit(1);
-				}
-	} else if (type == "ln") {
-		Value val = evalExpr(expr["value"]);
-		if (holds_alternative<int>(val->data)) {
-			return make_shared<ValueHolder>(log(get<int>(val->data)));
-		} else if (holds_alternative<double>(val->data)) {
-			return make_shared<ValueHolder>(log(get<double>(val->data)));
-		}
-		cerr << "ไม่สามารถหาค่า ลอการิทึมธรรมชาติ ของ" << val
-			 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-			 << "";
-	} else if (type == "binaryOp") {
-		string op = expr["Op"];
-		Value left = evalExpr(expr["left"]);
-		Value right = evalExpr(expr["right"]);
-		if (op == "EXPONENTIATION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-
-				return make_shared<ValueHolder>(
-					pow(get<int>(left->data), get<int>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<double>(left->data), get<double>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<double>(left->data), get<int>(right->data)));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<int>(left->data), get<double>(right->data)));
-			}
-
-			cerr << "ไม่สามารถยกกำลัง " << valueToString(left) << " กับ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "ROOT") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<int>(right->data), 1.0 / get<int>(left->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<double>(right->data), 1.0 / get<double>(left->data)));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<double>(right->data), 1.0 / get<int>(left->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					pow(get<double>(right->data), 1.0 / get<int>(left->data)));
-			}
-
-			cerr << "ไม่สามารถถอดรากที่ " << valueToString(left) << " ของ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "MULTIPLICATION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) *
-												get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) *
-												get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) *
-												get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) *
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถคูณ " << valueToString(left) << "กับ" << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-
-		} else if (op == "DIVISION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(static_cast<double>(get<int>(left->data)) /
-												static_cast<double>(get<int>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) /
-												get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) /
-												get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) /
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถหาร " << valueToString(left) << "กับ" << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-
-		} else if (op == "FLOORDIVISION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					floor(get<int>(left->data) / get<int>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					floor(get<double>(left->data) / get<double>(right->data)));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					floor(get<int>(left->data) / get<double>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					floor(get<double>(left->data) / get<int>(right->data)));
-			}
-			cerr << "ไม่สามารถหารเอาส่วน " << valueToString(left) << "กับ" << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-
-		} else if (op == "MODULAS") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) %
-												get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					fmod(get<double>(left->data), get<double>(right->data)));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					fmod(static_cast<double>(get<int>(left->data)),
-						 get<double>(right->data)));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					fmod(get<double>(left->data),
-						 static_cast<double>(get<int>(right->data))));
-			}
-			cerr << "ไม่สามารถMOD " << valueToString(left) << "กับ" << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-
+		forEachChild(node, [&](ExecNodePtr &child) { scan(*child); });
+	}
+	void function(ExecFunction &f) {
+		for (int slot : f.parameters) {
+			note(slot);
 		}
-
-		else if (op == "ADDITION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) +
-												get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) +
-												get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) +
-												get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<double>(left->data) +
-												get<int>(right->data));
-			} else if (holds_alternative<string>(left->data) &&
-					   holds_alternative<string>(right->data)) {
-				return make_shared<ValueHolder>(get<string>(left->data) +
-												get<string>(right->data));
-			} else if (holds_alternative<ValueHolder::ObjecT>(left->data) &&
-					   holds_alternative<ValueHolder::ObjecT>(right->data)) {
-				auto merged = get<ValueHolder::ObjecT>(left->data);
-				const auto &rightobj = get<ValueHolder::ObjecT>(right->data);
-				for (const auto &[k, v] : rightobj) {
-					merged[k] = v;
-				}
-				return make_shared<ValueHolder>(merged);
-			} else if (holds_alternative<ValueHolder::ArraY>(left->data) &&
-					   holds_alternative<ValueHolder::ArraY>(right->data)) {
-				auto merged = get<ValueHolder::ArraY>(left->data);
-				const auto &rightarr = get<ValueHolder::ArraY>(right->data);
-				merged.insert(merged.end(), rightarr.begin(), rightarr.end());
-				return make_shared<ValueHolder>(merged);
-			}
-
-			cerr << "ไม่สามารถบวก " << valueToString(left) << " กับ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "SUBTRACTION") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) - get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) - get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) - get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) - get<int>(right->data));
-			}
-			cerr << "ไม่สามารถลบ " << valueToString(left) << " กับ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "SHIFT_LEFT") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data)
-												<< get<int>(right->data));
-			}
-			cerr << "ไม่สามารถ เลื่อนบิตของ " << valueToString(left) << " ไปทางซ้าย " << valueToString(right)
-				 << "ตำแหน่ง ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
-		} else if (op == "SHIFT_RIGHT") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) >>
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถ เลื่อนบิตของ " << valueToString(left) << " ไปทางซ้าย " << valueToString(right)
-				 << "ตำแหน่ง ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
-		} else if (op == "GREATER") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) > get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) > get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) > get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) > get<int>(right->data));
-			}
-			cerr << "ไม่สามารถเปรียบเทียบมากกว่า " << valueToString(left) << " กับ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "LESSER") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) < get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) < get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) < get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) < get<int>(right->data));
-			}
-			cerr << "ไม่สามารถเปรียบเทียบน้อยกว่า " << valueToString(left) << " กับ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "GREATEROREQUAL") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) >= get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) >= get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) >= get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) >= get<int>(right->data));
-			}
-			cerr << "ไม่สามารถเปรียบเทียบมากกว่าหรือเท่ากับ " << valueToString(left) << " กับ "
-				 << valueToString(right) << " ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
-		} else if (op == "LESSEROREQUAL") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) <= get<int>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) <= get<double>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<double>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<int>(left->data) <= get<double>(right->data));
-			} else if (holds_alternative<double>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(
-					get<double>(left->data) <= get<int>(right->data));
-			}
-			cerr << "ไม่สามารถเปรียบเทียบน้อยกว่าหรือเท่ากับ " << valueToString(left) << " กับ "
-				 << valueToString(right) << " ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
-
-		} else if (op == "EQUALTO") {
-			return make_shared<ValueHolder>(left->data == right->data);
-		} else if (op == "NOTEQUAL") {
-			return make_shared<ValueHolder>(left->data != right->data);
-		} else if (op == "BITWISE_AND") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) &
-												get<int>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) &
-												get<bool>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) &
-												get<bool>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) &
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถใช้ ตัวนำเนินการ & กับ " << valueToString(left) << " และ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-
-		} else if (op == "XOR") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) ^
-												get<int>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) ^
-												get<bool>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) ^
-												get<bool>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) ^
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถใช้ ตัวนำเนินการ ซอร์ กับ " << valueToString(left) << " และ " << valueToString(right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "BITWISE_OR") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) |
-												get<int>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) |
-												get<bool>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) |
-												get<bool>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) |
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถใช้ ตัวนำเนินการ | กับ " << valueToString(left) << " และ " << (right)
-				 << " ที่บรรทัด: " << expr["line"] << " คอลัมน์: " << expr["column"]
-				 << "";
-			exit(1);
-		} else if (op == "AND") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) &&
-												get<int>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) &&
-												get<bool>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) &&
-												get<bool>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) &&
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถใช้ ตัวนำเนินการ 'และ' กับ " << valueToString(left) << " และ "
-				 << valueToString(right) << " ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
-		} else if (op == "OR") {
-			if (holds_alternative<int>(left->data) &&
-				holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) ||
-												get<int>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) ||
-												get<bool>(right->data));
-			} else if (holds_alternative<int>(left->data) &&
-					   holds_alternative<bool>(right->data)) {
-				return make_shared<ValueHolder>(get<int>(left->data) ||
-												get<bool>(right->data));
-			} else if (holds_alternative<bool>(left->data) &&
-					   holds_alternative<int>(right->data)) {
-				return make_shared<ValueHolder>(get<bool>(left->data) ||
-												get<int>(right->data));
-			}
-			cerr << "ไม่สามารถใช้ ตัวนำเนินการ 'หรือ' กับ " << valueToString(left) << " และ "
-				 << valueToString(right) << " ที่บรรทัด: " << expr["line"]
-				 << " คอลัมน์: " << expr["column"] << "";
-			exit(1);
+		for (auto &stmt : f.body) {
+			scan(*stmt);
 		}
+	}
+};
 
-	} // the end of binatyOp
-	else if (type == "Convert") {
-
-		string typE = expr["target"];
-		Value exp = evalExpr(expr["expression"]);
-		if (typE == "INTEGER") {
-			if (holds_alternative<string>(exp->data)) {
-				return make_shared<ValueHolder>(stoi(get<string>(exp->data)));
-			} else if (holds_alternative<bool>(exp->data)) {
-				return make_shared<ValueHolder>((int)get<bool>(exp->data));
-			} else if (holds_alternative<double>(exp->data)) {
-				return make_shared<ValueHolder>(
-					static_cast<int>(get<double>(exp->data)));
-			} else if (holds_alternative<int>(exp->data)) {
-				return make_shared<ValueHolder>(get<int>(exp->data));
-			}
-		} else if (typE == "FLOAT") {
-			if (holds_alternative<string>(exp->data)) {
-				return make_shared<ValueHolder>(stod(get<string>(exp->data)));
-			} else if (holds_alternative<int>(exp->data)) {
-				return make_shared<ValueHolder>(
-					static_cast<double>(get<int>(exp->data)));
-			} else if (holds_alternative<double>(exp->data)) {
-				return make_shared<ValueHolder>(get<double>(exp->data));
-			}
-		} else if (typE == "STRING") {
-			if (holds_alternative<int>(exp->data)) {
-				return make_shared<ValueHolder>(to_string(get<int>(exp->data)));
-			} else if (holds_alternative<double>(exp->data)) {
-				return make_shared<ValueHolder>(
-					to_string(get<double>(exp->data)));
-			} else if (holds_alternative<string>(exp->data)) {
-				return make_shared<ValueHolder>(get<string>(exp->data));
-			}
-		} else if (typE == "BOOLEAN") {
-			if (holds_alternative<int>(exp->data)) {
-				return make_shared<ValueHolder>(
-					static_cast<bool>(get<int>(exp->data)));
-			} else if (holds_alternative<bool>(exp->data)) {
-				return make_shared<ValueHolder>(get<bool>(exp->data));
-			}
-		}
-
-		cerr << "ไม่สามารถแปลงเป็นชนิด: " << typE << " ที่บรรทัด: " << expr["line"]
-			 << " คอลัมน์: " << expr["column"] << "";
-		exit(1);
-	}else if (type == "ObjectAccess") {
-	    Value obj = evalExpr(expr["object"]);
-	    json keyNode = expr["key"];
-	    string key;
-
-	    // ตรวจสอบว่า key เป็น variable node หรือไม่ (dot notation)
-	    if (keyNode["type"] == "variable") {
-	        key = keyNode["name"].get<string>();
-	    } else {
-	        Value keyVal = evalExpr(keyNode);
-	        if (!std::holds_alternative<std::string>(keyVal->data)) {
-	            std::cerr << "ผิดพลาด: ออบเจ็ต คีย์ต้องเป็น ข้อความ ที่บรรทัด "
-	                      << expr["line"] << ", คอลัม์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	        key = std::get<std::string>(keyVal->data);
-	    }
-
-	    // ส่วนที่เหลือเหมือนเดิม
-	    if (!std::holds_alternative<ValueHolder::ObjecT>(obj->data)) {
-	        std::cerr << "ผิดพลาด: ไม่สามารถเข้าถึง คีย์ '" << key
-	                  << "' บน ออบเจกต์ที่ยังไม่ประกาศ ที่บรรทัด " << expr["line"]
-	                  << ", คอลัม์ " << expr["column"] << "";
-	        exit(1);
-	    }
+// constants[slot] is the value substituted for reads of slot, None for a
+// slot left alone; nullptr inside function bodies.
+void foldConstants(ExecNodePtr &node, const vector<Value> *constants) {
+	auto inner = [](ExecFunction &f) {
+		for (auto &stmt : f.body) {
+			foldConstants(stmt, nullptr);
+		}
+	};
+	if (node->kind == ExecKind::FunctionDeclaration) {
+		inner(static_cast<ExecFunction &>(*node));
+		return;
+	} else if (node->kind == ExecKind::Export) {
+		for (auto &f : static_cast<ExecExport &>(*node).functions) {
+			inner(*f);
+		}
+		return;
+	}
+	forEachChild(*node, [&](ExecNodePtr &child) { foldConstants(child, constants); });
+
+	Value folded;
+	switch (node->kind) {
+	case ExecKind::Variable: {
+		int slot = static_cast<ExecVariable &>(*node).slot;
+		if (constants && (*constants)[slot]) {
+			folded = (*constants)[slot];
+		}
+		break;
+	}
+	case ExecKind::BinaryOp: {
+		auto &n = static_cast<ExecBinary &>(*node);
+		if (!n.knownOp) {
+			break;
+		}
+		Value left = literalValue(n.left.get());
+		Value right = literalValue(n.right.get());
+		if (left && right) {
+			folded = foldBinary(n, left, right);
+		} else if (n.op == TokenType::EXPONENTIATION && right.holds<int>() &&
+				   (right.as<int>() == 2 || right.as<int>() == 3)) {
+			n.handler = right.as<int>() == 2 ? powerHandler<2> : powerHandler<3>;
+			n.reduced = true;
+		} else if (n.op == TokenType::ROOT && isNumber(left) &&
+				   (left.holds<int>() ? left.as<int>() : left.as<double>()) == 2) {
+			n.handler = squareRootHandler;
+			n.reduced = true;
+		}
+		break;
+	}
+	case ExecKind::UnaryOp: {
+		auto &n = static_cast<ExecUnary &>(*node);
+		Value operand = literalValue(n.operand.get());
+		if (n.knownOp && operand) {
+			folded = foldUnary(n, operand);
+		}
+		break;
+	}
+	case ExecKind::Ln: {
+		Value operand = literalValue(static_cast<ExecLn &>(*node).value.get());
+		if (isNumber(operand)) {
+			folded = naturalLog(operand, node->line, node->column);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	if (folded) {
+		if (ExecNodePtr literal = literalNode(folded, *node)) {
+			node = std::move(literal);
+		}
+	}
+}
 
-	    auto &objMap = std::get<ValueHolder::ObjecT>(obj->data);
-	    if (!objMap.count(key)) {
-	        std::cerr << "พิดพลาด: คีย์นี้ '" << key << "' ไม่พบใน ออบเจกต์ ที่บรรทัด "
-	                  << expr["line"] << ", คอลัม์ " << expr["column"] << "";
-	        exit(1);
-	    }
+// entry: the program mmt was started on, rather than an imported module,
+// whose code runs with the importer's variables already bound
+void foldProgram(ExecProgram &program, bool entry) {
+	ProgramWrites writes;
+	if (entry) {
+		writes.scan(program);
+	}
+	bool propagate = entry && !writes.imports;
+	vector<Value> constants(propagate ? variableNames.size() : 0);
+	for (auto &stmt : program.statements) {
+		foldConstants(stmt, propagate ? &constants : nullptr);
+		if (!propagate || stmt->kind != ExecKind::Assignment) {
+			continue;
+		}
+		auto &assign = static_cast<ExecAssignment &>(*stmt);
+		Value val = literalValue(assign.value.get());
+		if (assign.isConst && assign.target->kind == ExecKind::Variable &&
+			!val.holds<string>() && val) {
+			int slot = static_cast<ExecVariable &>(*assign.target).slot;
+			if (writes.counts[slot] == 1) {
+				constants[slot] = val;
+			}
+		}
+	}
+}
 
-	    return objMap[key];
-	} else if (type == "ArrayAccess") {
-		Value arrayVal = evalExpr(expr["array"]);
-		Value indexVal = evalExpr(expr["index"]);
-		int index;
+// Baseline JIT
+//
+// With --jit, a function called runOptions.jitThreshold times has the
+// int/double arithmetic in its body compiled to x86-64. Every BinaryOp tree
+// whose operators always saw the same int or double operand types while the
+// tree walker ran becomes one native routine. The routine checks the tag of
+// each variable it reads against what was seen, computes in registers and
+// writes the result Value. When a tag differs, or an int % would divide by
+// 0 or -1, the routine returns 0 and evalExpr evaluates the node as usual.
+// That is safe because these expressions only read variables.
+
+#if defined(__linux__) && defined(__x86_64__)
+
+// Emits one routine at a time into code. Registers: rdi = variables.data(),
+// rsi = out, ints in eax (right operand in ecx), doubles in xmm0 (right
+// operand in xmm1), rbx = rsp on entry so a failed guard can unwind.
+struct JitEmitter {
+	vector<uint8_t> &code;
+	vector<size_t> failJumps;
+
+	void bytes(initializer_list<uint8_t> b) { code.insert(code.end(), b); }
+	void imm32(uint32_t v) {
+		for (int shift = 0; shift < 32; shift += 8) {
+			code.push_back(static_cast<uint8_t>(v >> shift));
+		}
+	}
+	void imm64(uint64_t v) {
+		imm32(static_cast<uint32_t>(v));
+		imm32(static_cast<uint32_t>(v >> 32));
+	}
+	void failIf(initializer_list<uint8_t> jcc) { // jcc rel32 to the fail exit
+		bytes(jcc);
+		failJumps.push_back(code.size());
+		imm32(0);
+	}
 
-		if(holds_alternative<int>(indexVal->data) && get<int>(indexVal->data) >= 0){
-			index = get<int>(indexVal->data);
-		}else if(holds_alternative<double>(indexVal->data)){
-			double d = get<double>(indexVal->data);
-			if(d == static_cast<int>(d) && d>=0){
-				index = static_cast<int>(get<double>(indexVal->data));
-			}else{
-				cerr<<"ผิดพลาด: ไม่สามารถเข้นถึงชุดข้อมูลด้วย ดัชนีที่เป็นทศนิยม ที่ บรรทัด "
-					  << expr["line"] << ", คอลัมน์ " << expr["column"] <<"";
-				exit(1);
+	// Leaves node in eax (Int, Bool) or xmm0 (Double) and returns its type,
+	// which has to be `seen`; None when the node can not be compiled.
+	Value::Type operand(const ExecNode *node, Value::Type seen) {
+		using T = Value::Type;
+		switch (node->kind) {
+		case ExecKind::Int:
+			if (seen != T::Int) {
+				return T::None;
 			}
-		}else{
-			cerr<<"ผิดพลาด: ไม่สามารถเข้นถึงชุดข้อมูลด้วย ดัชนีที่ไม่ใช่ตัวเลข ที่ บรรทัด "
-				  << expr["line"] << ", คอลัมน์ " << expr["column"] <<"";
+			bytes({0xB8}); // mov eax, imm32
+			imm32(static_cast<uint32_t>(static_cast<const ExecInt *>(node)->value));
+			return T::Int;
+		case ExecKind::Float: {
+			if (seen != T::Double) {
+				return T::None;
+			}
+			uint64_t bits;
+			double value = static_cast<const ExecFloat *>(node)->value;
+			memcpy(&bits, &value, sizeof bits);
+			bytes({0x48, 0xB8}); // mov rax, imm64
+			imm64(bits);
+			bytes({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+			return T::Double;
 		}
+		case ExecKind::Variable: {
+			if (seen != T::Int && seen != T::Double) {
+				return T::None;
+			}
+			size_t at = static_cast<const ExecVariable *>(node)->slot * sizeof(EnvStruct) +
+						offsetof(EnvStruct, value);
+			bytes({0x80, 0xBF}); // cmp byte [rdi + disp32], imm8
+			imm32(static_cast<uint32_t>(at + Value::tagOffset()));
+			code.push_back(static_cast<uint8_t>(seen));
+			failIf({0x0F, 0x85}); // jne
+			if (seen == T::Int) {
+				bytes({0x8B, 0x87}); // mov eax, [rdi + disp32]
+			} else {
+				bytes({0xF2, 0x0F, 0x10, 0x87}); // movsd xmm0, [rdi + disp32]
+			}
+			imm32(static_cast<uint32_t>(at + Value::payloadOffset()));
+			return seen;
+		}
+		case ExecKind::BinaryOp: {
+			T type = binary(static_cast<const ExecBinary &>(*node));
+			return type == seen ? type : T::None;
+		}
+		default:
+			return T::None;
+		}
+	}
 
+	// An operand of a double operation, converted to double if it is an int.
+	bool doubleOperand(const ExecNode *node, Value::Type seen) {
+		Value::Type type = operand(node, seen);
+		if (type == Value::Type::Int) {
+			bytes({0xF2, 0x0F, 0x2A, 0xC0}); // cvtsi2sd xmm0, eax
+		}
+		return type == Value::Type::Int || type == Value::Type::Double;
+	}
 
-
-		if (!(std::holds_alternative<ValueHolder::ArraY>(arrayVal->data) ||
-			  std::holds_alternative<std::string>(arrayVal->data))) {
-			std::cerr << "ผิดพลาด: ไม่สามารถเข้าถึงข้อมูลประเภทนี้ด้วยดัชนี ที่ บรรทัด "
-					  << expr["line"] << ", คอลัมน์ " << expr["column"] << "";
-			exit(1);
+	// Same results as applyBinary for the operand types the node saw.
+	Value::Type binary(const ExecBinary &node) {
+		using T = Value::Type;
+		T l = node.seenLeft, r = node.seenRight;
+		bool numeric = (l == T::Int || l == T::Double) && (r == T::Int || r == T::Double);
+		if (!node.knownOp || node.mixed || !numeric) {
+			return T::None;
 		}
 
-		if (std::holds_alternative<ValueHolder::ArraY>(arrayVal->data)) {
-			auto &arr = std::get<ValueHolder::ArraY>(arrayVal->data);
-			if (index >= static_cast<int>(arr.size())) {
-				std::cerr << "ผิดพลาด : ดัชนีเกินขอบเขต ที่ บรรทัด "
-						  << expr["line"] << ", คอลัมน์ " << expr["column"] << "";
-				exit(1);
+		if (l == T::Int && r == T::Int && node.op != TokenType::DIVISION) {
+			const uint8_t *setcc = nullptr;
+			static const uint8_t setl[] = {0x0F, 0x9C, 0xC0}, setle[] = {0x0F, 0x9E, 0xC0},
+								 setg[] = {0x0F, 0x9F, 0xC0}, setge[] = {0x0F, 0x9D, 0xC0},
+								 sete[] = {0x0F, 0x94, 0xC0}, setne[] = {0x0F, 0x95, 0xC0};
+			switch (node.op) {
+			case TokenType::ADDITION: case TokenType::SUBTRACTION:
+			case TokenType::MULTIPLICATION: case TokenType::MODULAS:
+			case TokenType::BITWISE_AND: case TokenType::BITWISE_OR: case TokenType::XOR:
+				break;
+			case TokenType::LESSER: setcc = setl; break;
+			case TokenType::LESSEROREQUAL: setcc = setle; break;
+			case TokenType::GREATER: setcc = setg; break;
+			case TokenType::GREATEROREQUAL: setcc = setge; break;
+			case TokenType::EQUALTO: setcc = sete; break;
+			case TokenType::NOTEQUAL: setcc = setne; break;
+			default:
+				return T::None;
 			}
-			return arr[index];
-		} else {
-			auto &arr = std::get<std::string>(arrayVal->data);
-			if (index >= static_cast<int>(arr.size())) {
-				std::cerr << "ผิดพลาด : ดัชนีเกินขอบเขต ที่ บรรทัด "
-						  << expr["line"] << ", คอลัมน์ " << expr["column"] << "";
-				exit(1);
+			if (operand(node.left.get(), l) == T::None) {
+				return T::None;
+			}
+			bytes({0x50}); // push rax
+			if (operand(node.right.get(), r) == T::None) {
+				return T::None;
+			}
+			bytes({0x89, 0xC1, 0x58}); // mov ecx, eax; pop rax
+			if (setcc) {
+				bytes({0x39, 0xC8}); // cmp eax, ecx
+				code.insert(code.end(), setcc, setcc + 3);
+				bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+				return T::Bool;
+			}
+			switch (node.op) {
+			case TokenType::ADDITION: bytes({0x01, 0xC8}); break;		 // add eax, ecx
+			case TokenType::SUBTRACTION: bytes({0x29, 0xC8}); break;	 // sub eax, ecx
+			case TokenType::MULTIPLICATION: bytes({0x0F, 0xAF, 0xC1}); break; // imul eax, ecx
+			case TokenType::BITWISE_AND: bytes({0x21, 0xC8}); break;	 // and eax, ecx
+			case TokenType::BITWISE_OR: bytes({0x09, 0xC8}); break;		 // or eax, ecx
+			case TokenType::XOR: bytes({0x31, 0xC8}); break;			 // xor eax, ecx
+			default: // MODULAS
+				bytes({0x85, 0xC9});		 // test ecx, ecx
+				failIf({0x0F, 0x84});		 // je
+				bytes({0x83, 0xF9, 0xFF});	 // cmp ecx, -1
+				failIf({0x0F, 0x84});		 // je
+				bytes({0x99, 0xF7, 0xF9, 0x89, 0xD0}); // cdq; idiv ecx; mov eax, edx
+				break;
 			}
-			return make_shared<ValueHolder>(std::string(1, arr[index]));
+			return T::Int;
 		}
 
+		switch (node.op) {
+		case TokenType::ADDITION: case TokenType::SUBTRACTION:
+		case TokenType::MULTIPLICATION: case TokenType::DIVISION:
+		case TokenType::LESSER: case TokenType::LESSEROREQUAL:
+		case TokenType::GREATER: case TokenType::GREATEROREQUAL:
+			break;
+		default:
+			return T::None;
+		}
+		if (!doubleOperand(node.left.get(), l)) {
+			return T::None;
+		}
+		bytes({0x48, 0x83, 0xEC, 0x08, 0xF2, 0x0F, 0x11, 0x04, 0x24}); // sub rsp, 8; movsd [rsp], xmm0
+		if (!doubleOperand(node.right.get(), r)) {
+			return T::None;
+		}
+		bytes({0x66, 0x0F, 0x28, 0xC8,	// movapd xmm1, xmm0
+			   0xF2, 0x0F, 0x10, 0x04, 0x24, 0x48, 0x83, 0xC4, 0x08}); // movsd xmm0, [rsp]; add rsp, 8
+		switch (node.op) {
+		case TokenType::ADDITION: bytes({0xF2, 0x0F, 0x58, 0xC1}); return T::Double; // addsd
+		case TokenType::SUBTRACTION: bytes({0xF2, 0x0F, 0x5C, 0xC1}); return T::Double; // subsd
+		case TokenType::MULTIPLICATION: bytes({0xF2, 0x0F, 0x59, 0xC1}); return T::Double; // mulsd
+		case TokenType::DIVISION: bytes({0xF2, 0x0F, 0x5E, 0xC1}); return T::Double; // divsd
+		// a NaN operand makes ucomisd set CF, so seta/setae give false like C++
+		case TokenType::GREATER: bytes({0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0}); break;
+		case TokenType::GREATEROREQUAL: bytes({0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0}); break;
+		case TokenType::LESSER: bytes({0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0}); break;
+		default: bytes({0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0}); break; // LESSEROREQUAL
+		}
+		bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+		return T::Bool;
+	}
 
-	}else if (type == "FunctionCall") {
-	    string funcname;
-	    try {
-	        funcname = expr["name"]["name"].get<string>();
-	    } catch (json::type_error& e) {
-	        cerr << "ชื่อโปรแกรมไม่ถูกต้อง (ต้องเป็นตัวแปร) ที่บรรทัด "
-	             << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	        exit(1);
-	    }
-
-	    string ns;
-	    if (expr.contains("namespace") && !expr["namespace"].is_null()) {
-	        try {
-	            ns = expr["namespace"]["name"].get<string>();
-	        } catch (json::type_error& e) {
-	            cerr << "Namespace ต้องเป็นตัวแปร ที่บรรทัด "
-	                 << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	    }
+	// One whole routine for root; false (and nothing emitted) if it does not
+	// compile.
+	bool routine(const ExecBinary &root) {
+		size_t start = code.size();
+		failJumps.clear();
+		bytes({0x53, 0x48, 0x89, 0xE3}); // push rbx; mov rbx, rsp
+		Value::Type type = binary(root);
+		if (type == Value::Type::None) {
+			code.resize(start);
+			return false;
+		}
+		bytes({0xC6, 0x86}); // mov byte [rsi + disp32], imm8
+		imm32(static_cast<uint32_t>(Value::tagOffset()));
+		code.push_back(static_cast<uint8_t>(type));
+		if (type == Value::Type::Double) {
+			bytes({0xF2, 0x0F, 0x11, 0x86}); // movsd [rsi + disp32], xmm0
+		} else {
+			bytes({0x48, 0x89, 0x86}); // mov [rsi + disp32], rax
+		}
+		imm32(static_cast<uint32_t>(Value::payloadOffset()));
+		bytes({0x5B, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xC3}); // pop rbx; mov eax, 1; ret
+
+		size_t fail = code.size();
+		bytes({0x48, 0x89, 0xDC, 0x5B, 0x31, 0xC0, 0xC3}); // mov rsp, rbx; pop rbx; xor eax, eax; ret
+		for (size_t at : failJumps) {
+			uint32_t rel = static_cast<uint32_t>(fail - (at + 4));
+			memcpy(&code[at], &rel, sizeof rel);
+		}
+		return true;
+	}
+};
 
-	    vector<Value> args;
-	    for (auto &arg : expr["argument"]) {
-	        args.push_back(evalExpr(arg));
-	    }
+// Finds the outermost BinaryOp trees under node that compile.
+void jitNode(ExecNode &node, JitEmitter &emitter,
+			 vector<pair<const ExecBinary *, size_t>> &routines) {
+	if (node.kind == ExecKind::BinaryOp) {
+		const auto &expr = static_cast<const ExecBinary &>(node);
+		if (expr.jit || expr.jitMisses) {
+			return; // inside a loop that was compiled before the code around it
+		}
+		size_t at = emitter.code.size();
+		if (emitter.routine(static_cast<const ExecBinary &>(node))) {
+			routines.push_back({static_cast<const ExecBinary *>(&node), at});
+			return;
+		}
+	}
+	forEachChild(node, [&](ExecNodePtr &child) { jitNode(*child, emitter, routines); });
+}
 
-	    // เรียกจาก namespace
-	    if (!ns.empty()) {
-	        if (importModules.find(ns) == importModules.end()) {
-	            cerr << "ไม่พบเนมสเปซ: \"" << ns << "\" ที่บรรทัด "
-	                 << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	        auto &functions = importModules[ns];
-	        if (functions.find(funcname) == functions.end()) {
-	            cerr << "โปรแกรม \"" << funcname << "\" ไม่พบในเนมสเปซ \"" << ns
-	                 << "\" ที่บรรทัด " << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	        const functionDef &def = functions[funcname];
-	        return evalFunctionFromParts(def.parameter, def.body, args);
-	    }
-	    // เรียกฟังก์ชันโลคัล
-	    else {
-	        if (functionTable.find(funcname) == functionTable.end()) {
-	            cerr << "โปรแกรม '" << funcname << "' ยังไม่ถูกประกาศ ที่บรรทัด "
-	                 << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	        const functionDef& def = functionTable[funcname];
-	        if (args.size() != def.parameter.size()) {
-	            cerr << "จำนวนอากิวเมนต์ไม่ตรงกัน สำหรับ '" << funcname << "' ต้องการ "
-	                 << def.parameter.size() << ", ได้รับ " << args.size()
-	                 << " ที่บรรทัด " << expr["line"] << " คอลัมน์ " << expr["column"] << "";
-	            exit(1);
-	        }
-	        return evalFunctionFromParts(def.parameter, def.body, args);
-	    }
+// Routines stay mapped until the process exits, like the bodies they belong
+// to. key is the function body or loop the roots come from.
+void jitCompile(const void *key, const vector<ExecNode *> &roots) {
+	static unordered_set<const void *> compiled;
+	if (!compiled.insert(key).second) {
+		return;
 	}
- else if (type == "Length") {
-		Value target = evalExpr(expr["target"]);
-		if (holds_alternative<ValueHolder::ArraY>(target->data)) {
-			return std::make_shared<ValueHolder>(static_cast<int>(
-				std::get<ValueHolder::ArraY>(target->data).size()));
-		} else if (holds_alternative<ValueHolder::ObjecT>(target->data)) {
-			return std::make_shared<ValueHolder>(static_cast<int>(
-				std::get<ValueHolder::ObjecT>(target->data).size()));
-		} else if (holds_alternative<string>(target->data)) {
-			return std::make_shared<ValueHolder>(
-				static_cast<int>(std::get<string>(target->data).size()));
-		}
-		std::cerr << "เกิดข้อพิดพลาด: ขนาด() ไม่รองรับข้อมูลประเภทนี้ ที่บรรทัด : "
-				  << expr["line"] << ", คอลัม์: " << expr["column"] << "";
-		exit(1);
+	vector<uint8_t> code;
+	JitEmitter emitter{code, {}};
+	vector<pair<const ExecBinary *, size_t>> routines;
+	for (ExecNode *root : roots) {
+		jitNode(*root, emitter, routines);
+	}
+	if (routines.empty()) {
+		return;
+	}
+
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t size = (code.size() + page - 1) / page * page;
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		return;
+	}
+	memcpy(memory, code.data(), code.size());
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		return;
+	}
+	for (const auto &[node, at] : routines) {
+		node->jit = reinterpret_cast<JitCode>(static_cast<uint8_t *>(memory) + at);
 	}
-	cerr << "ไม่มี expression นี้ ที่ บรรทัด " << expr["line"]
-		 << ", คอลัม์: " << expr["column"] << "";
-	exit(1);
 }
-void printValue(const Value &val) {
-	struct {
-		void operator()(std::monostate) const { std::cout << "ว่าง"; }
-		void operator()(int v) const { std::cout << v; }
-		void operator()(double v) const { std::cout << v; }
-		void operator()(const std::string &v) const {
-			std::cout <<v;
-		}
-		void operator()(bool v) const { std::cout << (v ? "จริง" : "เท็จ"); }
-		void operator()(const ValueHolder::ArraY &arr) const {
-			std::cout << "[";
-			bool first = true;
-			for (const auto &e : arr) {
-				if (!first)
-					std::cout << ", ";
-				printValue(e); // เรียกซ้ำ
-				first = false;
-			}
-			std::cout << "]";
-		}
-		void operator()(const ValueHolder::ObjecT &obj) const {
-			std::cout << "{";
-			bool first = true;
-			for (const auto &[k, v] : obj) {
-				if (!first)
-					std::cout << ", ";
-				std::cout << '"' << k << "\": ";
-				printValue(v); // เรียกซ้ำ
-				first = false;
-			}
-			std::cout << "}";
-		}
-	} visitor;
-
-	std::visit(visitor, val->data);
+
+void jitFunction(const vector<ExecNodePtr> &body) {
+	vector<ExecNode *> roots;
+	for (const auto &stmt : body) {
+		roots.push_back(stmt.get());
+	}
+	jitCompile(&body, roots);
 }
-struct ReturnException : public std::exception {
-	Value returnValue;
-	ReturnException(const Value &val) :
-		returnValue(val) {}
-};
 
-class BreakException : public std::exception {};
-class ContinueException : public std::exception {};
+// a loop that went hot in the tree walker: its condition and body compile in
+// place, and the iteration after the current one runs the routines
+void jitLoop(const ExecNode &loop) {
+	jitCompile(&loop, {const_cast<ExecNode *>(&loop)});
+}
 
-// evalStatement
+const bool jitSupported = true;
+#else
+void jitFunction(const vector<ExecNodePtr> &) {}
+void jitLoop(const ExecNode &) {}
 
-Value evalStatement(const json &stmt) {
-	if (!stmt.is_object()) {
-		cerr << "❌ stmt ไม่ใช่ json object แต่เป็น: " << stmt << "";
-		exit(1);
-	}
+const bool jitSupported = false;
+#endif
 
+void countCall(const functionDef &def) {
+	if (def.body && ++def.calls == runOptions.jitThreshold) {
+		jitFunction(*def.body);
+	}
+}
 
-	string type = stmt["type"];
+// A compiled node whose guards fail this often goes back to the tree walker.
+const uint32_t jitMissLimit = 64;
 
-	if (type == "print") {
-	  // ตรวจสอบว่า expression เป็น array
-	  if (!stmt.contains("expression") || !stmt["expression"].is_array()) {
-	    cerr << " print ต้องการ array ของ expressions\n";
-	    exit(1);
-	  }
+Value evalExpr(const ExecNode *node);
+Value callInlined(const ExecCall &site, vector<Value> &stack);
+Value evalProven(const ExecBinary &site);
 
-	  // ดึง array ออกมาก่อน
-	  json exprArray = stmt["expression"];
+// ++/-- on a variable, element or field changes it; see stepValue
+Value evalStep(TokenType op, const ExecNode *target) {
+	switch (target->kind) {
+	case ExecKind::Variable: {
+		int slot = static_cast<const ExecVariable *>(target)->slot;
+		Value &value = lookvar(slot, target->line, target->column)->value;
+		return stepValue(op, value, target->line, target->column);
+	}
+	case ExecKind::ObjectAccess: {
+		const auto &access = static_cast<const ExecObjectAccess &>(*target);
+		Value obj = evalExpr(access.object.get());
+		string key = access.dotKey ? access.keyName
+								   : objectKeyOf(evalExpr(access.key.get()),
+												 access.line, access.column);
+		return stepValue(op, objectField(obj, key, access.line, access.column),
+						 access.line, access.column);
+	}
+	case ExecKind::ArrayAccess: {
+		const auto &access = static_cast<const ExecArrayAccess &>(*target);
+		Value arrayVal = evalExpr(access.array.get());
+		Value indexVal = evalExpr(access.index.get());
+		return stepIndexed(op, arrayVal, indexVal, access.line, access.column);
+	}
+	default:
+		return applyUnary(op, evalExpr(target), target->line, target->column);
+	}
+}
 
-	  for (const auto& expr : exprArray) {
-	    Value val = evalExpr(expr);
-	    printValue(val);
-	   // cout << " ";
-	  }
-	  cout << "";
-	  return nullptr;
-	}  else if (type == "block") {
-		env.push_back({});
-		for (const auto &s : stmt["statements"]) {
-			evalStatement(s);
-		}
-		env.pop_back();
-		return nullptr;
-	} else if (type == "if") {
-		if (get<bool>(evalExpr(stmt["condition"])->data)) {
-			for (const auto &s : stmt["body"]["statements"]) {
-				Value result = evalStatement(s);
-				if (result)
-					return result;
-			}
-		} else {
-			// ✅ ตรวจว่า elif มีจริง และเป็น array ที่ไม่ว่าง
-			if (stmt.contains("elif") && stmt["elif"].is_array() && !stmt["elif"].empty()) {
-				for (const auto &elifStmt : stmt["elif"]) {
-					if (get<bool>(evalExpr(elifStmt["condition"])->data)) {
-						for (const auto &s : elifStmt["body"]["statements"]) {
-							Value result = evalStatement(s);
-							if (result)
-								return result;
-						}
-						return nullptr; // ✅ ถ้า elif ตรงเงื่อนไข ให้หยุดที่นี่
-					}
-				}
-			}
+// evalExper
+// shared_ptr<ASTNode> parseFunctionFromJSON(const json &j);
+Value evalExpr(const ExecNode *node) {
+	switch (node->kind) {
+	case ExecKind::Invalid:
+		cerr << "❌ expr ไม่ใช่ json object แต่เป็น: "
+			 << static_cast<const ExecInvalid *>(node)->text << "";
+		exit(1);
+	case ExecKind::Int:
+		return Value(static_cast<const ExecInt *>(node)->value);
+	case ExecKind::Float:
+		return Value(static_cast<const ExecFloat *>(node)->value);
+	case ExecKind::Bool:
+		return Value(static_cast<const ExecBool *>(node)->value);
+	case ExecKind::String:
+		return Value(static_cast<const ExecString *>(node)->value);
+	case ExecKind::Null:
+		return Value(monostate{});
+	case ExecKind::Variable: {
+		EnvStruct *var = lookvar(static_cast<const ExecVariable *>(node)->slot,
+								 node->line, node->column);
+		return var->value;
+	}
 
-			// ✅ else ทำงานเมื่อไม่มี elif ใดๆ ตรงเลย
-			if (stmt.contains("else") && stmt["else"].is_object()) {
-				for (const auto &s : stmt["else"]["body"]["statements"]) {
-					Value result = evalStatement(s);
-					if (result)
-						return result;
-				}
-			}
+	case ExecKind::ArrayLiteral: {
+		ValueHolder::ArraY arr;
+		for (const auto &a : static_cast<const ExecArrayLiteral *>(node)->elements) {
+			arr.push_back(evalExpr(a.get()));
 		}
-		return nullptr;
+		return Value(arr);
 	}
+	case ExecKind::ObjectLiteral: {
+		ValueHolder::ObjecT obj;
 
-	else if (type == "assignment") {
-	    const auto &target = stmt["variable"];
-	    Value val = evalExpr(stmt["value"]);
-	    if (target["type"] == "variable") {
-	        string name = target["name"];
+		for (const auto &[keyNode, valueNode] :
+			 static_cast<const ExecObjectLiteral *>(node)->properties) {
+			Value keyVal = evalExpr(keyNode.get());
+			string key = literalKeyOf(keyVal, keyNode->line, keyNode->column);
+			Value val = evalExpr(valueNode.get());
+			obj[key] = val;
+		}
 
-	        // Fix: Check if isconst exists and get it as boolean
-	        bool isConst = false;
-	        if (stmt.contains("isconst")) {
-	            if (stmt["isconst"].is_boolean()) {
-	                isConst = stmt["isconst"].get<bool>();
-	            } else if (stmt["isconst"].is_string()) {
-	                isConst = (stmt["isconst"].get<string>() == "true");
-	            }
-	        }
+		return Value(obj);
+	}
 
-	        setvar(name, val, stmt["line"], stmt["column"], isConst);
-	    } else if (target["type"] == "ObjectAccess") {
-			Value obj = evalExpr(target["object"]);
-			Value key = evalExpr(target["key"]);
-			if (!holds_alternative<ValueHolder::ObjecT>(obj->data)) {
-				cerr << "ค่าที่จะกำหนดไม่ใช่ ออบเจต์ ที่บรรทัด " << stmt["line"]
-					 << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
-			}
-			get<ValueHolder::ObjecT>(obj->data)[get<string>(key->data)] = val;
-
-		} else if (target["type"] == "ArrayAccess") {
-			Value arr = evalExpr(target["array"]);
-			int index = get<int>(evalExpr(target["index"])->data);
-			if (!holds_alternative<ValueHolder::ArraY>(arr->data)) {
-				cerr << "ค่าที่จะกำหนดไม่ใช่ ชุดข้อมูล ที่บรรทัด " << stmt["line"]
-					 << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
-			}
-			auto &vec = get<ValueHolder::ArraY>(arr->data);
-			if (index < 0 || index >= vec.size()) {
-				cerr << "index ของ array เกินขอบเขต ที่บรรทัด " << stmt["line"]
-					 << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
-			}
-			vec[index] = val;
-		} else {
-			cerr << "ไม่สามารถกำหนดค่าสิ่งนี้ได้ ที่บรรทัด " << stmt["line"] << " คอลัมน์ "
-				 << stmt["column"] << "";
+	// pimary
+	case ExecKind::UnaryOp: {
+		const auto &expr = static_cast<const ExecUnary &>(*node);
+		if (expr.knownOp &&
+			(expr.op == TokenType::INCREMENT || expr.op == TokenType::DECREMENT)) {
+			return evalStep(expr.op, expr.operand.get());
+		}
+		Value operand = evalExpr(expr.operand.get());
+		if (!expr.knownOp) {
+			break;
+		}
+		return applyUnary(expr.op, operand, expr.line, expr.column);
+	}
+	case ExecKind::Ln: {
+		Value val = evalExpr(static_cast<const ExecLn *>(node)->value.get());
+		return naturalLog(val, node->line, node->column);
+	}
+	case ExecKind::BinaryOp: {
+		const auto &expr = static_cast<const ExecBinary &>(*node);
+		if (expr.jit) {
+			Value out;
+			if (expr.jit(variables.data(), &out)) {
+				return out;
+			}
+			if (++expr.jitMisses == jitMissLimit) {
+				expr.jit = nullptr;
+			}
+		}
+		if (expr.proven != Value::Type::None) {
+			return evalProven(expr);
+		}
+		Value left = evalExpr(expr.left.get());
+		Value right = evalExpr(expr.right.get());
+		if (!expr.knownOp) {
+			break;
+		}
+		return evalBinary(expr, left, right);
+	}
+	case ExecKind::Convert: {
+		const auto &expr = static_cast<const ExecConvert &>(*node);
+		Value exp = evalExpr(expr.expression.get());
+		return convertValue(expr.target, exp, expr.line, expr.column);
+	}
+	case ExecKind::ObjectAccess: {
+		const auto &expr = static_cast<const ExecObjectAccess &>(*node);
+		Value obj = evalExpr(expr.object.get());
+		// ตรวจสอบว่า key เป็น variable node หรือไม่ (dot notation)
+		if (expr.dotKey) {
+			return getObjectField(obj, expr.keyName, expr.line, expr.column);
+		}
+		string key = objectKeyOf(evalExpr(expr.key.get()), expr.line, expr.column);
+		return getObjectField(obj, key, expr.line, expr.column);
+	}
+	case ExecKind::ArrayAccess: {
+		const auto &expr = static_cast<const ExecArrayAccess &>(*node);
+		Value arrayVal = evalExpr(expr.array.get());
+		Value indexVal = evalExpr(expr.index.get());
+		if (expr.inBounds) {
+			return getInBounds(arrayVal, indexVal, expr.line, expr.column);
+		}
+		return getIndexed(arrayVal, indexVal, expr.line, expr.column);
+	}
+	case ExecKind::FunctionCall: {
+		const auto &expr = static_cast<const ExecCall &>(*node);
+		if (expr.badName) {
+			cerr << "ชื่อโปรแกรมไม่ถูกต้อง (ต้องเป็นตัวแปร) ที่บรรทัด "
+				 << expr.line << " คอลัมน์ " << expr.column << "";
+			exit(1);
+		}
+		if (expr.badNamespace) {
+			cerr << "Namespace ต้องเป็นตัวแปร ที่บรรทัด "
+				 << expr.line << " คอลัมน์ " << expr.column << "";
 			exit(1);
 		}
 
-		return nullptr;
-	} else if (type == "input") {
-		string name = stmt["variable"]["name"];
-		string in;
-		getline(cin, in);
-		setvar(name, make_shared<ValueHolder>(in), stmt["line"],
-			   stmt["column"],false);
-		return nullptr;
-	} else if (type == "Break") {
-		throw BreakException();
-	} else if (type == "Continue") {
-		throw ContinueException();
-	} else if (type == "whileloop") {
-		while (getBool(evalExpr(stmt["condition"]))) {
-			try {
-
-				 env.push_back({});
+		for (auto &arg : expr.args) {
+			Value v = evalExpr(arg.get());
+			callArgs.push_back(std::move(v));
+		}
+		if (expr.inlined) {
+			return callInlined(expr, callArgs);
+		}
+		const functionDef &def = resolveCall(expr.cache, expr.ns, expr.name,
+											 expr.args.size(), expr.line, expr.column);
+		if (runOptions.jit) {
+			countCall(def);
+		}
+		enterCall(expr.line, expr.column);
+		Value ret = evalFunctionFromParts(def, expr.args.size());
+		callDepth--;
+		return ret;
+	}
+	case ExecKind::Length: {
+		Value target = evalExpr(static_cast<const ExecLength *>(node)->target.get());
+		return lengthOf(target, node->line, node->column);
+	}
+	case ExecKind::Temp: {
+		const auto &temp = static_cast<const ExecTemp &>(*node);
+		if (!temp.value) {
+			return temps[temp.index];
+		}
+		return temps[temp.index] = evalExpr(temp.value.get());
+	}
+	default:
+		break;
+	}
+	unknownExpression(node->line, node->column);
+}
+functionDef makeFunctionDef(const ExecFunction &decl) {
+	functionDef def;
+	def.name = decl.name;
+	def.parameter = decl.parameters; // ✅ ต้องเก็บไว้ตรงนี้
+	def.body = &decl.body;
+	return def;
+}
 
+void exportFunctions(const ExecExport &exportStmt) {
+	for (const auto &func : exportStmt.functions) {
+		functionDef def = makeFunctionDef(*func);
+		exportedFunctions[func->name] = def;
+		functionTable[func->name] = def;
+	}
+}
 
-				// ทำซ้ำ block
-				const json &body = stmt["body"];
-				if (body["type"] == "block") {
-					for (const auto &s : body["statements"]) {
-						evalStatement(s);
-					}
-				} else {
-					evalStatement(body);
-				}
+// Where the module an import names lives
+std::filesystem::path modulePath(const ExecImport &importStmt) {
+    namespace fs = std::filesystem;
 
-				env.pop_back();
+    const string &filename = importStmt.file;
 
+    // path ของไฟล์แม่ (กรณี import ซ้อน)
+    const string &currentFilePath = importStmt.currentFilePath;
 
-			} catch (const ContinueException &) {
-				// ข้ามไปยังรอบถัดไป
-				continue;
-			} catch (const BreakException &) {
-				// ออกจากลูป
-				break;
-			}
-		}
-		return nullptr;
-	} else if (type == "dowhileloop") {
-		do {
-			try {
+    fs::path filePath;
+    fs::path inputPath(filename);
 
-				env.push_back({});
+    if (inputPath.is_absolute()) {
+        // 1️⃣ ระบุ absolute path → ใช้ตรง ๆ
+        filePath = inputPath;
+    }
+    else if (!currentFilePath.empty()) {
+        // 2️⃣ import ซ้อน → อิงจากไฟล์แม่
+        fs::path parentPath = fs::path(currentFilePath).parent_path();
+        filePath = parentPath / inputPath;
+    }
+    else {
+        // 3️⃣ ไม่ระบุ path → ใช้ <exe>/lib/
+        fs::path exeDir = getExeDir();
+        filePath = exeDir / "lib" / inputPath;
+    }
 
+    return fs::absolute(filePath);
+}
 
-				// ทำซ้ำ block
-				const json &body = stmt["body"];
-				if (body["type"] == "block") {
-					for (const auto &s : body["statements"]) {
-						evalStatement(s);
-					}
-				} else {
-					evalStatement(body);
-				}
+// The AST in the module file, with its path noted on each statement for the
+// imports inside it. line and column are those of the import; with report
+// false a file that can not be used gives nullptr instead of an error.
+ASTNodePtr readModule(const std::filesystem::path &filePath, int line,
+                      int column, bool report) {
+    using namespace std;
+    namespace fs = std::filesystem;
+
+    if (!fs::exists(filePath)) {
+        if (!report) {
+            return nullptr;
+        }
+        cerr << "ไม่พบไฟล์ '" << filePath
+             << "' ที่บรรทัด " << line
+             << " คอลัมน์ " << column << "";
+        exit(1);
+    }
 
-				env.pop_back();
+    ifstream inFile(filePath);
+    if (!inFile.is_open()) {
+        if (!report) {
+            return nullptr;
+        }
+        cerr << "ไม่สามารถเปิดไฟล์ '" << filePath
+             << "' ได้ ที่บรรทัด " << line
+             << " คอลัมน์ " << column << "";
+        exit(1);
+    }
 
+    stringstream buffer;
+    buffer << inFile.rdbuf();
+    inFile.close();
 
-			} catch (const ContinueException &) {
-				// ข้ามไปยังรอบถัดไป
-				continue;
-			} catch (const BreakException &) {
-				// ออกจากลูป
-				break;
-			}
-		} while (getBool(evalExpr(stmt["condition"])));
-		return nullptr;
-	}else if (type == "forloop") {
-	    // สร้าง scope สำหรับตัวแปรลูป
-	    env.push_back({});
+    string content = buffer.str();
+    if (content.empty()) {
+        if (!report) {
+            return nullptr;
+        }
+        cerr << "ไฟล์ '" << filePath
+             << "' ว่างเปล่า! ที่บรรทัด "
+             << line << " คอลัมน์ "
+             << column << "";
+        exit(1);
+    }
 
-	    // 1. กำหนดค่าเริ่มต้นให้ตัวแปร
-	    string varName = stmt["variable"]["name"];
-	    Value initVal = evalExpr(stmt["initialization"]);
-	    setvar(varName, initVal, stmt["line"], stmt["column"], false);
+    json importedAST;
+    try {
+        importedAST = json::parse(content);
+    } catch (const json::parse_error& e) {
+        if (!report) {
+            return nullptr;
+        }
+        cerr << "ไฟล์ที่นำเข้าต้องมีสกุลเป็น .json ที่บรรทัด " << line << " คอลัมน์ "
+	             << column << "";
+        exit(1);
+    }
 
-	    // 2. ประเมินค่าสิ้นสุดและขั้นตอน
-	    Value stopVal = evalExpr(stmt["condition"]);
-	    Value stepVal = evalExpr(stmt["changevalue"]);
-
-	    // ฟังก์ชันแปลง Value เป็น double
-	    auto to_double = [](Value v) -> double {
-	        if (holds_alternative<int>(v->data)) return get<int>(v->data);
-	        else if (holds_alternative<double>(v->data)) return get<double>(v->data);
-	        else {
-	            cerr << "ในลูปต้องเป็นตัวเลข" << endl;
-	            exit(1);
-	        }
-	    };
+    // ส่ง path ปัจจุบันให้ import ซ้อน
+    for (auto& innerStmt : importedAST["statements"]) {
+        innerStmt["__currentFilePath"] = filePath.string();
+    }
+    return nodeFromJson(importedAST);
+}
 
-	    double step = to_double(stepVal);
-	    if (step == 0) {
-	        cerr << "ขั้นตอนที่3ต้องไม่เป็นศูนย์ ที่บรรทัด " << stmt["line"]
-	             << " คอลัมน์ " << stmt["column"] << endl;
-	        exit(1);
-	    }
+// Modules findReachableFunctions already lowered, by path, until imported
+unordered_map<string, ExecNodePtr> preloadedModules;
+
+void importModule(const ExecImport &importStmt) {
+    const string &namespaceName = importStmt.name;
+
+    std::filesystem::path filePath = modulePath(importStmt);
+    auto preloaded = preloadedModules.find(filePath.string());
+    if (preloaded != preloadedModules.end()) {
+        ExecNodePtr program = std::move(preloaded->second);
+        preloadedModules.erase(preloaded);
+        runProgram(std::move(program), false);
+    } else {
+        evalProgram(readModule(filePath, importStmt.line, importStmt.column, true),
+                    false);
+    }
+    importModules[namespaceName] = exportedFunctions;
+    exportedFunctions.clear();
+    moduleGeneration++;
+}
 
-	    // ฟังก์ชันตรวจสอบเงื่อนไข
-	    auto condition_met = [&]() -> bool {
-	        Value cur = getVar(varName, stmt["line"], stmt["column"]);
-	        double current_val = to_double(cur);
-	        double stop = to_double(stopVal);
-	        if (step > 0) {
-	            return current_val < stop;
-	        } else {
-	            return current_val > stop;
-	        }
-	    };
+// นำเข้า in C++ output (see runtime.h). From here on the program's calls may
+// reach the module's functions, which run in the tree walker.
+void importModule(const string &file, const string &name,
+                  const string &currentFilePath, int line, int column) {
+    callFunction = evalFunctionFromParts;
+    ExecImport importStmt;
+    importStmt.kind = ExecKind::Import;
+    importStmt.line = line;
+    importStmt.column = column;
+    importStmt.file = file;
+    importStmt.name = name;
+    importStmt.currentFilePath = currentFilePath;
+    importModule(importStmt);
+}
 
-	    // วนลูปตราบใดที่เงื่อนไขเป็นจริง
-	    while (condition_met()) {
-	        try {
-	            // สร้าง scope สำหรับ body ของลูป
-	            env.push_back({});
-
-	            // ประมวลผล body
-	            const json &body = stmt["body"];
-	            if (body["type"] == "block") {
-	                for (const auto &s : body["statements"]) {
-	                    evalStatement(s);
-	                }
-	            } else {
-	                evalStatement(body);
-	            }
+// Unused function elimination
+//
+// With --opt=1 and up, loading the entry program also reads and lowers the
+// modules its imports reach, and collects in reachableFunctions every
+// function name a call can get to: the names called outside any declaration,
+// then those called in the body of a function whose name is already in.
+// Calls go by name, which covers namespaced calls and the functions every
+// program sees through functionTable alike. Each program then drops its
+// top-level declarations and exported functions with other names before it
+// runs. A module that can not be read is left for its import to report.
+unordered_set<string> reachableFunctions;
+bool functionsPruned = false; // reachableFunctions has been worked out
+
+// The calls and imports under node, in function bodies too
+void collectCalls(ExecNode &node, vector<string> &calls,
+				  vector<const ExecImport *> &imports) {
+	forEachNode(node, [&](ExecNode &n) {
+		if (n.kind == ExecKind::FunctionCall) {
+			calls.push_back(static_cast<ExecCall &>(n).name);
+		} else if (n.kind == ExecKind::Import) {
+			imports.push_back(&static_cast<ExecImport &>(n));
+		}
+	});
+}
 
-	            env.pop_back(); // ลบ scope ของ body
-	        }
-	        catch (const ContinueException &) {
-	            env.pop_back(); // ลบ scope body ก่อน continue
-	            // อัปเดตค่าตัวแปรสำหรับรอบถัดไป
-	            Value cur = getVar(varName, stmt["line"], stmt["column"]);
-	            double new_val = to_double(cur) + step;
-
-	            // กำหนดค่าใหม่ (รักษา type เดิมถ้าเป็นไปได้)
-	            Value newVal;
-	            if (holds_alternative<int>(cur->data) && step == (int)step && new_val == (int)new_val) {
-	                newVal = make_shared<ValueHolder>((int)new_val);
-	            } else {
-	                newVal = make_shared<ValueHolder>(new_val);
-	            }
-	            setvar(varName, newVal, stmt["line"], stmt["column"], false);
-	            continue;
-	        }
-	        catch (const BreakException &) {
-	            env.pop_back(); // ลบ scope body ก่อน break
-	            break;
-	        }
+void findReachableFunctions(ExecProgram &entry) {
+	vector<ExecProgram *> programs{&entry};
+	unordered_map<string, vector<ExecFunction *>> declared;
+	vector<string> calls;
+	for (size_t i = 0; i < programs.size(); i++) {
+		vector<const ExecImport *> imports;
+		for (auto &stmt : programs[i]->statements) {
+			if (stmt->kind == ExecKind::FunctionDeclaration) {
+				auto &f = static_cast<ExecFunction &>(*stmt);
+				declared[f.name].push_back(&f);
+			} else if (stmt->kind == ExecKind::Export) {
+				for (auto &f : static_cast<ExecExport &>(*stmt).functions) {
+					declared[f->name].push_back(f.get());
+				}
+			} else {
+				collectCalls(*stmt, calls, imports);
+				continue;
+			}
+			// a declared body may import too
+			vector<string> inBody;
+			collectCalls(*stmt, inBody, imports);
+		}
+		for (const ExecImport *import : imports) {
+			string path = modulePath(*import).string();
+			if (preloadedModules.count(path)) {
+				continue;
+			}
+			ExecNodePtr module;
+			try {
+				ASTNodePtr ast = readModule(path, 0, 0, false);
+				if (!ast) {
+					continue;
+				}
+				module = lowerNode(ast);
+			} catch (const exception &) {
+				continue;
+			}
+			if (module->kind == ExecKind::Program) {
+				programs.push_back(static_cast<ExecProgram *>(module.get()));
+			}
+			preloadedModules[path] = std::move(module);
+		}
+	}
 
-	        // อัปเดตค่าตัวแปรหลังจากจบ body
-	        Value cur = getVar(varName, stmt["line"], stmt["column"]);
-	        double new_val = to_double(cur) + step;
+	while (!calls.empty()) {
+		string name = std::move(calls.back());
+		calls.pop_back();
+		if (!reachableFunctions.insert(name).second) {
+			continue;
+		}
+		vector<const ExecImport *> imports;
+		for (ExecFunction *f : declared[name]) {
+			for (auto &stmt : f->body) {
+				collectCalls(*stmt, calls, imports);
+			}
+		}
+	}
+	functionsPruned = true;
+}
 
-	        Value newVal;
-	        if (holds_alternative<int>(cur->data) && step == (int)step && new_val == (int)new_val) {
-	            newVal = make_shared<ValueHolder>((int)new_val);
-	        } else {
-	            newVal = make_shared<ValueHolder>(new_val);
-	        }
-	        setvar(varName, newVal, stmt["line"], stmt["column"], false);
-	    }
+void dropUnreachableFunctions(ExecProgram &program) {
+	auto unreachable = [](const ExecFunction &f) {
+		return !reachableFunctions.count(f.name);
+	};
+	auto &statements = program.statements;
+	statements.erase(remove_if(statements.begin(), statements.end(),
+							   [&](const ExecNodePtr &stmt) {
+								   return stmt->kind == ExecKind::FunctionDeclaration &&
+										  unreachable(static_cast<ExecFunction &>(*stmt));
+							   }),
+					 statements.end());
+	for (auto &stmt : statements) {
+		if (stmt->kind == ExecKind::Export) {
+			auto &functions = static_cast<ExecExport &>(*stmt).functions;
+			functions.erase(remove_if(functions.begin(), functions.end(),
+									  [&](const unique_ptr<ExecFunction> &f) {
+										  return unreachable(*f);
+									  }),
+							functions.end());
+		}
+	}
+}
 
-	    // ลบ scope ของลูป
-	    env.pop_back();
-	    return nullptr;
+// Inlining
+//
+// With --opt=1 and up, a call in the entry program runs its callee's body
+// in place when that body is nothing but คืนค่า statements, possibly under
+// ถ้า conditions, over expressions that call nothing and have at most
+// --inline-size nodes. callInlined binds the parameters the way a call
+// does, so one still overwrites a variable of its name that is bound
+// already, but it opens no scope and looks nothing up. That needs the call
+// to mean the same function every time it runs: the site has to come after
+// the top-level declaration or import it goes through, and that has to be
+// the only one of its name in the program and its modules. --jit keeps the
+// calls, since it compiles functions by how often they are called.
+unordered_map<const ExecFunction *, unique_ptr<InlineBody>> inlineBodies;
+
+Value callInlined(const ExecCall &site, vector<Value> &stack) {
+	const InlineBody &callee = *site.inlined;
+	enterCall(site.line, site.column);
+	size_t argc = callee.parameters.size();
+	Value *args = stack.data() + stack.size() - argc;
+	uint32_t bound = 0; // the parameters bound here, to unbind again
+	for (size_t i = 0; i < argc; i++) {
+		int slot = callee.parameters[i];
+		if (variables[slot].bound) {
+			setvar(slot, std::move(args[i]), 0, 0, false);
+		} else {
+			variables[slot] = {std::move(args[i]), false, true};
+			bound |= 1u << i;
+		}
 	}
- else if (type == "return") {
-		Value val = evalExpr(stmt["value"]);
-		throw ReturnException(val);
-		return nullptr;
-	}else if (type == "functionDeclaretion") {
-		string funcName = stmt["name"];
-		vector<string> parameterName;
-		for (const auto &a : stmt["parameter"]) {
-			parameterName.push_back(a["variable"]["name"]);
-		}
-
-		functionDef func;
-		func.name = funcName;
-		func.parameter = parameterName; // ✅ ต้องเก็บไว้ตรงนี้
-		func.body = stmt["body"]["statements"];
-		functionTable[funcName] = func;
-		return nullptr;
+	stack.resize(stack.size() - argc);
+	Value result;
+	for (const auto &[condition, value] : callee.returns) {
+		if (!condition || evalExpr(condition->get()).as<bool>()) {
+			result = evalExpr(value->get());
+			break;
+		}
 	}
-else if (type == "Push") {
-		Value arrayVal = evalExpr(stmt["array"]);
-		Value value = evalExpr(stmt["value"]);
-		if(holds_alternative<ValueHolder::ArraY>(arrayVal->data)){
-			get<ValueHolder::ArraY>(arrayVal->data).push_back(value);
-		}
-		else if(holds_alternative<string>(arrayVal->data)){
-			Value val = evalExpr(stmt["value"]);
-			get<string>(arrayVal->data) += get<string>(val->data);
-		}else{
-			cerr << "ไม่สามารถเพิ่มสมาชิกเข้า  ชุดข้อมูลได้"
-				 << " ได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ "
-				 << "ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-			exit(1);
+	for (size_t i = 0; i < argc; i++) {
+		if (bound & (1u << i)) {
+			variables[callee.parameters[i]] = EnvStruct();
 		}
-		return nullptr;
 	}
-	else if (stmt["type"] == "Pop") {
-		Value arrayVal = evalExpr(stmt["array"]);
-		if(holds_alternative<ValueHolder::ArraY>(arrayVal->data)){
-		auto &arr = get<ValueHolder::ArraY>(arrayVal->data);
-		if (arr.empty()) {
-			cerr << "ไม่สามารถ ดึงข้อมูลออก จาก ชุดข้อมูล ที่ว่าง "
-				 << " ได้ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-			exit(1);
+	callDepth--;
+	return result;
+}
+
+// Whether node only reads, adding its nodes to size
+bool pureExpression(ExecNode &node, size_t &size) {
+	switch (node.kind) {
+	case ExecKind::UnaryOp: {
+		TokenType op = static_cast<ExecUnary &>(node).op;
+		if (op == TokenType::INCREMENT || op == TokenType::DECREMENT) {
+			return false;
 		}
+		break;
+	}
+	case ExecKind::Int:
+	case ExecKind::Float:
+	case ExecKind::Bool:
+	case ExecKind::String:
+	case ExecKind::Null:
+	case ExecKind::Variable:
+	case ExecKind::ArrayLiteral:
+	case ExecKind::ObjectLiteral:
+	case ExecKind::Ln:
+	case ExecKind::BinaryOp:
+	case ExecKind::Convert:
+	case ExecKind::ObjectAccess:
+	case ExecKind::ArrayAccess:
+	case ExecKind::Length:
+		break;
+	default:
+		return false;
+	}
+	size++;
+	bool pure = true;
+	forEachChild(node, [&](ExecNodePtr &child) {
+		pure = pure && pureExpression(*child, size);
+	});
+	return pure;
+}
 
-		arr.pop_back();
+// The returns of a body made of คืนค่า statements and ถ้า whose branches
+// are each one คืนค่า, up to a return that is always taken; nullptr for
+// any other body, or one of more than runOptions.inlineSize nodes.
+const InlineBody *inlineBodyOf(ExecFunction &f) {
+	auto cached = inlineBodies.find(&f);
+	if (cached != inlineBodies.end()) {
+		return cached->second.get();
+	}
+	auto body = make_unique<InlineBody>();
+	body->parameters = f.parameters;
+	size_t size = 0;
+	// stmt has to be a คืนค่า, taken when condition (if any) holds
+	auto add = [&](ExecNodePtr *condition, ExecNode &stmt) {
+		if (stmt.kind != ExecKind::Return) {
+			return false;
 		}
-		else if(holds_alternative<string>(arrayVal->data)){
-			auto &arr = get<string>(arrayVal->data);
-			if (arr.empty()) {
-				cerr << "ไม่สามารถ ดึงข้อมูลออก จาก ข้อความ ที่ว่าง "
-					 << " ได้ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
-			}
+		ExecNodePtr &value = static_cast<ExecReturn &>(stmt).value;
+		if (!value || !pureExpression(*value, size) ||
+			(condition && (!*condition || !pureExpression(**condition, size)))) {
+			return false;
+		}
+		body->returns.push_back({condition, &value});
+		return true;
+	};
+	auto branch = [&](ExecNodePtr *condition, vector<ExecNodePtr> &stmts) {
+		return stmts.size() == 1 && add(condition, *stmts[0]);
+	};
+	bool complete = false; // ends in a return that is always taken
+	for (auto &stmt : f.body) {
+		if (stmt->kind == ExecKind::Comment) {
+			continue;
+		} else if (stmt->kind == ExecKind::Return) {
+			complete = add(nullptr, *stmt);
+			break;
+		} else if (stmt->kind != ExecKind::If) {
+			break;
+		}
+		auto &n = static_cast<ExecIf &>(*stmt);
+		bool returns = branch(&n.then.condition, n.then.body);
+		for (auto &elif : n.elifs) {
+			returns = returns && branch(&elif.condition, elif.body);
+		}
+		if (!returns) {
+			break;
+		} else if (n.hasElse) {
+			complete = branch(nullptr, n.elseBody);
+			break;
+		}
+	}
+	if (!complete || size > runOptions.inlineSize || body->parameters.size() > 32) {
+		body.reset();
+	}
+	return (inlineBodies[&f] = std::move(body)).get();
+}
 
-			arr.pop_back();
+// What m.name means once module has been imported as m, for each name it
+// can only mean one function for; nothing for a module that imports, since
+// that drops what it exported before
+unordered_map<string, ExecFunction *> moduleExports(ExecProgram &module) {
+	unordered_map<string, int> declared;
+	bool imports = false;
+	forEachNode(module, [&](ExecNode &n) {
+		if (n.kind == ExecKind::FunctionDeclaration) {
+			declared[static_cast<ExecFunction &>(n).name]++;
+		} else if (n.kind == ExecKind::Import) {
+			imports = true;
+		}
+	});
+	unordered_map<string, ExecFunction *> exports;
+	if (imports) {
+		return exports;
+	}
+	for (auto &stmt : module.statements) {
+		if (stmt->kind != ExecKind::Export) {
+			continue;
+		}
+		for (auto &f : static_cast<ExecExport &>(*stmt).functions) {
+			if (declared[f->name] == 1) {
+				exports[f->name] = f.get();
 			}
-		else{
-			cerr << "ไม่สามารถลบสมาชิกนี้ได้ '"
-				 << " ได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ "
-				 << "ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-			exit(1);
 		}
-		return nullptr;
 	}
-	else if (stmt["type"] == "Insert") {
-		Value arrayVal = evalExpr(stmt["array"]);
-		Value indexVal = evalExpr(stmt["index"]);
-		Value valueToInsert = evalExpr(stmt["value"]);
+	return exports;
+}
 
-		if (!holds_alternative<int>(indexVal->data)) {
-			cerr << "ดัชนี ต้องเป็นจำนวนเต็ม "
-				 << "ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-			exit(1);
+// The entry program and the modules preloaded for it
+vector<ExecProgram *> wholeProgram(ExecProgram &entry) {
+	vector<ExecProgram *> programs{&entry};
+	for (auto &[path, module] : preloadedModules) {
+		if (module->kind == ExecKind::Program) {
+			programs.push_back(static_cast<ExecProgram *>(module.get()));
 		}
+	}
+	return programs;
+}
 
-		int index = get<int>(indexVal->data);
-
-		if(holds_alternative<ValueHolder::ArraY>(arrayVal->data)){
-			auto &array = get<ValueHolder::ArraY>(arrayVal->data);
-			if (index < 0 || index > static_cast<int>(array.size())) {
-				cerr << "ดัชนี อยู่นอกขอบเขตของ ชุดข้อมูล ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
+void inlineCalls(ExecProgram &entry) {
+	vector<ExecProgram *> programs = wholeProgram(entry);
+	// how many functions and imports in all of them have each name
+	unordered_map<string, int> declared, imported;
+	for (ExecProgram *program : programs) {
+		forEachNode(*program, [&](ExecNode &n) {
+			if (n.kind == ExecKind::FunctionDeclaration) {
+				declared[static_cast<ExecFunction &>(n).name]++;
+			} else if (n.kind == ExecKind::Import) {
+				imported[static_cast<ExecImport &>(n).name]++;
 			}
+		});
+	}
 
-			array.insert(array.begin() + index, valueToInsert);
-		}else if (holds_alternative<string>(arrayVal->data)) {
-			auto &array = get<string>(arrayVal->data);
-
-			if (index < 0 || index > static_cast<int>(array.size())) {
-				cerr << "ดัชนีอยู่นอกขอบเขตของข้อความ ที่บรรทัด "
-				     << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-				exit(1);
+	// what plain and namespaced calls mean by the current statement
+	unordered_map<string, ExecFunction *> functions;
+	unordered_map<string, unordered_map<string, ExecFunction *>> namespaces;
+	auto lookup = [](auto &table, const string &name) {
+		auto it = table.find(name);
+		return it == table.end() ? nullptr : &it->second;
+	};
+	for (auto &stmt : entry.statements) {
+		forEachNode(*stmt, [&](ExecNode &n) {
+			if (n.kind != ExecKind::FunctionCall) {
+				return;
+			}
+			auto &call = static_cast<ExecCall &>(n);
+			ExecFunction *const *callee = nullptr;
+			if (call.badName || call.badNamespace) {
+				return;
+			} else if (call.ns.empty()) {
+				callee = lookup(functions, call.name);
+			} else if (auto exports = lookup(namespaces, call.ns)) {
+				callee = lookup(*exports, call.name);
+			}
+			if (callee && (*callee)->parameters.size() == call.args.size()) {
+				call.inlined = inlineBodyOf(**callee);
+			}
+		});
+		if (stmt->kind == ExecKind::FunctionDeclaration) {
+			auto &f = static_cast<ExecFunction &>(*stmt);
+			if (declared[f.name] == 1) {
+				functions[f.name] = &f;
+			}
+		} else if (stmt->kind == ExecKind::Import) {
+			auto &import = static_cast<ExecImport &>(*stmt);
+			auto module = preloadedModules.find(modulePath(import).string());
+			if (imported[import.name] == 1 && module != preloadedModules.end() &&
+				module->second->kind == ExecKind::Program) {
+				namespaces[import.name] =
+					moduleExports(static_cast<ExecProgram &>(*module->second));
 			}
-
-			Value valueToInsert = evalExpr(stmt["value"]);
-
-			// ดึง string มา insert
-			const string &strToInsert = get<string>(valueToInsert->data);
-			array.insert(index, strToInsert);
-		}else{
-			cerr << "ไม่สามารถแทรกได้ เนื่องจากค่าไม่ใช่ชุดข้อมูล หรือ ข้อความ "
-				 << "ที่บรรทัด " << stmt["line"] << " คอลัมน์ " << stmt["column"] << "";
-			exit(1);
 		}
-
-
-		return nullptr;
 	}
+}
 
- else if (stmt["type"] == "Erase") {
-		Value arrayVal = evalExpr(stmt["array"]);
-		Value indexVal = evalExpr(stmt["index"]);
-		int index;
-
-		if (!holds_alternative<int>(indexVal->data)) {
-			if (holds_alternative<double>(indexVal->data)) {
-				double b = get<double>(indexVal->data);
-				if (b != static_cast<int>(b)) {
-					cerr << "ดัชนีที่ต้องการลบจาก ชุดข้อมูล ต้องเป็นจำนวนเต็ม"
-						 << "ที่บรรทัด: " << stmt["line"] << " คอลัมน์: " << stmt["column"]
-						 << "";
-					exit(1);
-				}
-				index = static_cast<int>(b);
-			} else {
-				cerr << "ดัชนีที่ต้องการลบจาก ชุดข้อมูล ต้องเป็นจำนวนเต็ม"
-					 << "ที่บรรทัด: " << stmt["line"] << " คอลัมน์: " << stmt["column"]
-					 << "";
-				exit(1);
-			}
-		} else {
-			index = get<int>(indexVal->data);
+// Type inference
+//
+// With --opt=1 and up, inferTypes works out, before the entry program runs,
+// which types each variable may ever hold and what each function may
+// return, over the entry program and every module it imports. Literals,
+// รับ and ++/-- give their own types, operators and เปลี่ยนชนิดข้อมูล follow
+// applyBinary's and convertValue's rules, and a parameter gets whatever its
+// calls pass; anything else (elements, fields) may be of any type. A for
+// loop counter stays an int only when an int start and stop and a step of 1
+// or -1 can not overflow it, which also needs nothing its body runs to
+// write it. The sets only grow, so repeating this until none changes covers
+// every value a run can produce. Then each +, -, *, /, %, comparison, = and
+// != whose operands are each proven an int or a double is evaluated by
+// evalProven on unboxed numbers without looking at a tag; a variable read
+// there still checks that it is bound. The parser records no parameter
+// types and always return type "none", so there is nothing declared to use.
+// --report-types prints how many operators this covered.
+using TypeSet = uint8_t;
+
+constexpr TypeSet typeBit(Value::Type t) {
+	return static_cast<TypeSet>(1u << static_cast<unsigned>(t));
+}
+constexpr TypeSet anyType = 0xFF;
+constexpr TypeSet intType = typeBit(Value::Type::Int);
+constexpr TypeSet doubleType = typeBit(Value::Type::Double);
+
+// What applyBinary gives for op on these types; None where it fails or
+// gives something this does not track
+Value::Type binaryResultType(TokenType op, Value::Type l, Value::Type r) {
+	using T = Value::Type;
+	bool ints = l == T::Int && r == T::Int;
+	bool numbers = (l == T::Int || l == T::Double) && (r == T::Int || r == T::Double);
+	bool bits = (l == T::Int || l == T::Bool) && (r == T::Int || r == T::Bool);
+	switch (op) {
+	case TokenType::ADDITION:
+		if (!numbers) {
+			return l == r && (l == T::String || l == T::Array || l == T::Object) ? l : T::None;
 		}
+		[[fallthrough]];
+	case TokenType::SUBTRACTION:
+	case TokenType::MULTIPLICATION:
+	case TokenType::MODULAS:
+		return ints ? T::Int : numbers ? T::Double : T::None;
+	case TokenType::DIVISION:
+	case TokenType::FLOORDIVISION:
+	case TokenType::EXPONENTIATION:
+	case TokenType::ROOT:
+		return numbers ? T::Double : T::None;
+	case TokenType::SHIFT_LEFT:
+	case TokenType::SHIFT_RIGHT:
+		return ints ? T::Int : T::None;
+	case TokenType::GREATER:
+	case TokenType::LESSER:
+	case TokenType::GREATEROREQUAL:
+	case TokenType::LESSEROREQUAL:
+		return numbers ? T::Bool : T::None;
+	case TokenType::EQUALTO:
+	case TokenType::NOTEQUAL:
+		return T::Bool;
+	case TokenType::BITWISE_AND:
+	case TokenType::XOR:
+	case TokenType::BITWISE_OR:
+		return bits ? T::Int : T::None;
+	case TokenType::AND:
+	case TokenType::OR:
+		return bits ? T::Bool : T::None;
+	default:
+		return T::None;
+	}
+}
 
+// The value of node, which inferTypes proved to be a T (int or double)
+template <class T> T evalUnboxed(const ExecNode *node);
 
-		if(holds_alternative<ValueHolder::ArraY>(arrayVal->data)){
-
-			auto &arr = get<ValueHolder::ArraY>(arrayVal->data);
+double unboxedNumber(const ExecNode *node, Value::Type type) {
+	if (type == Value::Type::Int) {
+		return evalUnboxed<int>(node);
+	}
+	return evalUnboxed<double>(node);
+}
 
-			if (index < 0 || index >= static_cast<int>(arr.size())) {
-				cerr << "ไม่สามารถลบ ดัชนี ที่อยู่นอกขอบเขต ชุดข้อมูล ได้ "
-					 << "ดัชนี: " << index << ", ขนาด ชุดข้อมูล: " << arr.size()
-					 << " ที่บรรทัด: " << stmt["line"] << " คอลัมน์: " << stmt["column"]
-					 << "";
-				exit(1);
+template <class T> T evalUnboxed(const ExecNode *node) {
+	switch (node->kind) {
+	case ExecKind::Int:
+		return static_cast<const ExecInt *>(node)->value;
+	case ExecKind::Float:
+		return static_cast<const ExecFloat *>(node)->value;
+	case ExecKind::Variable:
+		return lookvar(static_cast<const ExecVariable *>(node)->slot, node->line,
+					   node->column)->value.template known<T>();
+	case ExecKind::BinaryOp: {
+		const auto &n = static_cast<const ExecBinary &>(*node);
+		if (n.proven == Value::Type::Int) {
+			int a = evalUnboxed<int>(n.left.get());
+			int b = evalUnboxed<int>(n.right.get());
+			switch (n.op) {
+			case TokenType::ADDITION:
+				return a + b;
+			case TokenType::SUBTRACTION:
+				return a - b;
+			case TokenType::MULTIPLICATION:
+				return a * b;
+			default: // 0 fails the way it does in applyBinary
+				return a % b;
 			}
-
-			arr.erase(arr.begin() + index);
-		}else if(holds_alternative<string>(arrayVal->data)){
-			auto &arr = get<string>(arrayVal->data);
-
-			if (index < 0 || index >= static_cast<int>(arr.size())) {
-				cerr << "ไม่สามารถลบ ดัชนี ที่อยู่นอกขอบเขต ชุดข้อมูล ได้ "
-					 << "ดัชนี: " << index << ", ขนาด ชุดข้อมูล: " << arr.size()
-					 << " ที่บรรทัด: " << stmt["line"] << " คอลัมน์: " << stmt["column"]
-					 << "";
-				exit(1);
+		} else if (n.proven == Value::Type::Double) {
+			double a = unboxedNumber(n.left.get(), n.provenLeft);
+			double b = unboxedNumber(n.right.get(), n.provenRight);
+			switch (n.op) {
+			case TokenType::ADDITION:
+				return a + b;
+			case TokenType::SUBTRACTION:
+				return a - b;
+			case TokenType::MULTIPLICATION:
+				return a * b;
+			case TokenType::DIVISION:
+				return a / b;
+			default:
+				return fmod(a, b);
 			}
-
-			arr.erase(index,1);
-		}else{
-			cerr << "ไม่สามารถลบสมาชิกได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ"
-				 << " ที่บรรทัด: " << stmt["line"] << " คอลัมน์: " << stmt["column"]
-				 << "";
-			exit(1);
 		}
-
-		return nullptr;
+		break;
+	}
+	default:
+		break;
+	}
+	return evalExpr(node).template known<T>();
+}
+
+template <class T> bool compareUnboxed(TokenType op, T a, T b) {
+	switch (op) {
+	case TokenType::GREATER:
+		return a > b;
+	case TokenType::LESSER:
+		return a < b;
+	case TokenType::GREATEROREQUAL:
+		return a >= b;
+	case TokenType::LESSEROREQUAL:
+		return a <= b;
+	case TokenType::EQUALTO:
+		return a == b;
+	default:
+		return a != b;
+	}
+}
+
+Value evalProven(const ExecBinary &site) {
+	using T = Value::Type;
+	if (site.proven != T::Bool) {
+		if (site.proven == T::Int) {
+			return Value(evalUnboxed<int>(&site));
+		}
+		return Value(evalUnboxed<double>(&site));
+	} else if (site.provenLeft == T::Int && site.provenRight == T::Int) {
+		int a = evalUnboxed<int>(site.left.get());
+		int b = evalUnboxed<int>(site.right.get());
+		return Value(compareUnboxed(site.op, a, b));
+	}
+	double a = unboxedNumber(site.left.get(), site.provenLeft);
+	double b = unboxedNumber(site.right.get(), site.provenRight);
+	return Value(compareUnboxed(site.op, a, b));
+}
+
+// What calling a function of each name may do, over every function of that
+// name in the entry program and its modules: the slots it may write, with
+// -1 when it may import, the names of the functions it may end up
+// calling, and whether it may add or remove elements or fields anywhere.
+struct CallEffects {
+	unordered_set<int> writes;
+	unordered_set<string> calls;
+	bool resizes = false;
+};
+unordered_map<string, CallEffects> callEffects;
+
+// The slots n writes the value of; a call writes its callee's parameters
+// and whatever its body writes, and an import may write any (-1), since the
+// module's code shares the slots
+template <class F> void slotsWritten(ExecNode &n, F &&f) {
+	switch (n.kind) {
+	case ExecKind::Assignment: {
+		const ExecNode *target = static_cast<ExecAssignment &>(n).target.get();
+		if (target->kind == ExecKind::Variable) {
+			f(static_cast<const ExecVariable *>(target)->slot);
+		}
+		break;
+	}
+	case ExecKind::Input:
+		f(static_cast<ExecInput &>(n).slot);
+		break;
+	case ExecKind::ForLoop:
+		f(static_cast<ExecFor &>(n).variable);
+		break;
+	case ExecKind::UnaryOp: {
+		auto &u = static_cast<ExecUnary &>(n);
+		if ((u.op == TokenType::INCREMENT || u.op == TokenType::DECREMENT) &&
+			u.operand->kind == ExecKind::Variable) {
+			f(static_cast<ExecVariable &>(*u.operand).slot);
+		}
+		break;
+	}
+	case ExecKind::Import:
+		f(-1);
+		break;
+	case ExecKind::FunctionCall: {
+		auto it = callEffects.find(static_cast<ExecCall &>(n).name);
+		if (it != callEffects.end()) {
+			for (int slot : it->second.writes) {
+				f(slot);
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// Whether n itself may change how many elements or fields something has:
+// เพิ่ม, ดึงออก, แทรก and ลบ, setting a field, which may add it, and an
+// import
+bool resizes(ExecNode &n) {
+	switch (n.kind) {
+	case ExecKind::Push:
+	case ExecKind::Pop:
+	case ExecKind::Insert:
+	case ExecKind::Erase:
+	case ExecKind::Import:
+		return true;
+	case ExecKind::Assignment:
+		return static_cast<ExecAssignment &>(n).target->kind == ExecKind::ObjectAccess;
+	case ExecKind::UnaryOp: {
+		auto &u = static_cast<ExecUnary &>(n);
+		return (u.op == TokenType::INCREMENT || u.op == TokenType::DECREMENT) &&
+			   u.operand->kind == ExecKind::ObjectAccess;
+	}
+	default:
+		return false;
+	}
+}
+
+void findCallEffects(const vector<ExecProgram *> &programs) {
+	callEffects.clear();
+	unordered_map<string, vector<ExecFunction *>> functions;
+	for (ExecProgram *program : programs) {
+		forEachNode(*program, [&](ExecNode &n) {
+			if (n.kind == ExecKind::FunctionDeclaration) {
+				auto &f = static_cast<ExecFunction &>(n);
+				functions[f.name].push_back(&f);
+				callEffects[f.name].writes.insert(f.parameters.begin(), f.parameters.end());
+			}
+		});
+	}
+	bool changed;
+	do {
+		changed = false;
+		for (auto &[name, fs] : functions) {
+			CallEffects &effects = callEffects[name];
+			auto add = [&](auto &set, auto item) {
+				changed = set.insert(item).second || changed;
+			};
+			for (ExecFunction *f : fs) {
+				for (auto &stmt : f->body) {
+					forEachNode(*stmt, [&](ExecNode &n) {
+						slotsWritten(n, [&](int slot) { add(effects.writes, slot); });
+						if (resizes(n)) {
+							effects.resizes = true;
+						}
+						if (n.kind != ExecKind::FunctionCall) {
+							return;
+						}
+						const string &callee = static_cast<ExecCall &>(n).name;
+						add(effects.calls, callee);
+						auto it = callEffects.find(callee);
+						if (it != callEffects.end() && &it->second != &effects) {
+							for (const string &c : it->second.calls) {
+								add(effects.calls, c);
+							}
+						}
+					});
+				}
+			}
+		}
+	} while (changed);
+	for (auto &[name, effects] : callEffects) {
+		for (const string &callee : effects.calls) {
+			auto it = callEffects.find(callee);
+			effects.resizes = effects.resizes || it == callEffects.end() || it->second.resizes;
+		}
+	}
+}
+
+struct TypeInference {
+	vector<ExecProgram *> programs;
+	vector<TypeSet> slots = vector<TypeSet>(variableNames.size());
+	// by function name, over every function of that name
+	unordered_map<string, vector<ExecFunction *>> functions;
+	unordered_map<string, TypeSet> returns;
+	unordered_map<const ExecFor *, bool> counterWritten;
+	bool changed = false;
+
+	void join(TypeSet &into, TypeSet types) {
+		if ((into | types) != into) {
+			into |= types;
+			changed = true;
+		}
+	}
+
+	TypeSet typeOf(const ExecNode *node) {
+		using T = Value::Type;
+		switch (node->kind) {
+		case ExecKind::Int:
+			return intType;
+		case ExecKind::Float:
+			return doubleType;
+		case ExecKind::Bool:
+			return typeBit(T::Bool);
+		case ExecKind::String:
+			return typeBit(T::String);
+		case ExecKind::Null:
+			return typeBit(T::Null);
+		case ExecKind::ArrayLiteral:
+			return typeBit(T::Array);
+		case ExecKind::ObjectLiteral:
+			return typeBit(T::Object);
+		case ExecKind::Variable:
+			return slots[static_cast<const ExecVariable *>(node)->slot];
+		case ExecKind::Ln:
+			return doubleType;
+		case ExecKind::Length:
+			return intType;
+		case ExecKind::UnaryOp: {
+			const auto &n = static_cast<const ExecUnary &>(*node);
+			TypeSet operand = typeOf(n.operand.get());
+			if (!n.knownOp || !operand) {
+				return operand ? anyType : 0;
+			}
+			switch (n.op) {
+			case TokenType::NOT:
+				return typeBit(T::Bool);
+			case TokenType::SUBTRACTION:
+				return operand & ~(intType | doubleType) ? anyType : operand;
+			default: // ~, ++ and --
+				return intType;
+			}
+		}
+		case ExecKind::BinaryOp: {
+			const auto &n = static_cast<const ExecBinary &>(*node);
+			TypeSet left = typeOf(n.left.get());
+			TypeSet right = typeOf(n.right.get());
+			TypeSet result = 0;
+			for (unsigned l = 0; l < 8; l++) {
+				for (unsigned r = 0; r < 8; r++) {
+					if ((left & (1u << l)) && (right & (1u << r))) {
+						T type = binaryResultType(n.op, T(l), T(r));
+						result |= type == T::None || !n.knownOp ? anyType : typeBit(type);
+					}
+				}
+			}
+			return result;
+		}
+		case ExecKind::Convert: {
+			const auto &n = static_cast<const ExecConvert &>(*node);
+			if (!typeOf(n.expression.get())) {
+				return 0;
+			}
+			const string &target = n.target;
+			return target == "INTEGER" ? intType
+				 : target == "FLOAT"   ? doubleType
+				 : target == "STRING"  ? typeBit(T::String)
+				 : target == "BOOLEAN" ? typeBit(T::Bool)
+									   : anyType;
+		}
+		case ExecKind::FunctionCall: {
+			auto it = returns.find(static_cast<const ExecCall *>(node)->name);
+			return it == returns.end() ? anyType : it->second;
+		}
+		default:
+			return anyType;
+		}
+	}
+
+	void findFunctions() {
+		for (ExecProgram *program : programs) {
+			forEachNode(*program, [&](ExecNode &n) {
+				if (n.kind == ExecKind::FunctionDeclaration) {
+					auto &f = static_cast<ExecFunction &>(n);
+					functions[f.name].push_back(&f);
+					returns[f.name];
+				}
+			});
+		}
+	}
+
+	// What the counter of loop may hold
+	TypeSet counterTypes(const ExecFor &loop) {
+		TypeSet init = typeOf(loop.init.get());
+		TypeSet stop = typeOf(loop.stop.get());
+		if (!init || !stop) {
+			return 0;
+		}
+		auto written = counterWritten.find(&loop);
+		if (written == counterWritten.end()) {
+			bool any = false;
+			for (auto &stmt : loop.body) {
+				forEachNode(*stmt, [&](ExecNode &n) {
+					slotsWritten(n, [&](int slot) {
+						any = any || slot == loop.variable || slot < 0;
+					});
+				});
+			}
+			written = counterWritten.emplace(&loop, any).first;
+		}
+		const ExecNode *step = loop.step.get();
+		if (init == intType && stop == intType && !written->second &&
+			step->kind == ExecKind::Int &&
+			(static_cast<const ExecInt *>(step)->value == 1 ||
+			 static_cast<const ExecInt *>(step)->value == -1)) {
+			return intType;
+		}
+		return init | intType | doubleType;
+	}
+
+	void visit(ExecNode &n) {
+		switch (n.kind) {
+		case ExecKind::Assignment: {
+			auto &a = static_cast<ExecAssignment &>(n);
+			if (a.target->kind == ExecKind::Variable) {
+				join(slots[static_cast<ExecVariable &>(*a.target).slot], typeOf(a.value.get()));
+			}
+			break;
+		}
+		case ExecKind::Input:
+			join(slots[static_cast<ExecInput &>(n).slot], typeBit(Value::Type::String));
+			break;
+		case ExecKind::ForLoop: {
+			auto &loop = static_cast<ExecFor &>(n);
+			join(slots[loop.variable], counterTypes(loop));
+			break;
+		}
+		case ExecKind::UnaryOp: {
+			auto &u = static_cast<ExecUnary &>(n);
+			if ((u.op == TokenType::INCREMENT || u.op == TokenType::DECREMENT) &&
+				u.operand->kind == ExecKind::Variable) {
+				join(slots[static_cast<ExecVariable &>(*u.operand).slot], intType);
+			}
+			break;
+		}
+		case ExecKind::FunctionCall: {
+			auto &call = static_cast<ExecCall &>(n);
+			auto it = functions.find(call.name);
+			if (it == functions.end()) {
+				break;
+			}
+			for (ExecFunction *f : it->second) {
+				size_t argc = min(f->parameters.size(), call.args.size());
+				for (size_t i = 0; i < argc; i++) {
+					join(slots[f->parameters[i]], typeOf(call.args[i].get()));
+				}
+			}
+			break;
+		}
+		case ExecKind::FunctionDeclaration: {
+			auto &f = static_cast<ExecFunction &>(n);
+			TypeSet &type = returns[f.name];
+			// a body that can end without คืนค่า gives no value
+			if (f.body.empty() || f.body.back()->kind != ExecKind::Return) {
+				join(type, anyType);
+			}
+			for (auto &stmt : f.body) {
+				returnTypes(*stmt, type);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	void returnTypes(ExecNode &n, TypeSet &type) {
+		if (n.kind == ExecKind::Return) {
+			auto &r = static_cast<ExecReturn &>(n);
+			join(type, r.value ? typeOf(r.value.get()) : anyType);
+		}
+		forEachChild(n, [&](ExecNodePtr &child) { returnTypes(*child, type); });
+	}
+
+	// Marks the operators evalProven can take, counting them and all
+	void specialize(size_t &sites, size_t &total) {
+		using T = Value::Type;
+		for (ExecProgram *program : programs) {
+			forEachNode(*program, [&](ExecNode &node) {
+				if (node.kind != ExecKind::BinaryOp) {
+					return;
+				}
+				total++;
+				auto &n = static_cast<ExecBinary &>(node);
+				auto number = [](TypeSet t) {
+					return t == intType ? T::Int : t == doubleType ? T::Double : T::None;
+				};
+				T left = number(typeOf(n.left.get()));
+				T right = number(typeOf(n.right.get()));
+				if (!n.knownOp || left == T::None || right == T::None) {
+					return;
+				}
+				switch (n.op) {
+				case TokenType::EQUALTO:
+				case TokenType::NOTEQUAL:
+					if (left != right) {
+						return;
+					}
+					[[fallthrough]];
+				case TokenType::ADDITION:
+				case TokenType::SUBTRACTION:
+				case TokenType::MULTIPLICATION:
+				case TokenType::DIVISION:
+				case TokenType::MODULAS:
+				case TokenType::GREATER:
+				case TokenType::LESSER:
+				case TokenType::GREATEROREQUAL:
+				case TokenType::LESSEROREQUAL:
+					break;
+				default:
+					return;
+				}
+				n.provenLeft = left;
+				n.provenRight = right;
+				n.proven = binaryResultType(n.op, left, right);
+				// what the JIT compiles from, as observe would have seen it
+				n.seenLeft = left;
+				n.seenRight = right;
+				sites++;
+			});
+		}
+	}
+};
+
+// kept for optimizeIr, which asks it what nodes may hold
+unique_ptr<TypeInference> inferredTypes;
+
+void inferTypes(ExecProgram &entry) {
+	inferredTypes = make_unique<TypeInference>();
+	TypeInference &types = *inferredTypes;
+	types.programs = wholeProgram(entry);
+	findCallEffects(types.programs);
+	types.findFunctions();
+	do {
+		types.changed = false;
+		for (ExecProgram *program : types.programs) {
+			forEachNode(*program, [&](ExecNode &n) { types.visit(n); });
+		}
+	} while (types.changed);
+	size_t sites = 0, total = 0;
+	types.specialize(sites, total);
+	if (runOptions.reportTypes) {
+		cerr << "Specialized " << sites << " of " << total << " operators\n";
+	}
+}
+
+// Optimizing IR
+//
+// With --opt=1 and up, optimizeIr translates every program and function
+// body into SSA form before it runs: basic blocks split where ถ้า, loops,
+// ออก/ถัดไป and คืนค่า branch, and an instruction for each node that gets
+// evaluated. A variable has versions instead of a value: an assignment
+// makes a new one, a join of paths a phi, and a call, an import or the end
+// of a scope one that may hold anything. Elements and fields all go in one
+// more variable, memory, which element assignments, array methods and calls
+// give new versions, and how many there are in another, lengths, which only
+// เพิ่ม, ดึงออก, แทรก, ลบ, setting a field and calls that may do those
+// change. .ขนาด() reads lengths alone, so a loop that only assigns
+// elements still has its length computed once. Five passes run over that:
+//
+// - copy propagation lets a read of a variable stand for the value last
+//   assigned to it, and reads a constant one as that constant;
+// - loop-invariant code motion moves an operator whose operands and memory
+//   stay the same all through a loop out of it, to be evaluated once each
+//   time the loop starts. One that could stop the program only moves when
+//   the loop is certain to evaluate it first;
+// - common subexpression elimination lets an operator reuse the value of an
+//   equal one earlier in its block;
+// - dead store elimination drops an assignment that another to the same
+//   variable overwrites in the same block before anything reads it;
+// - bounds check elimination marks arr[i] in a สำหรับ counting i up to
+//   arr.ขนาด() as in bounds, when the loop cannot change arr, i or any
+//   array's length.
+//
+// Only operators whose value is a number or a bool, and element and field
+// reads, which share what they read anyway, are reused; a string or array
+// an operator builds may be changed in place later. A loop with a call in
+// it that may come back to the same body keeps everything, since the temps
+// are not per call, and a call or an import empties what a block can
+// reuse. lowerIr then writes the results back into the lowered tree that
+// every engine runs, as ExecTemps, loops' hoisted lists and in-bounds
+// flags on ExecArrayAccess, so the tree walker, the VM, OSR and the JIT
+// all run the optimized code. --dump-ir
+// prints each body before and after every pass.
+
+enum class IrOp : uint8_t {
+	Const, Load, Expr, Call, Effect,	 // values, one for each node evaluated
+	Entry, Phi, Store, Clobber, Unscope, // versions of a variable
+	Jump, Branch, Yield, Return, Exit	 // what ends a block
+};
+
+struct IrBlock;
+struct IrLoop;
+
+struct IrInstr {
+	IrOp op;
+	int id = 0;
+	int slot = -1; // what a version or a Load is of: a variable, or memory
+	vector<IrInstr *> args;
+	ExecNodePtr *site = nullptr; // the node this evaluates, for lowerIr
+	IrInstr *parent = nullptr;	 // the value whose node holds site
+	IrBlock *block = nullptr;
+	string label; // what a Const, Expr, Call or Effect is, for --dump-ir
+	bool reusable = false; // an Expr whose value can be shared
+	bool canFail = true;   // an Expr that may stop the program
+	bool isConst = false;  // a Store of ค่าคงที่
+	// a version this one turned out to be (a trivial phi, or the end of a
+	// scope for a variable bound before it), and whether the variable is
+	// bound for certain where this version is reached
+	IrInstr *replacedBy = nullptr;
+	bool bound = false;
+	// what the passes found
+	IrInstr *same = nullptr;	// a value this one equals
+	bool constant = false;		// a Load that reads a literal
+	IrLoop *hoistedTo = nullptr; // evaluated before this loop instead
+	bool dead = false;			// a Store nothing reads
+	bool inBounds = false;		// an index, or a set index, that needs no checks
+};
+
+struct IrBlock {
+	int id = 0;
+	vector<IrBlock *> preds;
+	vector<IrBlock *> succs;
+	vector<unique_ptr<IrInstr>> phis; // and entries
+	vector<unique_ptr<IrInstr>> instrs;
+	unordered_map<int, IrInstr *> defs; // each variable's latest version here
+	vector<IrInstr *> incomplete;		// phis waiting for all the preds
+	bool sealed = false;
+	bool header = false; // a loop's back edges come here
+	IrLoop *loop = nullptr; // the innermost loop running this block
+};
+
+struct IrLoop {
+	vector<ExecNodePtr> *hoisted = nullptr;
+	IrLoop *parent = nullptr;
+	IrBlock *header = nullptr;
+	// the block that runs first whenever the loop starts: the condition of
+	// a ขณะ, the body of a ทำ; none for a for loop, which tests first
+	IrBlock *first = nullptr;
+	// a for loop's counter, as the header sees it, and what it counts with
+	IrInstr *counter = nullptr;
+	IrInstr *init = nullptr;
+	IrInstr *stop = nullptr;
+	IrInstr *step = nullptr;
+};
+
+struct IrBody {
+	string name;
+	const ExecFunction *function = nullptr;
+	vector<unique_ptr<IrBlock>> blocks;
+	vector<unique_ptr<IrLoop>> loops;
+	int values = 0;
+};
+
+// the memory variable's slot, one past the real ones, and then that of
+// lengths, which only adding or removing elements or fields changes
+int memorySlot() { return static_cast<int>(variableNames.size()); }
+int lengthsSlot() { return memorySlot() + 1; }
+
+// slots a ค่าคงที่ assigns anywhere; assigning those again can fail
+vector<bool> assignedConst;
+
+IrInstr *resolveVersion(IrInstr *v) {
+	while (v->replacedBy) {
+		v = v->replacedBy;
+	}
+	return v;
+}
+
+IrInstr *resolveValue(IrInstr *v) {
+	while (v->same) {
+		v = v->same;
+	}
+	return v;
+}
+
+bool inLoop(const IrBlock *b, const IrLoop *loop) {
+	for (const IrLoop *l = b->loop; l; l = l->parent) {
+		if (l == loop) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool mayFail(const IrInstr *v) {
+	switch (v->op) {
+	case IrOp::Const:
+		return false;
+	case IrOp::Load:
+		return !v->constant && !resolveVersion(v->args[0])->bound;
+	case IrOp::Expr:
+		return v->canFail;
+	default:
+		return true;
+	}
+}
+
+struct IrBuilder {
+	explicit IrBuilder(IrBody &body) :
+		body(body) {}
+
+	IrBody &body;
+	IrBlock *current = nullptr;
+	IrLoop *loop = nullptr;
+	unordered_set<int> parameters;
+	vector<int> used; // the slots the body names
+	// each open scope: the block it was entered from and the slots it binds
+	struct Scope {
+		IrBlock *outside;
+		vector<int> slots;
+	};
+	vector<Scope> scopes;
+	// where ถัดไป and ออก go, and how many scopes were open around the loop
+	struct Targets {
+		IrBlock *next;
+		IrBlock *broke;
+		size_t scopes;
+	};
+	vector<Targets> targets;
+	IrBlock *yieldTo = nullptr; // where a call's value leaves the ถ้า it is in
+
+	IrBlock *newBlock() {
+		body.blocks.push_back(make_unique<IrBlock>());
+		IrBlock *b = body.blocks.back().get();
+		b->id = static_cast<int>(body.blocks.size()) - 1;
+		b->loop = loop;
+		return b;
+	}
+
+	// a block nothing reaches, other than the body's first, has no preds
+	// and adds no edges
+	static bool live(const IrBlock *b) { return b->id == 0 || !b->preds.empty(); }
+
+	IrBlock *here() {
+		if (!current) {
+			current = newBlock();
+			current->sealed = true;
+		}
+		return current;
+	}
+
+	IrInstr *make(vector<unique_ptr<IrInstr>> &list, IrBlock *b, IrOp op,
+				  vector<IrInstr *> args) {
+		list.push_back(make_unique<IrInstr>());
+		IrInstr *v = list.back().get();
+		v->op = op;
+		v->id = body.values++;
+		v->args = std::move(args);
+		v->block = b;
+		return v;
+	}
+
+	IrInstr *add(IrOp op, vector<IrInstr *> args, ExecNodePtr *site = nullptr,
+				 string label = "") {
+		IrBlock *b = here();
+		IrInstr *v = make(b->instrs, b, op, std::move(args));
+		v->site = site;
+		v->label = std::move(label);
+		return v;
+	}
+
+	void end(IrOp op, vector<IrInstr *> args, vector<IrBlock *> to) {
+		if (!current) {
+			return;
+		}
+		add(op, std::move(args));
+		if (live(current)) {
+			for (IrBlock *b : to) {
+				current->succs.push_back(b);
+				b->preds.push_back(current);
+			}
+		}
+		current = nullptr;
+	}
+
+	void jump(IrBlock *to) { end(IrOp::Jump, {}, {to}); }
+
+	// Versions, after Braun et al., "Simple and Efficient Construction of
+	// Static Single Assignment Form"
+
+	IrInstr *newPhi(IrBlock *b, int slot) {
+		IrInstr *phi = make(b->phis, b, IrOp::Phi, {});
+		phi->slot = slot;
+		return phi;
+	}
+
+	void addPhiOperands(IrInstr *phi) {
+		for (IrBlock *pred : phi->block->preds) {
+			phi->args.push_back(read(phi->slot, pred));
+		}
+	}
+
+	IrInstr *read(int slot, IrBlock *b) {
+		auto it = b->defs.find(slot);
+		if (it != b->defs.end()) {
+			return it->second;
+		}
+		IrInstr *v;
+		if (!b->sealed) {
+			v = newPhi(b, slot);
+			b->incomplete.push_back(v);
+		} else if (b->preds.empty()) {
+			// what the body starts with, or anything in a block nothing reaches
+			v = make(b->phis, b, IrOp::Entry, {});
+			v->slot = slot;
+			v->bound = b->id == 0 && (slot >= memorySlot() || parameters.count(slot));
+		} else if (b->preds.size() == 1 && !b->header) {
+			v = read(slot, b->preds[0]);
+		} else {
+			v = newPhi(b, slot);
+			b->defs[slot] = v;
+			addPhiOperands(v);
+		}
+		b->defs[slot] = v;
+		return v;
+	}
+
+	void seal(IrBlock *b) {
+		b->sealed = true;
+		for (IrInstr *phi : b->incomplete) {
+			addPhiOperands(phi);
+		}
+		b->incomplete.clear();
+	}
+
+	IrInstr *version(int slot) { return read(slot, here()); }
+
+	void define(int slot, IrInstr *v) {
+		v->slot = slot;
+		here()->defs[slot] = v;
+	}
+
+	void clobber(int slot) { define(slot, add(IrOp::Clobber, {version(slot)})); }
+
+	// what a call to name (or an import, with no name) may change
+	void clobberCalled(const string *name) {
+		const CallEffects *effects = nullptr;
+		if (name) {
+			auto it = callEffects.find(*name);
+			effects = it == callEffects.end() ? nullptr : &it->second;
+		}
+		bool all = !effects || effects->writes.count(-1);
+		for (int slot : used) {
+			if (all || effects->writes.count(slot)) {
+				clobber(slot);
+			}
+		}
+		clobber(memorySlot());
+		if (!effects || effects->resizes) {
+			clobber(lengthsSlot());
+		}
+	}
+
+	void store(int slot, IrInstr *value, ExecNodePtr *site, bool isConst) {
+		IrInstr *s = add(IrOp::Store, {value}, site);
+		s->isConst = isConst;
+		define(slot, s);
+		if (!scopes.empty()) {
+			vector<int> &bound = scopes.back().slots;
+			if (find(bound.begin(), bound.end(), slot) == bound.end()) {
+				bound.push_back(slot);
+			}
+		}
+	}
+
+	void unscope(const Scope &scope) {
+		for (int slot : scope.slots) {
+			IrInstr *before = read(slot, scope.outside);
+			define(slot, add(IrOp::Unscope, {before, version(slot)}));
+		}
+	}
+
+	void openScope() {
+		IrBlock *outside = here();
+		IrBlock *inside = newBlock();
+		jump(inside);
+		seal(inside);
+		current = inside;
+		scopes.push_back({outside, {}});
+	}
+
+	void closeScope() {
+		Scope scope = std::move(scopes.back());
+		scopes.pop_back();
+		if (!current) {
+			return;
+		}
+		unscope(scope);
+		IrBlock *after = newBlock();
+		jump(after);
+		seal(after);
+		current = after;
+	}
+
+	// ออก and ถัดไป close the scopes opened inside the loop body first
+	void leave(IrBlock *to) {
+		if (!current) {
+			return;
+		}
+		for (size_t i = scopes.size(); i-- > targets.back().scopes;) {
+			unscope(scopes[i]);
+		}
+		jump(to);
+	}
+
+	IrInstr *value(ExecNodePtr &node) {
+		ExecNode &n = *node;
+		vector<IrInstr *> args;
+		auto child = [&](ExecNodePtr &c) { args.push_back(value(c)); };
+		// an operator over the children in args, reading memory when it
+		// looks inside a string, array or object
+		auto expr = [&](string label, bool readsMemory, bool reusable) {
+			size_t children = args.size();
+			if (!readsMemory) {
+				for (IrInstr *a : args) {
+					readsMemory = readsMemory || mayHoldHeap(*a->site);
+				}
+			}
+			if (readsMemory) {
+				args.push_back(version(memorySlot()));
+			}
+			IrInstr *v = add(IrOp::Expr, args, &node, std::move(label));
+			for (size_t i = 0; i < children; i++) {
+				args[i]->parent = v;
+			}
+			v->reusable = reusable;
+			return v;
+		};
+		auto effect = [&](string label) {
+			IrInstr *v = add(IrOp::Effect, args, &node, std::move(label));
+			for (IrInstr *a : args) {
+				if (a->op < IrOp::Entry) {
+					a->parent = v;
+				}
+			}
+			return v;
+		};
+		bool scalar = !mayHoldHeap(node);
+		switch (n.kind) {
+		case ExecKind::Int:
+		case ExecKind::Float:
+		case ExecKind::Bool:
+		case ExecKind::String:
+		case ExecKind::Null: {
+			Value literal = literalValue(&n);
+			string label = literal ? valueToString(literal) : "ว่าง";
+			for (size_t at = 0; (at = label.find('\n', at)) != string::npos;) {
+				label.replace(at, 1, "\\n");
+			}
+			return add(IrOp::Const, {}, &node, label);
+		}
+		case ExecKind::Variable: {
+			int slot = static_cast<ExecVariable &>(n).slot;
+			IrInstr *load = add(IrOp::Load, {version(slot)}, &node);
+			load->slot = slot;
+			return load;
+		}
+		case ExecKind::ArrayLiteral:
+			for (auto &e : static_cast<ExecArrayLiteral &>(n).elements) {
+				child(e);
+			}
+			return expr("array", false, false);
+		case ExecKind::ObjectLiteral:
+			for (auto &[key, val] : static_cast<ExecObjectLiteral &>(n).properties) {
+				child(key);
+				child(val);
+			}
+			return expr("object", false, false);
+		case ExecKind::UnaryOp: {
+			auto &u = static_cast<ExecUnary &>(n);
+			string op = tokenTypeName(u.op);
+			if (u.knownOp && (u.op == TokenType::INCREMENT || u.op == TokenType::DECREMENT)) {
+				ExecNode &target = *u.operand;
+				if (target.kind == ExecKind::Variable) {
+					int slot = static_cast<ExecVariable &>(target).slot;
+					args.push_back(version(slot));
+					IrInstr *v = effect(op + " " + variableNames[slot]);
+					clobber(slot);
+					return v;
+				} else if (target.kind == ExecKind::ObjectAccess) {
+					auto &access = static_cast<ExecObjectAccess &>(target);
+					child(access.object);
+					if (!access.dotKey) {
+						child(access.key);
+					}
+				} else if (target.kind == ExecKind::ArrayAccess) {
+					auto &access = static_cast<ExecArrayAccess &>(target);
+					child(access.array);
+					child(access.index);
+				} else {
+					child(u.operand);
+					return effect(op);
+				}
+				args.push_back(version(memorySlot()));
+				IrInstr *v = effect(op);
+				clobber(memorySlot());
+				if (resizes(n)) {
+					clobber(lengthsSlot());
+				}
+				return v;
+			}
+			child(u.operand);
+			if (!u.knownOp) {
+				return effect("unknown");
+			}
+			return expr(op, false, scalar);
+		}
+		case ExecKind::Ln:
+			child(static_cast<ExecLn &>(n).value);
+			return expr("ln", false, true);
+		case ExecKind::BinaryOp: {
+			auto &b = static_cast<ExecBinary &>(n);
+			child(b.left);
+			child(b.right);
+			if (!b.knownOp) {
+				return effect("unknown");
+			}
+			IrInstr *v = expr(tokenTypeName(b.op), false, scalar);
+			v->canFail = b.proven == Value::Type::None ||
+						 (b.op == TokenType::MODULAS && b.proven == Value::Type::Int);
+			return v;
+		}
+		case ExecKind::Convert: {
+			auto &c = static_cast<ExecConvert &>(n);
+			child(c.expression);
+			return expr("convert " + c.target, false, scalar);
+		}
+		case ExecKind::ObjectAccess: {
+			auto &access = static_cast<ExecObjectAccess &>(n);
+			child(access.object);
+			if (access.dotKey) {
+				return expr("field " + access.keyName, true, true);
+			}
+			child(access.key);
+			return expr("key", true, true);
+		}
+		case ExecKind::ArrayAccess: {
+			auto &access = static_cast<ExecArrayAccess &>(n);
+			child(access.array);
+			child(access.index);
+			return expr("index", true, true);
+		}
+		case ExecKind::FunctionCall: {
+			auto &call = static_cast<ExecCall &>(n);
+			if (call.badName || call.badNamespace) {
+				return effect("unknown");
+			}
+			for (auto &arg : call.args) {
+				child(arg);
+			}
+			IrInstr *v = add(IrOp::Call, args, &node, call.name);
+			for (IrInstr *a : args) {
+				a->parent = v;
+			}
+			clobberCalled(&call.name);
+			return v;
+		}
+		case ExecKind::Length: {
+			// which reads lengths rather than memory
+			child(static_cast<ExecLength &>(n).target);
+			IrInstr *v = add(IrOp::Expr, {args[0], version(lengthsSlot())}, &node, "length");
+			args[0]->parent = v;
+			v->reusable = true;
+			return v;
+		}
+		default:
+			return effect("unknown");
+		}
+	}
+
+	// what inferTypes found the node may hold includes a string, an array
+	// or an object
+	static bool mayHoldHeap(const ExecNodePtr &node) {
+		using T = Value::Type;
+		TypeSet heap = typeBit(T::String) | typeBit(T::Array) | typeBit(T::Object);
+		return inferredTypes->typeOf(node.get()) & heap;
+	}
+
+	void statements(vector<ExecNodePtr> &list) {
+		for (auto &s : list) {
+			statement(s);
+		}
+	}
+
+	// an effect on the values in args, which changes memory, and lengths
+	// when the statement it is for resizes something
+	IrInstr *changeMemory(vector<IrInstr *> args, const char *label, ExecNode &s) {
+		args.push_back(version(memorySlot()));
+		IrInstr *v = add(IrOp::Effect, std::move(args), nullptr, label);
+		clobber(memorySlot());
+		if (resizes(s)) {
+			clobber(lengthsSlot());
+		}
+		return v;
+	}
+
+	void statement(ExecNodePtr &node) {
+		ExecNode &s = *node;
+		switch (s.kind) {
+		case ExecKind::Print: {
+			auto &print = static_cast<ExecPrint &>(s);
+			if (!print.hasList) {
+				break;
+			}
+			for (auto &e : print.expressions) {
+				add(IrOp::Effect, {value(e)}, nullptr, "print");
+			}
+			return;
+		}
+		case ExecKind::Block: {
+			IrBlock *outerYield = yieldTo;
+			yieldTo = nullptr;
+			openScope();
+			statements(static_cast<ExecBlock &>(s).statements);
+			closeScope();
+			yieldTo = outerYield;
+			return;
+		}
+		case ExecKind::If:
+			ifStatement(static_cast<ExecIf &>(s));
+			return;
+		case ExecKind::Assignment: {
+			auto &a = static_cast<ExecAssignment &>(s);
+			IrInstr *v = value(a.value);
+			ExecNode &target = *a.target;
+			if (target.kind == ExecKind::Variable) {
+				store(static_cast<ExecVariable &>(target).slot, v, &node, a.isConst);
+			} else if (target.kind == ExecKind::ObjectAccess) {
+				auto &access = static_cast<ExecObjectAccess &>(target);
+				changeMemory({v, value(access.object), value(access.key)}, "set field", s);
+			} else if (target.kind == ExecKind::ArrayAccess) {
+				auto &access = static_cast<ExecArrayAccess &>(target);
+				changeMemory({v, value(access.array), value(access.index)}, "set index", s)
+					->site = &a.target;
+			} else {
+				break;
+			}
+			return;
+		}
+		case ExecKind::Input: {
+			IrInstr *in = add(IrOp::Effect, {}, nullptr, "input");
+			store(static_cast<ExecInput &>(s).slot, in, nullptr, false);
+			return;
+		}
+		case ExecKind::Break:
+		case ExecKind::Continue:
+			if (!static_cast<ExecJump &>(s).inLoop) {
+				break;
+			}
+			leave(s.kind == ExecKind::Break ? targets.back().broke : targets.back().next);
+			return;
+		case ExecKind::WhileLoop:
+		case ExecKind::DoWhileLoop:
+			conditionLoop(static_cast<ExecLoop &>(s));
+			return;
+		case ExecKind::ForLoop:
+			forLoop(static_cast<ExecFor &>(s));
+			return;
+		case ExecKind::Return: {
+			auto &r = static_cast<ExecReturn &>(s);
+			IrInstr *v;
+			if (r.tailCall) {
+				auto &call = static_cast<ExecCall &>(*r.value);
+				vector<IrInstr *> args;
+				for (auto &arg : call.args) {
+					args.push_back(value(arg));
+				}
+				v = add(IrOp::Call, args, nullptr, call.name);
+			} else {
+				v = value(r.value);
+			}
+			if (!r.inFunction) {
+				break;
+			}
+			end(IrOp::Return, {v}, {});
+			return;
+		}
+		case ExecKind::FunctionDeclaration:
+			add(IrOp::Effect, {}, nullptr, "declare " + static_cast<ExecFunction &>(s).name);
+			return;
+		case ExecKind::Export:
+			add(IrOp::Effect, {}, nullptr, "export");
+			return;
+		case ExecKind::Push: {
+			auto &op = static_cast<ExecArrayOp &>(s);
+			changeMemory({value(op.array), value(op.value)}, "push", s);
+			return;
+		}
+		case ExecKind::Pop:
+			changeMemory({value(static_cast<ExecArrayOp &>(s).array)}, "pop", s);
+			return;
+		case ExecKind::Insert: {
+			auto &op = static_cast<ExecArrayOp &>(s);
+			changeMemory({value(op.array), value(op.index), value(op.value)}, "insert", s);
+			return;
+		}
+		case ExecKind::Erase: {
+			auto &op = static_cast<ExecArrayOp &>(s);
+			changeMemory({value(op.array), value(op.index)}, "erase", s);
+			return;
+		}
+		case ExecKind::Import:
+			add(IrOp::Effect, {}, nullptr, "import");
+			clobberCalled(nullptr);
+			return;
+		case ExecKind::Comment:
+			return;
+		case ExecKind::FunctionCall: {
+			IrInstr *v = value(node);
+			if (yieldTo) {
+				IrBlock *next = newBlock();
+				end(IrOp::Yield, {v}, {next, yieldTo});
+				seal(next);
+				current = next;
+			}
+			return;
+		}
+		default:
+			break;
+		}
+		// ExitProcess, or a statement that stops the program with an error
+		end(IrOp::Exit, {}, {});
+	}
+
+	void ifStatement(ExecIf &n) {
+		IrBlock *join = newBlock();
+		IrBlock *outerYield = yieldTo;
+		if (!yieldTo) {
+			yieldTo = join;
+		}
+		auto branch = [&](ExecBranch &b) {
+			IrInstr *condition = value(b.condition);
+			IrBlock *then = newBlock();
+			IrBlock *otherwise = newBlock();
+			end(IrOp::Branch, {condition}, {then, otherwise});
+			seal(then);
+			seal(otherwise);
+			current = then;
+			statements(b.body);
+			jump(join);
+			current = otherwise;
+		};
+		branch(n.then);
+		for (auto &elif : n.elifs) {
+			branch(elif);
+		}
+		statements(n.elseBody);
+		jump(join);
+		yieldTo = outerYield;
+		seal(join);
+		current = join;
+	}
+
+	IrLoop *openLoop(vector<ExecNodePtr> &hoisted) {
+		body.loops.push_back(make_unique<IrLoop>());
+		IrLoop *l = body.loops.back().get();
+		l->hoisted = &hoisted;
+		l->parent = loop;
+		loop = l;
+		l->header = newBlock();
+		l->header->header = true;
+		jump(l->header);
+		current = l->header;
+		return l;
+	}
+
+	// The body of a loop, from the block current branches to; leaves
+	// current at the end of an iteration, with the body's scope closed.
+	// Breaks go to broke, whose scope closes on the way to exit.
+	void loopBody(vector<ExecNodePtr> &statementList, IrBlock *outside,
+				  IrBlock *exit) {
+		IrBlock *next = newBlock();
+		IrBlock *broke = newBlock();
+		IrBlock *outerYield = yieldTo;
+		yieldTo = nullptr;
+		scopes.push_back({outside, {}});
+		targets.push_back({next, broke, scopes.size()});
+		statements(statementList);
+		jump(next);
+		targets.pop_back();
+		Scope scope = std::move(scopes.back());
+		scopes.pop_back();
+		yieldTo = outerYield;
+
+		seal(broke);
+		current = broke;
+		if (live(broke)) {
+			unscope(scope);
+			jump(exit);
+		}
+		current = nullptr;
+		seal(next);
+		current = next;
+		if (live(next)) {
+			unscope(scope);
+		} else {
+			current = nullptr;
+		}
+	}
+
+	void conditionLoop(ExecLoop &n) {
+		IrLoop *outer = loop;
+		IrLoop *l = openLoop(n.hoisted);
+		IrBlock *exit = newBlock();
+		exit->loop = outer;
+		IrBlock *start = newBlock();
+		if (n.kind == ExecKind::WhileLoop) {
+			l->first = l->header;
+			end(IrOp::Branch, {value(n.condition)}, {start, exit});
+		} else {
+			l->first = start;
+			jump(start);
+		}
+		seal(start);
+		current = start;
+		loopBody(n.body, l->header, exit);
+		if (n.kind == ExecKind::WhileLoop) {
+			jump(l->header);
+		} else if (current) {
+			end(IrOp::Branch, {value(n.condition)}, {l->header, exit});
+		}
+		seal(l->header);
+		loop = outer;
+		seal(exit);
+		current = exit;
+	}
+
+	void forLoop(ExecFor &n) {
+		IrBlock *outside = here();
+		IrBlock *before = newBlock();
+		jump(before);
+		seal(before);
+		current = before;
+		scopes.push_back({outside, {}});
+		IrInstr *init = value(n.init);
+		store(n.variable, init, nullptr, false);
+		IrInstr *stop = value(n.stop);
+		IrInstr *stepValue = value(n.step);
+		IrInstr *step = add(IrOp::Effect, {stepValue}, nullptr, "for step");
+
+		IrLoop *outer = loop;
+		IrLoop *l = openLoop(n.hoisted);
+		l->counter = version(n.variable);
+		l->init = init;
+		l->stop = stop;
+		l->step = stepValue;
+		IrBlock *exit = newBlock();
+		exit->loop = outer;
+		IrBlock *start = newBlock();
+		IrInstr *test = add(IrOp::Effect, {version(n.variable), stop, step}, nullptr,
+							"for test");
+		end(IrOp::Branch, {test}, {start, exit});
+		seal(start);
+		current = start;
+		loopBody(n.body, l->header, exit);
+		if (current) {
+			clobber(n.variable); // the step
+			jump(l->header);
+		}
+		seal(l->header);
+		loop = outer;
+		seal(exit);
+		current = exit;
+
+		Scope scope = std::move(scopes.back());
+		scopes.pop_back();
+		unscope(scope);
+	}
+
+	// Phis whose operands are all one version, and scope ends for a
+	// variable bound before the scope, become that version; then whether
+	// each version is bound for certain, assuming it is around loops until
+	// shown otherwise.
+	void simplify() {
+		vector<IrInstr *> versions;
+		for (auto &b : body.blocks) {
+			for (auto &v : b->phis) {
+				versions.push_back(v.get());
+			}
+			for (auto &v : b->instrs) {
+				if (v->op >= IrOp::Entry && v->op <= IrOp::Unscope) {
+					versions.push_back(v.get());
+				}
+			}
+		}
+		bool changed;
+		do {
+			changed = false;
+			for (IrInstr *v : versions) {
+				if (v->op != IrOp::Phi || v->replacedBy) {
+					continue;
+				}
+				IrInstr *only = nullptr;
+				bool trivial = true;
+				for (IrInstr *a : v->args) {
+					a = resolveVersion(a);
+					if (a == v || a == only) {
+						continue;
+					} else if (only) {
+						trivial = false;
+						break;
+					}
+					only = a;
+				}
+				if (trivial && only) {
+					v->replacedBy = only;
+					changed = true;
+				}
+			}
+			for (IrInstr *v : versions) {
+				if (v->op != IrOp::Entry) {
+					v->bound = true;
+				}
+			}
+			bool narrowed;
+			do {
+				narrowed = false;
+				for (IrInstr *v : versions) {
+					bool bound = v->bound;
+					if (v->op == IrOp::Phi) {
+						for (IrInstr *a : v->args) {
+							bound = bound && resolveVersion(a)->bound;
+						}
+					} else if (v->op == IrOp::Clobber || v->op == IrOp::Unscope) {
+						bound = resolveVersion(v->args[0])->bound;
+					}
+					if (bound != v->bound) {
+						v->bound = bound;
+						narrowed = true;
+					}
+				}
+			} while (narrowed);
+			for (IrInstr *v : versions) {
+				if (v->op == IrOp::Unscope && !v->replacedBy &&
+					resolveVersion(v->args[0])->bound) {
+					v->replacedBy = resolveVersion(v->args[1]);
+					changed = true;
+				}
+			}
+		} while (changed);
+	}
+
+	void build(vector<ExecNodePtr> &statementList) {
+		current = newBlock();
+		current->sealed = true;
+		statements(statementList);
+		end(IrOp::Return, {}, {});
+		simplify();
+	}
+};
+
+// The slots named in a body, outside the functions declared there
+void slotsUsed(ExecNode &node, vector<bool> &used) {
+	switch (node.kind) {
+	case ExecKind::Variable:
+		used[static_cast<ExecVariable &>(node).slot] = true;
+		break;
+	case ExecKind::Input:
+		used[static_cast<ExecInput &>(node).slot] = true;
+		break;
+	case ExecKind::ForLoop:
+		used[static_cast<ExecFor &>(node).variable] = true;
+		break;
+	default:
+		break;
+	}
+	forEachChild(node, [&](ExecNodePtr &child) { slotsUsed(*child, used); });
+}
+
+void dumpIr(const IrBody &body, const char *stage) {
+	auto slotName = [](int slot) {
+		if (slot >= memorySlot()) {
+			return string(slot == memorySlot() ? "memory" : "lengths");
+		}
+		return variableNames[slot];
+	};
+	auto print = [&](const IrInstr &v) {
+		static const char *const ops[] = {"const", "load", "", "call", "",
+										  "entry", "phi", "store", "clobber", "unscope",
+										  "jump", "branch", "yield", "return", "exit"};
+		cerr << "  ";
+		if (v.op < IrOp::Jump) {
+			cerr << 'v' << v.id << " = ";
+		}
+		cerr << ops[static_cast<int>(v.op)];
+		if (v.op == IrOp::Expr || v.op == IrOp::Effect) {
+			cerr << v.label;
+		} else if (v.op == IrOp::Const || v.op == IrOp::Call) {
+			cerr << ' ' << v.label;
+		} else if (v.slot >= 0 && v.op != IrOp::Jump) {
+			cerr << ' ' << slotName(v.slot);
+		}
+		for (IrInstr *a : v.args) {
+			cerr << " v" << resolveVersion(a)->id;
+		}
+		for (IrBlock *b : v.block->succs) {
+			if (v.op >= IrOp::Jump) {
+				cerr << " b" << b->id;
+			}
+		}
+		if (v.replacedBy) {
+			cerr << "  ; = v" << resolveVersion(v.replacedBy)->id;
+		} else if (v.constant) {
+			cerr << "  ; = v" << resolveValue(v.same)->id << ", constant";
+		} else if (v.same) {
+			cerr << "  ; = v" << resolveValue(v.same)->id;
+		} else if (v.hoistedTo) {
+			cerr << "  ; hoisted out of b" << v.hoistedTo->header->id;
+		} else if (v.dead) {
+			cerr << "  ; dead";
+		} else if (v.inBounds) {
+			cerr << "  ; in bounds";
+		}
+		cerr << '\n';
+	};
+	cerr << "; " << body.name << ", " << stage << '\n';
+	for (const auto &b : body.blocks) {
+		if (!IrBuilder::live(b.get())) {
+			continue;
+		}
+		cerr << 'b' << b->id << ':';
+		if (!b->preds.empty()) {
+			cerr << " preds";
+			for (IrBlock *p : b->preds) {
+				cerr << " b" << p->id;
+			}
+		}
+		if (b->loop) {
+			cerr << " (loop b" << b->loop->header->id << ')';
+		}
+		cerr << '\n';
+		for (const auto &v : b->phis) {
+			if (!v->replacedBy) {
+				print(*v);
+			}
+		}
+		for (const auto &v : b->instrs) {
+			print(*v);
+		}
+	}
+}
+
+// Copy propagation: a read of a version an assignment made is the value
+// it assigned
+void propagateCopies(IrBody &body) {
+	for (auto &b : body.blocks) {
+		for (auto &v : b->instrs) {
+			if (v->op != IrOp::Load) {
+				continue;
+			}
+			IrInstr *version = resolveVersion(v->args[0]);
+			if (version->op != IrOp::Store) {
+				continue;
+			}
+			v->same = version->args[0];
+			IrInstr *value = resolveValue(v.get());
+			ExecKind kind = value->op == IrOp::Const ? (*value->site)->kind : ExecKind::Unknown;
+			v->constant = kind == ExecKind::Int || kind == ExecKind::Bool ||
+						  (kind == ExecKind::Float &&
+						   isfinite(static_cast<ExecFloat &>(**value->site).value));
+		}
+	}
+}
+
+// Loop-invariant code motion, innermost loops first so that what moves out
+// of one can move on out of the loop around it
+void hoistInvariants(IrBody &body) {
+	auto reenters = [&](const IrInstr &v) {
+		if (v.op == IrOp::Effect) {
+			return v.label == "import";
+		} else if (v.op != IrOp::Call) {
+			return false;
+		}
+		auto it = callEffects.find(v.label);
+		return it == callEffects.end() || it->second.writes.count(-1) ||
+			   (body.function && (v.label == body.function->name ||
+								  it->second.calls.count(body.function->name)));
+	};
+	for (size_t i = body.loops.size(); i-- > 0;) {
+		IrLoop *loop = body.loops[i].get();
+		vector<IrBlock *> blocks;
+		bool safe = true;
+		for (auto &b : body.blocks) {
+			if (inLoop(b.get(), loop)) {
+				blocks.push_back(b.get());
+				for (auto &v : b->instrs) {
+					safe = safe && !reenters(*v);
+				}
+			}
+		}
+		if (!safe) {
+			continue;
+		}
+		// whether a version is made outside the loop
+		auto outside = [&](IrInstr *version) {
+			return !inLoop(resolveVersion(version)->block, loop);
+		};
+		unordered_set<const IrInstr *> movable;
+		for (IrBlock *b : blocks) {
+			// nothing before here in the loop's first block could fail
+			bool first = b == loop->first;
+			for (auto &instr : b->instrs) {
+				IrInstr *v = instr.get();
+				bool moves = false;
+				if (v->op == IrOp::Const) {
+					moves = true;
+				} else if (v->op == IrOp::Load) {
+					moves = v->constant ||
+							(outside(v->args[0]) && (first || !mayFail(v)));
+				} else if (v->op == IrOp::Expr && v->reusable) {
+					moves = first || !mayFail(v);
+					for (IrInstr *a : v->args) {
+						bool child = a->parent == v;
+						moves = moves && (child ? movable.count(a) > 0 : outside(a));
+					}
+				}
+				if (moves) {
+					movable.insert(v);
+					if (v->op == IrOp::Expr) {
+						v->hoistedTo = loop;
+					}
+				} else if (v->op > IrOp::Expr || mayFail(v)) {
+					first = false;
+				}
+			}
+		}
+	}
+}
+
+// Whether an ancestor of v moved out of its loop
+bool insideHoisted(const IrInstr *v) {
+	for (const IrInstr *p = v->parent; p; p = p->parent) {
+		if (p->hoistedTo) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// The number an instruction's value has for eliminateCommon: equal numbers,
+// equal values
+string valueNumber(IrInstr *v) {
+	if (v->op >= IrOp::Entry && v->op <= IrOp::Unscope) {
+		return 'm' + to_string(resolveVersion(v)->id);
+	}
+	v = resolveValue(v);
+	if (v->op == IrOp::Const) {
+		return 'c' + v->label;
+	} else if (v->op == IrOp::Load) {
+		return 'l' + to_string(resolveVersion(v->args[0])->id);
+	}
+	return 'v' + to_string(v->id);
+}
+
+// Common subexpression elimination within each block, and among what moved
+// out of each loop
+void eliminateCommon(IrBody &body) {
+	auto keyOf = [](IrInstr *v) {
+		string key = v->label;
+		for (IrInstr *a : v->args) {
+			key += ' ' + valueNumber(a);
+		}
+		return key;
+	};
+	unordered_map<IrLoop *, unordered_map<string, IrInstr *>> hoisted;
+	for (auto &b : body.blocks) {
+		for (auto &v : b->instrs) {
+			if (IrLoop *loop = v->hoistedTo) {
+				auto [it, added] = hoisted[loop].emplace(keyOf(v.get()), v.get());
+				if (!added) {
+					v->same = it->second;
+				}
+			}
+		}
+	}
+	for (auto &b : body.blocks) {
+		unordered_map<string, IrInstr *> seen;
+		for (auto &instr : b->instrs) {
+			IrInstr *v = instr.get();
+			if (v->op == IrOp::Call || (v->op == IrOp::Effect && v->label == "import")) {
+				seen.clear();
+			}
+			if (v->op != IrOp::Expr || !v->reusable || v->hoistedTo || insideHoisted(v)) {
+				continue;
+			}
+			auto [it, added] = seen.emplace(keyOf(v), v);
+			if (!added) {
+				v->same = it->second;
+			}
+		}
+	}
+}
+
+// Dead store elimination within each block
+void eliminateDeadStores(IrBody &body) {
+	// the values some other instruction stands for
+	unordered_set<const IrInstr *> shared;
+	for (auto &b : body.blocks) {
+		for (auto &v : b->instrs) {
+			if (v->same) {
+				shared.insert(resolveValue(v.get()));
+			}
+		}
+	}
+	auto within = [](const IrInstr *v, const IrInstr *root) {
+		for (; v; v = v->parent) {
+			if (v == root) {
+				return true;
+			}
+		}
+		return false;
+	};
+	for (auto &b : body.blocks) {
+		auto &instrs = b->instrs;
+		for (size_t i = 0; i < instrs.size(); i++) {
+			IrInstr *s = instrs[i].get();
+			if (s->op != IrOp::Store || !s->site || s->isConst || assignedConst[s->slot]) {
+				continue;
+			}
+			bool overwritten = false;
+			for (size_t j = i + 1; j < instrs.size(); j++) {
+				IrInstr *v = instrs[j].get();
+				bool reads = v->op == IrOp::Call || v->op >= IrOp::Jump ||
+							 (v->op == IrOp::Effect && (v->label == "import" || v->label == "unknown"));
+				for (IrInstr *a : v->args) {
+					reads = reads || (resolveVersion(a) == s && !v->constant);
+				}
+				if (reads || (v->slot == s->slot && v->op >= IrOp::Entry && v->isConst)) {
+					break;
+				} else if (v->slot == s->slot && v->op >= IrOp::Entry) {
+					overwritten = v->op == IrOp::Store;
+					break;
+				}
+			}
+			if (!overwritten) {
+				continue;
+			}
+			// the value goes too, so it has to be one that can go
+			IrInstr *value = s->args[0];
+			bool removable = true;
+			for (size_t j = 0; j < i && removable; j++) {
+				IrInstr *v = instrs[j].get();
+				if (within(v, value)) {
+					removable = v->op == IrOp::Const ||
+								((v->op == IrOp::Load || v->op == IrOp::Expr) && !mayFail(v) &&
+								 !v->hoistedTo && !shared.count(v));
+				}
+			}
+			s->dead = removable && value->block == b.get();
+		}
+	}
+}
+
+// Bounds check elimination: in สำหรับ i ในช่วง(a, arr.ขนาด(), step), with
+// a and step int literals, a not negative and step positive, arr[i] is in
+// bounds as long as neither arr nor i was assigned in the loop and nothing
+// in it changes lengths. arr may still not be an array; the
+// engines check that much.
+void eliminateBoundsChecks(IrBody &body) {
+	unordered_set<const IrLoop *> resizing;
+	for (auto &b : body.blocks) {
+		for (auto &v : b->instrs) {
+			if (v->op == IrOp::Clobber && v->slot == lengthsSlot()) {
+				for (const IrLoop *l = b->loop; l; l = l->parent) {
+					resizing.insert(l);
+				}
+			}
+		}
+	}
+	auto intLiteral = [](IrInstr *v, int atLeast) {
+		v = resolveValue(v);
+		if (v->op != IrOp::Const) {
+			return false;
+		}
+		Value literal = literalValue(v->site->get());
+		return literal.holds<int>() && literal.as<int>() >= atLeast;
+	};
+	auto counts = [&](const IrLoop *l, IrInstr *array) {
+		if (!l->counter || resizing.count(l) || !intLiteral(l->init, 0) ||
+			!intLiteral(l->step, 1)) {
+			return false;
+		}
+		IrInstr *stop = resolveValue(l->stop);
+		return stop->op == IrOp::Expr && stop->label == "length" &&
+			   valueNumber(stop->args[0]) == valueNumber(array);
+	};
+	for (auto &b : body.blocks) {
+		for (auto &instr : b->instrs) {
+			IrInstr *v = instr.get();
+			IrInstr *array;
+			IrInstr *index;
+			if (v->op == IrOp::Expr && v->label == "index") {
+				array = v->args[0];
+				index = v->args[1];
+			} else if (v->op == IrOp::Effect && v->label == "set index") {
+				array = v->args[1];
+				index = v->args[2];
+			} else {
+				continue;
+			}
+			index = resolveValue(index);
+			if (index->op != IrOp::Load) {
+				continue;
+			}
+			IrInstr *counter = resolveVersion(index->args[0]);
+			for (const IrLoop *l = b->loop; l; l = l->parent) {
+				if (l->counter && resolveVersion(l->counter) == counter) {
+					v->inBounds = counts(l, array);
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Writes what the passes found into the lowered tree
+void lowerIr(IrBody &body) {
+	vector<IrInstr *> all;
+	for (auto &b : body.blocks) {
+		for (auto &v : b->instrs) {
+			all.push_back(v.get());
+		}
+	}
+	auto temp = [](int index, ExecNodePtr value, const ExecNode &at) {
+		auto t = make_unique<ExecTemp>();
+		t->kind = ExecKind::Temp;
+		t->line = at.line;
+		t->column = at.column;
+		t->index = index;
+		t->value = std::move(value);
+		return t;
+	};
+	auto newTemp = [] {
+		temps.emplace_back();
+		return static_cast<int>(temps.size()) - 1;
+	};
+
+	for (IrInstr *v : all) {
+		if (v->inBounds) {
+			static_cast<ExecArrayAccess &>(**v->site).inBounds = true;
+		}
+	}
+	for (IrInstr *v : all) {
+		if (v->constant) {
+			ExecNodePtr &site = *v->site;
+			site = literalNode(literalValue(resolveValue(v)->site->get()), *site);
+		}
+	}
+	for (IrInstr *v : all) {
+		if (v->dead) {
+			ExecNodePtr &site = *v->site;
+			auto comment = make_unique<ExecNode>();
+			comment->kind = ExecKind::Comment;
+			comment->line = site->line;
+			comment->column = site->column;
+			site = std::move(comment);
+		}
+	}
+	unordered_map<const IrInstr *, int> kept;
+	for (IrInstr *v : all) {
+		IrLoop *loop = v->hoistedTo;
+		if (!loop || (v->parent && v->parent->hoistedTo == loop)) {
+			continue;
+		}
+		ExecNodePtr &site = *v->site;
+		// the same value hoisted earlier as a whole, not as part of another
+		if (auto it = kept.find(v->same); it != kept.end()) {
+			site = temp(it->second, nullptr, *site);
+			continue;
+		}
+		int index = newTemp();
+		ExecNode &at = *site;
+		loop->hoisted->push_back(temp(index, std::move(site), at));
+		site = temp(index, nullptr, *loop->hoisted->back());
+		kept[v] = index;
+	}
+
+	// an operator goes when one around it goes too; the one it reuses has
+	// to stay
+	unordered_set<const IrInstr *> replaced;
+	for (IrInstr *v : all) {
+		if (v->op == IrOp::Expr && v->same && !v->hoistedTo) {
+			replaced.insert(v);
+		}
+	}
+	auto under = [&](const IrInstr *v) {
+		for (const IrInstr *p = v->parent; p; p = p->parent) {
+			if (replaced.count(p)) {
+				return true;
+			}
+		}
+		return false;
+	};
+	for (IrInstr *v : all) {
+		if (!replaced.count(v) || under(v) || under(v->same)) {
+			continue;
+		}
+		IrInstr *first = v->same;
+		auto it = kept.find(first);
+		if (it == kept.end()) {
+			ExecNodePtr &site = *first->site;
+			int index = newTemp();
+			ExecNode &at = *site;
+			site = temp(index, std::move(site), at);
+			it = kept.emplace(first, index).first;
+		}
+		ExecNodePtr &site = *v->site;
+		site = temp(it->second, nullptr, *site);
+	}
+}
+
+void optimizeBody(const string &name, const ExecFunction *function,
+				  vector<ExecNodePtr> &statements) {
+	IrBody body;
+	body.name = name;
+	body.function = function;
+	IrBuilder builder{body};
+	vector<bool> used(variableNames.size());
+	for (auto &stmt : statements) {
+		slotsUsed(*stmt, used);
+	}
+	for (size_t slot = 0; slot < used.size(); slot++) {
+		if (used[slot]) {
+			builder.used.push_back(static_cast<int>(slot));
+		}
+	}
+	if (function) {
+		builder.parameters.insert(function->parameters.begin(), function->parameters.end());
+	}
+	builder.build(statements);
+
+	auto dump = [&](const char *stage) {
+		if (runOptions.dumpIr) {
+			dumpIr(body, stage);
+		}
+	};
+	dump("before optimization");
+	propagateCopies(body);
+	dump("after copy propagation");
+	hoistInvariants(body);
+	dump("after loop-invariant code motion");
+	eliminateCommon(body);
+	dump("after common subexpression elimination");
+	eliminateDeadStores(body);
+	dump("after dead store elimination");
+	eliminateBoundsChecks(body);
+	dump("after bounds check elimination");
+	lowerIr(body);
+}
+
+// entry: the program mmt was started on, rather than an imported module
+void optimizeIr(ExecProgram &program, bool entry) {
+	// a module that names variables nothing else did was not there to infer
+	// types for
+	if (!inferredTypes || inferredTypes->slots.size() != variableNames.size()) {
+		return;
+	}
+	if (entry) {
+		assignedConst.assign(variableNames.size(), false);
+		for (ExecProgram *p : wholeProgram(program)) {
+			forEachNode(*p, [](ExecNode &n) {
+				auto &a = static_cast<ExecAssignment &>(n);
+				if (n.kind == ExecKind::Assignment && a.isConst &&
+					a.target->kind == ExecKind::Variable) {
+					assignedConst[static_cast<ExecVariable &>(*a.target).slot] = true;
+				}
+			});
+		}
+	}
+	optimizeBody(entry ? "program" : "module", nullptr, program.statements);
+	forEachNode(program, [](ExecNode &n) {
+		if (n.kind == ExecKind::FunctionDeclaration) {
+			auto &f = static_cast<ExecFunction &>(n);
+			optimizeBody("function " + f.name, &f, f.body);
+		}
+	});
+}
+
+// evalStatement
+
+Completion evalStatement(const ExecNode *stmt);
+
+bool hotLoop(const ExecNode &loop, LoopTier &tier);
+void resumeLoop(const Chunk &chunk, const Value *stop = nullptr,
+				const Value *step = nullptr);
+
+// Runs statements in a scope of their own (one loop iteration or a block)
+// until one of them breaks, continues or returns.
+Completion evalScoped(const vector<ExecNodePtr> &body) {
+	pushScope();
+	Completion done;
+	for (const auto &s : body) {
+		Completion c = evalStatement(s.get());
+		if (c.flow != Flow::Normal) {
+			done = std::move(c);
+			break;
+		}
+	}
+	if (done.flow != Flow::TailCall) {
+		popScope();
+	}
+	return done;
+}
+
+// An if runs its branch until a statement produces a value (a call that
+// returned something) and hands that value on to the enclosing function.
+Completion evalBranch(const vector<ExecNodePtr> &body) {
+	for (const auto &s : body) {
+		Completion c = evalStatement(s.get());
+		if (c.flow != Flow::Normal || c.value)
+			return c;
+	}
+	return nullptr;
+}
+
+Completion evalStatement(const ExecNode *stmt) {
+	switch (stmt->kind) {
+	case ExecKind::Invalid:
+		cerr << "❌ stmt ไม่ใช่ json object แต่เป็น: "
+			 << static_cast<const ExecInvalid *>(stmt)->text << "";
+		exit(1);
+
+	case ExecKind::Print: {
+	  const auto &print = static_cast<const ExecPrint &>(*stmt);
+	  // ตรวจสอบว่า expression เป็น array
+	  if (!print.hasList) {
+	    cerr << " print ต้องการ array ของ expressions\n";
+	    exit(1);
+	  }
+
+	  for (const auto& expr : print.expressions) {
+	    Value val = evalExpr(expr.get());
+	    printValue(val);
+	   // cout << " ";
+	  }
+	  cout << "";
+	  return nullptr;
+	}
+	case ExecKind::Block: {
+		Completion c = evalScoped(static_cast<const ExecBlock *>(stmt)->statements);
+		if (c.flow != Flow::Normal) {
+			return c;
+		}
+		return nullptr;
+	}
+	case ExecKind::If: {
+		const auto &ifStmt = static_cast<const ExecIf &>(*stmt);
+		if (evalExpr(ifStmt.then.condition.get()).as<bool>()) {
+			return evalBranch(ifStmt.then.body);
+		}
+		for (const auto &elifStmt : ifStmt.elifs) {
+			if (evalExpr(elifStmt.condition.get()).as<bool>()) {
+				return evalBranch(elifStmt.body); // ✅ ถ้า elif ตรงเงื่อนไข ให้หยุดที่นี่
+			}
+		}
+
+		// ✅ else ทำงานเมื่อไม่มี elif ใดๆ ตรงเลย
+		if (ifStmt.hasElse) {
+			return evalBranch(ifStmt.elseBody);
+		}
+		return nullptr;
+	}
+
+	case ExecKind::Assignment: {
+	    const auto &assign = static_cast<const ExecAssignment &>(*stmt);
+	    const ExecNode *target = assign.target.get();
+	    Value val = evalExpr(assign.value.get());
+	    if (target->kind == ExecKind::Variable) {
+	        int slot = static_cast<const ExecVariable *>(target)->slot;
+	        setvar(slot, val, stmt->line, stmt->column, assign.isConst);
+	    } else if (target->kind == ExecKind::ObjectAccess) {
+			const auto &access = static_cast<const ExecObjectAccess &>(*target);
+			Value obj = evalExpr(access.object.get());
+			Value key = evalExpr(access.key.get());
+			assignField(obj, key, val, stmt->line, stmt->column);
+		} else if (target->kind == ExecKind::ArrayAccess) {
+			const auto &access = static_cast<const ExecArrayAccess &>(*target);
+			Value arr = evalExpr(access.array.get());
+			Value index = evalExpr(access.index.get());
+			if (access.inBounds) {
+				assignInBounds(arr, index, val, stmt->line, stmt->column);
+			} else {
+				assignIndex(arr, index, val, stmt->line, stmt->column);
+			}
+		} else {
+			cerr << "ไม่สามารถกำหนดค่าสิ่งนี้ได้ ที่บรรทัด " << stmt->line << " คอลัมน์ "
+				 << stmt->column << "";
+			exit(1);
+		}
+
+		return nullptr;
+	}
+	case ExecKind::Input: {
+		int slot = static_cast<const ExecInput *>(stmt)->slot;
+		string in;
+		getline(cin, in);
+		setvar(slot, Value(in), stmt->line,
+			   stmt->column,false);
+		return nullptr;
+	}
+	case ExecKind::Break:
+		if (!static_cast<const ExecJump *>(stmt)->inLoop) {
+			misplacedStatement("ออก", "ลูป", stmt->line, stmt->column);
+		}
+		return Flow::Break;
+	case ExecKind::Continue:
+		if (!static_cast<const ExecJump *>(stmt)->inLoop) {
+			misplacedStatement("ถัดไป", "ลูป", stmt->line, stmt->column);
+		}
+		return Flow::Continue;
+	case ExecKind::WhileLoop: {
+		const auto &loop = static_cast<const ExecLoop &>(*stmt);
+		for (const auto &h : loop.hoisted) {
+			evalExpr(h.get());
+		}
+		while (getBool(evalExpr(loop.condition.get()))) {
+			// ทำซ้ำ block
+			Completion c = evalScoped(loop.body);
+			if (c.flow == Flow::Break) {
+				break; // ออกจากลูป
+			} else if (c.flow == Flow::Return || c.flow == Flow::TailCall) {
+				return c;
+			}
+			if ((runOptions.osr || runOptions.jit) && hotLoop(*stmt, loop.tier)) {
+				resumeLoop(*loop.tier.chunk); // from the condition
+				break;
+			}
+		}
+		return nullptr;
+	}
+	case ExecKind::DoWhileLoop: {
+		const auto &loop = static_cast<const ExecLoop &>(*stmt);
+		for (const auto &h : loop.hoisted) {
+			evalExpr(h.get());
+		}
+		for (;;) {
+			// ทำซ้ำ block
+			Completion c = evalScoped(loop.body);
+			if (c.flow == Flow::Break) {
+				break; // ออกจากลูป
+			} else if (c.flow == Flow::Return || c.flow == Flow::TailCall) {
+				return c;
+			}
+			if (!getBool(evalExpr(loop.condition.get()))) {
+				break;
+			}
+			if ((runOptions.osr || runOptions.jit) && hotLoop(*stmt, loop.tier)) {
+				resumeLoop(*loop.tier.chunk); // from the body
+				break;
+			}
+		}
+		return nullptr;
+	}
+	case ExecKind::ForLoop: {
+	    const auto &loop = static_cast<const ExecFor &>(*stmt);
+	    // สร้าง scope สำหรับตัวแปรลูป
+	    pushScope();
+
+	    // 1. กำหนดค่าเริ่มต้นให้ตัวแปร
+	    int varName = loop.variable;
+	    Value initVal = evalExpr(loop.init.get());
+	    setvar(varName, initVal, stmt->line, stmt->column, false);
+
+	    // 2. ประเมินค่าสิ้นสุดและขั้นตอน
+	    Value stopVal = evalExpr(loop.stop.get());
+	    Value step = forLoopStep(evalExpr(loop.step.get()), stmt->line,
+								     stmt->column);
+	    for (const auto &h : loop.hoisted) {
+	        evalExpr(h.get());
+	    }
+
+	    // วนลูปตราบใดที่เงื่อนไขเป็นจริง
+	    while (forLoopContinues(varName, stopVal, step, stmt->line, stmt->column)) {
+	        // ประมวลผล body ใน scope ของตัวเอง
+	        Completion c = evalScoped(loop.body);
+	        if (c.flow == Flow::Break) {
+	            break;
+	        } else if (c.flow == Flow::Return) {
+	            popScope(); // ลบ scope ของลูป
+	            return c;
+	        } else if (c.flow == Flow::TailCall) {
+	            return c;
+	        }
+
+	        // อัปเดตค่าตัวแปรหลังจากจบ body (หรือ continue)
+	        forLoopAdvance(varName, step, stmt->line, stmt->column);
+	        if ((runOptions.osr || runOptions.jit) && hotLoop(*stmt, loop.tier)) {
+	            // from the test; the VM closes the loop's scope
+	            resumeLoop(*loop.tier.chunk, &stopVal, &step);
+	            return nullptr;
+	        }
+	    }
+
+	    // ลบ scope ของลูป
+	    popScope();
+	    return nullptr;
+	}
+	case ExecKind::Return: {
+		const auto &ret = static_cast<const ExecReturn &>(*stmt);
+		if (ret.tailCall) {
+			const auto &call = static_cast<const ExecCall &>(*ret.value);
+			for (auto &arg : call.args) {
+				Value v = evalExpr(arg.get());
+				callArgs.push_back(std::move(v));
+			}
+			tailCall.target = &resolveCall(call.cache, call.ns, call.name,
+										   call.args.size(), call.line, call.column);
+			tailCall.argc = call.args.size();
+			if (runOptions.jit) {
+				countCall(*tailCall.target);
+			}
+			return Flow::TailCall;
+		}
+		Value val = evalExpr(ret.value.get());
+		if (!ret.inFunction) {
+			misplacedStatement("คืนค่า", "โปรแกรม", stmt->line, stmt->column);
+		}
+		return {Flow::Return, std::move(val)};
+	}
+	case ExecKind::FunctionDeclaration: {
+		const auto &decl = static_cast<const ExecFunction &>(*stmt);
+		functionTable[decl.name] = makeFunctionDef(decl);
+		return nullptr;
+	}
+	case ExecKind::Push: {
+		const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+		Value arrayVal = evalExpr(op.array.get());
+		Value value = evalExpr(op.value.get());
+		pushItem(arrayVal, value, stmt->line, stmt->column);
+		return nullptr;
+	}
+	case ExecKind::Pop: {
+		const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+		Value arrayVal = evalExpr(op.array.get());
+		popItem(arrayVal, stmt->line, stmt->column);
+		return nullptr;
+	}
+	case ExecKind::Insert: {
+		const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+		Value arrayVal = evalExpr(op.array.get());
+		Value indexVal = evalExpr(op.index.get());
+		Value valueToInsert = evalExpr(op.value.get());
+		insertItem(arrayVal, indexVal, valueToInsert, stmt->line, stmt->column);
+		return nullptr;
+	}
+	case ExecKind::Erase: {
+		const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+		Value arrayVal = evalExpr(op.array.get());
+		Value indexVal = evalExpr(op.index.get());
+		eraseItem(arrayVal, indexVal, stmt->line, stmt->column);
+		return nullptr;
+	}
+	case ExecKind::ExitProcess:
+		exit(0);
+	case ExecKind::Export:
+		exportFunctions(static_cast<const ExecExport &>(*stmt));
+		return nullptr;
+	case ExecKind::Import:
+		importModule(static_cast<const ExecImport &>(*stmt));
+		return nullptr;
+	case ExecKind::Comment:
+		return nullptr;
+	case ExecKind::FunctionCall:
+        return evalExpr(stmt);  // คืนค่าที่ evalExpr คืนกลับมาเลย
+	default:
+		break;
+	}
+
+	cerr << "ไม่รู้จักคำสั่งประเภทนี้ "<<" ที่บรรทัด "<<stmt->line<<" คอลัมน์ "<<stmt->column<< "";
+	exit(1);
+	// bracket below refer to evalStatement
+}
+
+// Bytecode VM
+//
+// With --vm every lowered program and function body is compiled once into a
+// Chunk and run on a value stack instead of being walked. Variables use the
+// same slots as the tree walker and each operation goes through the same
+// helpers as evalExpr/evalStatement, so both engines print the same output
+// and fail with the same messages. break/continue are jumps that first close
+// the scopes opened inside the loop body, and Return closes every scope the
+// chunk opened. TailCall instead merges those scopes into the function's and
+// carries on with the callee's chunk in the same runChunk frame.
+
+enum class OpCode : uint8_t {
+	Constant,		// push constants[a], a fresh copy for strings
+	Null,			// push ว่าง
+	NoValue,		// push nullptr: the statement produced no value
+	LoadVar,		// variables[a]
+	StoreVar,		// setvar(a, pop, isConst = b)
+	Pop,
+	MakeArray,		// a elements
+	CheckKey,		// top of stack is an object literal key
+	MakeObject,		// a key/value pairs
+	Unary,			// a: TokenType
+	StepVar,		// ++/-- on variables[a], b: TokenType
+	StepField,		// o.name, names[a], b: TokenType
+	StepKey,		// o[key], b: TokenType
+	StepIndex,		// a[i], b: TokenType
+	Binary,			// nodes[a], the ExecBinary with its type feedback
+	Proven,			// nodes[a], an ExecBinary inferTypes proved; evalProven
+	Ln,
+	Convert,		// names[a] is the target type
+	GetField,		// o.name, names[a]
+	GetKey,			// o[key]
+	GetIndex,		// a: 1 when optimizeIr proved the index in bounds
+	Length,
+	Keep,			// temps[a] = top of stack, which stays
+	Reuse,			// push temps[a]
+	Call,			// calls[a]
+	InlineCall,		// nodes[a], an ExecCall with its callee inlined
+	Print,
+	Jump,			// a: target
+	JumpIfFalse,	// if/elif condition
+	LoopIfFalse,	// whileloop condition
+	LoopIfTrue,		// dowhileloop condition
+	JumpIfValue,	// leave the if with a statement's value, else pop it
+	SetResult,		// remember a function body statement's value
+	Return,
+	TailCall,		// คืนค่า calls[a](...)
+	End,
+	PushScope,
+	PopScope,
+	ForPrep,		// pop step and stop into slots a+1 and a
+	ForTest,		// a: exit target, b: frame slot, c: variables[c]
+	ForStep,		// b: frame slot, c: variables[c]
+	SetField,		// value, object, key
+	SetIndex,		// value, array, index; a as for GetIndex
+	ArrayPush,
+	ArrayPop,
+	ArrayInsert,
+	ArrayErase,
+	Input,			// variables[a]
+	DefineFunction, // nodes[a]
+	Export,			// nodes[a]
+	Import,			// nodes[a]
+	Exit,
+	EvalExpr,		// nodes[a], for malformed or unknown nodes
+	EvalStatement,	// nodes[a]
+};
+
+struct Instr {
+	OpCode op;
+	int a = 0;
+	int b = 0;
+	int c = 0;
+	int line = 0;
+	int column = 0;
+};
+
+struct Chunk {
+	vector<Instr> code;
+	vector<Value> constants;
+	vector<string> names;
+	vector<CallSite> calls;
+	vector<const ExecNode *> nodes;
+	int slotCount = 0; // for-loop stop/step values
+	int entry = 0; // where a loop chunk resumes; see compileLoop()
+};
+
+// Compiled bodies, keyed by the statement list they were compiled from.
+unordered_map<const vector<ExecNodePtr> *, unique_ptr<Chunk>> compiledChunks;
+
+const Chunk &compileChunk(const vector<ExecNodePtr> &body, bool isFunction);
+
+class BytecodeCompiler {
+public:
+	explicit BytecodeCompiler(Chunk &chunk) :
+		chunk(chunk) {}
+
+	void compile(const vector<ExecNodePtr> &body, bool function) {
+		isFunction = function;
+		for (const auto &s : body) {
+			statement(s.get(), isFunction ? Use::FunctionResult : Use::Discard);
+		}
+		emit(OpCode::End, 0, 0);
+	}
+
+	// A loop on its own, for the tree walker to hand over with --osr. A for
+	// loop resumes at its test with its stop and step already in frame
+	// slots 0 and 1; the others resume at their start.
+	void compileLoop(const ExecNode *loop) {
+		statement(loop, Use::Discard);
+		emit(OpCode::End, 0, 0);
+		if (loop->kind == ExecKind::ForLoop) {
+			while (chunk.code[chunk.entry].op != OpCode::ForTest) {
+				chunk.entry++;
+			}
+		}
+	}
+
+private:
+	// What happens to the value of a call statement (or of an if that ran
+	// one); see evalBranch() and evalFunctionFromParts().
+	enum class Use { Discard, FunctionResult, IfBranch };
+
+	struct Loop {
+		int scopes; // openScopes inside the body
+		vector<int> breaks = {};
+		vector<int> continues = {};
+	};
+
+	Chunk &chunk;
+	bool isFunction = false;
+	vector<Loop> loops;
+	int openScopes = 0; // PushScopes in effect at the current instruction
+	vector<int> *ifExits = nullptr; // JumpIfValue sites of the innermost if
+	unordered_map<string, int> nameIndex;
+	int slotTop = 0;
+
+	int here() const { return static_cast<int>(chunk.code.size()); }
+
+	int emit(OpCode op, int line, int column, int a = 0, int b = 0, int c = 0) {
+		chunk.code.push_back({op, a, b, c, line, column});
+		return here() - 1;
+	}
+
+	int emit(OpCode op, const ExecNode *at, int a = 0, int b = 0, int c = 0) {
+		return emit(op, at->line, at->column, a, b, c);
 	}
- else if (type == "ExitProcess") {
-		exit(0);
-	}else if (stmt["type"] == "export") {
-	    for (const auto &func : stmt["function"]) {
-	        functionDef def;
 
+	void patch(int at) { chunk.code[at].a = here(); }
 
-	        vector<string> parameterName;
-	        for (const auto &a : func["parameter"]) {  // ✅ เปลี่ยนตรงนี้
-	            parameterName.push_back(a["variable"]["name"]);
-	        }
-	        def.name = func["name"];
-	        def.parameter = parameterName;
-	        def.body = func["body"]["statements"];
-	        exportedFunctions[func["name"]] = def;
-			functionTable[func["name"]] = def;
-	    }
-	    return nullptr;
+	int name(const string &s) {
+		auto it = nameIndex.find(s);
+		if (it != nameIndex.end()) {
+			return it->second;
+		}
+		chunk.names.push_back(s);
+		return nameIndex[s] = static_cast<int>(chunk.names.size()) - 1;
 	}
-	else if (stmt["type"] == "import") {
-	    using namespace std;
-	    namespace fs = std::filesystem;
 
-	    string filename = stmt["file"];
-	    string namespaceName = stmt["name"];
+	int node(const ExecNode *n) {
+		chunk.nodes.push_back(n);
+		return static_cast<int>(chunk.nodes.size()) - 1;
+	}
 
-	    // path ของไฟล์แม่ (กรณี import ซ้อน)
-	    string currentFilePath = stmt.value("__currentFilePath", "");
+	int constant(Value v) {
+		chunk.constants.push_back(std::move(v));
+		return static_cast<int>(chunk.constants.size()) - 1;
+	}
 
-	    fs::path filePath;
-	    fs::path inputPath(filename);
+	// true when running the statement can produce a value (evalStatement
+	// returns one only for calls and for ifs that ran a call)
+	static bool yieldsValue(const ExecNode *s) {
+		if (s->kind == ExecKind::FunctionCall) {
+			return true;
+		}
+		if (s->kind != ExecKind::If) {
+			return false;
+		}
+		const auto &n = static_cast<const ExecIf &>(*s);
+		auto any = [](const vector<ExecNodePtr> &body) {
+			for (const auto &b : body) {
+				if (yieldsValue(b.get())) {
+					return true;
+				}
+			}
+			return false;
+		};
+		if (any(n.then.body) || any(n.elseBody)) {
+			return true;
+		}
+		for (const auto &e : n.elifs) {
+			if (any(e.body)) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-	    if (inputPath.is_absolute()) {
-	        // 1️⃣ ระบุ absolute path → ใช้ตรง ๆ
-	        filePath = inputPath;
-	    }
-	    else if (!currentFilePath.empty()) {
-	        // 2️⃣ import ซ้อน → อิงจากไฟล์แม่
-	        fs::path parentPath = fs::path(currentFilePath).parent_path();
-	        filePath = parentPath / inputPath;
-	    }
-	    else {
-	        // 3️⃣ ไม่ระบุ path → ใช้ <exe>/lib/
-	        fs::path exeDir = getExeDir();
-	        filePath = exeDir / "lib" / inputPath;
-	    }
+	void useValue(Use use, const ExecNode *at) {
+		switch (use) {
+		case Use::Discard:
+			emit(OpCode::Pop, at);
+			break;
+		case Use::FunctionResult:
+			emit(OpCode::SetResult, at);
+			break;
+		case Use::IfBranch:
+			ifExits->push_back(emit(OpCode::JumpIfValue, at));
+			break;
+		}
+	}
 
-	    filePath = fs::absolute(filePath);
+	void block(const vector<ExecNodePtr> &body) {
+		for (const auto &s : body) {
+			statement(s.get(), Use::Discard);
+		}
+	}
 
-	    if (!fs::exists(filePath)) {
-	        cerr << "ไม่พบไฟล์ '" << filePath
-	             << "' ที่บรรทัด " << stmt["line"]
-	             << " คอลัมน์ " << stmt["column"] << "";
-	        exit(1);
-	    }
+	void scope(const ExecNode *at, const vector<ExecNodePtr> &body) {
+		emit(OpCode::PushScope, at);
+		openScopes++;
+		block(body);
+		openScopes--;
+		emit(OpCode::PopScope, at);
+	}
 
-	    ifstream inFile(filePath);
-	    if (!inFile.is_open()) {
-	        cerr << "ไม่สามารถเปิดไฟล์ '" << filePath
-	             << "' ได้ ที่บรรทัด " << stmt["line"]
-	             << " คอลัมน์ " << stmt["column"] << "";
-	        exit(1);
-	    }
+	// The body runs in its own scope; break and continue jump to the
+	// PopScope that closes it (see jump()).
+	void loopBody(const ExecNode *at, const vector<ExecNodePtr> &body) {
+		vector<int> *outerExits = ifExits;
+		ifExits = nullptr;
+		emit(OpCode::PushScope, at);
+		openScopes++;
+		loops.push_back({openScopes});
+		block(body);
+		openScopes--;
+		ifExits = outerExits;
+	}
 
-	    stringstream buffer;
-	    buffer << inFile.rdbuf();
-	    inFile.close();
-
-	    string content = buffer.str();
-	    if (content.empty()) {
-	        cerr << "ไฟล์ '" << filePath
-	             << "' ว่างเปล่า! ที่บรรทัด "
-	             << stmt["line"] << " คอลัมน์ "
-	             << stmt["column"] << "";
-	        exit(1);
-	    }
+	void hoisted(const vector<ExecNodePtr> &temps) {
+		for (const auto &t : temps) {
+			expression(t.get());
+			emit(OpCode::Pop, t.get());
+		}
+	}
 
-	    json importedAST;
-	    try {
-	        importedAST = json::parse(content);
-	    } catch (const json::parse_error& e) {
-	        cerr << "ไฟล์ที่นำเข้าต้องมีสกุลเป็น .json ที่บรรทัด " << stmt["line"] << " คอลัมน์ "
-		             << stmt["column"] << "";
-	        exit(1);
-	    }
+	void closeLoop(int breakTarget, int continueTarget) {
+		Loop &loop = loops.back();
+		for (int at : loop.breaks) {
+			chunk.code[at].a = breakTarget;
+		}
+		for (int at : loop.continues) {
+			chunk.code[at].a = continueTarget;
+		}
+		loops.pop_back();
+	}
 
-	    // ส่ง path ปัจจุบันให้ import ซ้อน
-	    for (auto& innerStmt : importedAST["statements"]) {
-	        innerStmt["__currentFilePath"] = filePath.string();
-	    }
+	// closes blocks opened inside the loop body, then jumps
+	int jump(const ExecNode *at) {
+		for (int i = loops.back().scopes; i < openScopes; i++) {
+			emit(OpCode::PopScope, at);
+		}
+		return emit(OpCode::Jump, at);
+	}
+
+	void ifStatement(const ExecIf &n, bool withValue) {
+		vector<int> ends;
+		vector<int> valueExits;
+		vector<int> *outerExits = ifExits;
+		if (withValue) {
+			ifExits = &valueExits;
+		}
+		auto branch = [&](const vector<ExecNodePtr> &body) {
+			for (const auto &s : body) {
+				statement(s.get(), withValue ? Use::IfBranch : Use::Discard);
+			}
+			if (withValue) {
+				emit(OpCode::NoValue, &n);
+			}
+		};
+
+		expression(n.then.condition.get());
+		int skip = emit(OpCode::JumpIfFalse, n.then.condition.get());
+		branch(n.then.body);
+		ends.push_back(emit(OpCode::Jump, &n));
+		patch(skip);
+		for (const auto &e : n.elifs) {
+			expression(e.condition.get());
+			skip = emit(OpCode::JumpIfFalse, e.condition.get());
+			branch(e.body);
+			ends.push_back(emit(OpCode::Jump, &n));
+			patch(skip);
+		}
+		if (n.hasElse) {
+			branch(n.elseBody);
+		} else if (withValue) {
+			emit(OpCode::NoValue, &n);
+		}
+		for (int at : ends) {
+			patch(at);
+		}
+		for (int at : valueExits) {
+			patch(at);
+		}
+		ifExits = outerExits;
+	}
+
+	void statement(const ExecNode *s, Use use) {
+		switch (s->kind) {
+		case ExecKind::Print: {
+			const auto &n = static_cast<const ExecPrint &>(*s);
+			if (!n.hasList) {
+				break;
+			}
+			for (const auto &e : n.expressions) {
+				expression(e.get());
+				emit(OpCode::Print, s);
+			}
+			return;
+		}
+		case ExecKind::Block:
+			scope(s, static_cast<const ExecBlock &>(*s).statements);
+			return;
+		case ExecKind::If:
+			if (yieldsValue(s)) {
+				ifStatement(static_cast<const ExecIf &>(*s), true);
+				useValue(use, s);
+			} else {
+				ifStatement(static_cast<const ExecIf &>(*s), false);
+			}
+			return;
+		case ExecKind::Assignment: {
+			const auto &n = static_cast<const ExecAssignment &>(*s);
+			const ExecNode *target = n.target.get();
+			if (target->kind == ExecKind::Variable) {
+				expression(n.value.get());
+				emit(OpCode::StoreVar, s,
+					 static_cast<const ExecVariable &>(*target).slot, n.isConst);
+			} else if (target->kind == ExecKind::ObjectAccess) {
+				const auto &access = static_cast<const ExecObjectAccess &>(*target);
+				expression(n.value.get());
+				expression(access.object.get());
+				expression(access.key.get());
+				emit(OpCode::SetField, s);
+			} else if (target->kind == ExecKind::ArrayAccess) {
+				const auto &access = static_cast<const ExecArrayAccess &>(*target);
+				expression(n.value.get());
+				expression(access.array.get());
+				expression(access.index.get());
+				emit(OpCode::SetIndex, s, access.inBounds);
+			} else {
+				break;
+			}
+			return;
+		}
+		case ExecKind::Input:
+			emit(OpCode::Input, s, static_cast<const ExecInput &>(*s).slot);
+			return;
+		case ExecKind::Break:
+			if (!static_cast<const ExecJump &>(*s).inLoop) {
+				break;
+			}
+			loops.back().breaks.push_back(jump(s));
+			return;
+		case ExecKind::Continue:
+			if (!static_cast<const ExecJump &>(*s).inLoop) {
+				break;
+			}
+			loops.back().continues.push_back(jump(s));
+			return;
+		case ExecKind::WhileLoop: {
+			const auto &n = static_cast<const ExecLoop &>(*s);
+			hoisted(n.hoisted);
+			int start = here();
+			expression(n.condition.get());
+			int exit = emit(OpCode::LoopIfFalse, s);
+			loopBody(s, n.body);
+			int next = emit(OpCode::PopScope, s);
+			emit(OpCode::Jump, s, start);
+			int broke = emit(OpCode::PopScope, s);
+			patch(exit);
+			closeLoop(broke, next);
+			return;
+		}
+		case ExecKind::DoWhileLoop: {
+			const auto &n = static_cast<const ExecLoop &>(*s);
+			hoisted(n.hoisted);
+			int start = here();
+			loopBody(s, n.body);
+			int next = emit(OpCode::PopScope, s);
+			expression(n.condition.get());
+			emit(OpCode::LoopIfTrue, s, start);
+			int done = emit(OpCode::Jump, s);
+			int broke = emit(OpCode::PopScope, s);
+			patch(done);
+			closeLoop(broke, next);
+			return;
+		}
+		case ExecKind::ForLoop: {
+			const auto &n = static_cast<const ExecFor &>(*s);
+			int var = n.variable;
+			int slot = slotTop;
+			slotTop += 2;
+			chunk.slotCount = max(chunk.slotCount, slotTop);
+
+			emit(OpCode::PushScope, s);
+			expression(n.init.get());
+			emit(OpCode::StoreVar, s, var, 0);
+			expression(n.stop.get());
+			expression(n.step.get());
+			emit(OpCode::ForPrep, s, slot);
+			hoisted(n.hoisted);
+			int test = emit(OpCode::ForTest, s, 0, slot, var);
+			openScopes++;
+			loopBody(s, n.body);
+			int next = emit(OpCode::PopScope, s);
+			emit(OpCode::ForStep, s, 0, slot, var);
+			emit(OpCode::Jump, s, test);
+			int broke = emit(OpCode::PopScope, s);
+			patch(test);
+			openScopes--;
+			emit(OpCode::PopScope, s);
+			closeLoop(broke, next);
+			slotTop -= 2;
+			return;
+		}
+		case ExecKind::Return: {
+			const auto &n = static_cast<const ExecReturn &>(*s);
+			if (!n.inFunction) {
+				break;
+			}
+			if (n.tailCall) {
+				const auto &call = static_cast<const ExecCall &>(*n.value);
+				for (const auto &arg : call.args) {
+					expression(arg.get());
+				}
+				chunk.calls.push_back(
+					{call.name, call.ns, static_cast<int>(call.args.size())});
+				emit(OpCode::TailCall, &call,
+					 static_cast<int>(chunk.calls.size()) - 1);
+				return;
+			}
+			expression(n.value.get());
+			emit(OpCode::Return, s);
+			return;
+		}
+		case ExecKind::FunctionDeclaration:
+			compileChunk(static_cast<const ExecFunction &>(*s).body, true);
+			emit(OpCode::DefineFunction, s, node(s));
+			return;
+		case ExecKind::Push: {
+			const auto &n = static_cast<const ExecArrayOp &>(*s);
+			expression(n.array.get());
+			expression(n.value.get());
+			emit(OpCode::ArrayPush, s);
+			return;
+		}
+		case ExecKind::Pop:
+			expression(static_cast<const ExecArrayOp &>(*s).array.get());
+			emit(OpCode::ArrayPop, s);
+			return;
+		case ExecKind::Insert: {
+			const auto &n = static_cast<const ExecArrayOp &>(*s);
+			expression(n.array.get());
+			expression(n.index.get());
+			expression(n.value.get());
+			emit(OpCode::ArrayInsert, s);
+			return;
+		}
+		case ExecKind::Erase: {
+			const auto &n = static_cast<const ExecArrayOp &>(*s);
+			expression(n.array.get());
+			expression(n.index.get());
+			emit(OpCode::ArrayErase, s);
+			return;
+		}
+		case ExecKind::ExitProcess:
+			emit(OpCode::Exit, s);
+			return;
+		case ExecKind::Export:
+			for (const auto &f : static_cast<const ExecExport &>(*s).functions) {
+				compileChunk(f->body, true);
+			}
+			emit(OpCode::Export, s, node(s));
+			return;
+		case ExecKind::Import:
+			emit(OpCode::Import, s, node(s));
+			return;
+		case ExecKind::Comment:
+			return;
+		case ExecKind::FunctionCall:
+			expression(s);
+			useValue(use, s);
+			return;
+		default:
+			break;
+		}
+		// malformed or unknown statement: let the tree walker report it
+		emit(OpCode::EvalStatement, s, node(s));
+	}
+
+	// ++/-- store back into the place they were applied to, see evalStep
+	void step(TokenType op, const ExecNode *target) {
+		switch (target->kind) {
+		case ExecKind::Variable:
+			emit(OpCode::StepVar, target,
+				 static_cast<const ExecVariable &>(*target).slot, static_cast<int>(op));
+			return;
+		case ExecKind::ObjectAccess: {
+			const auto &n = static_cast<const ExecObjectAccess &>(*target);
+			expression(n.object.get());
+			if (n.dotKey) {
+				emit(OpCode::StepField, target, name(n.keyName), static_cast<int>(op));
+			} else {
+				expression(n.key.get());
+				emit(OpCode::StepKey, target, 0, static_cast<int>(op));
+			}
+			return;
+		}
+		case ExecKind::ArrayAccess: {
+			const auto &n = static_cast<const ExecArrayAccess &>(*target);
+			expression(n.array.get());
+			expression(n.index.get());
+			emit(OpCode::StepIndex, target, 0, static_cast<int>(op));
+			return;
+		}
+		default:
+			expression(target);
+			emit(OpCode::Unary, target, static_cast<int>(op));
+			return;
+		}
+	}
+
+	void expression(const ExecNode *e) {
+		switch (e->kind) {
+		case ExecKind::Int:
+			emit(OpCode::Constant, e,
+				 constant(Value(static_cast<const ExecInt &>(*e).value)));
+			return;
+		case ExecKind::Float:
+			emit(OpCode::Constant, e,
+				 constant(Value(static_cast<const ExecFloat &>(*e).value)));
+			return;
+		case ExecKind::Bool:
+			emit(OpCode::Constant, e,
+				 constant(Value(static_cast<const ExecBool &>(*e).value)));
+			return;
+		case ExecKind::String:
+			emit(OpCode::Constant, e,
+				 constant(Value(static_cast<const ExecString &>(*e).value)));
+			return;
+		case ExecKind::Null:
+			emit(OpCode::Null, e);
+			return;
+		case ExecKind::Variable:
+			emit(OpCode::LoadVar, e, static_cast<const ExecVariable &>(*e).slot);
+			return;
+		case ExecKind::ArrayLiteral: {
+			const auto &n = static_cast<const ExecArrayLiteral &>(*e);
+			for (const auto &el : n.elements) {
+				expression(el.get());
+			}
+			emit(OpCode::MakeArray, e, static_cast<int>(n.elements.size()));
+			return;
+		}
+		case ExecKind::ObjectLiteral: {
+			const auto &n = static_cast<const ExecObjectLiteral &>(*e);
+			for (const auto &[key, value] : n.properties) {
+				expression(key.get());
+				emit(OpCode::CheckKey, key.get());
+				expression(value.get());
+			}
+			emit(OpCode::MakeObject, e, static_cast<int>(n.properties.size()));
+			return;
+		}
+		case ExecKind::UnaryOp: {
+			const auto &n = static_cast<const ExecUnary &>(*e);
+			if (!n.knownOp) {
+				break;
+			}
+			if (n.op == TokenType::INCREMENT || n.op == TokenType::DECREMENT) {
+				step(n.op, n.operand.get());
+				return;
+			}
+			expression(n.operand.get());
+			emit(OpCode::Unary, e, static_cast<int>(n.op));
+			return;
+		}
+		case ExecKind::Ln:
+			expression(static_cast<const ExecLn &>(*e).value.get());
+			emit(OpCode::Ln, e);
+			return;
+		case ExecKind::BinaryOp: {
+			const auto &n = static_cast<const ExecBinary &>(*e);
+			if (!n.knownOp) {
+				break;
+			}
+			if (n.proven != Value::Type::None) {
+				emit(OpCode::Proven, e, node(e));
+				return;
+			}
+			expression(n.left.get());
+			expression(n.right.get());
+			emit(OpCode::Binary, e, node(e));
+			return;
+		}
+		case ExecKind::Convert: {
+			const auto &n = static_cast<const ExecConvert &>(*e);
+			expression(n.expression.get());
+			emit(OpCode::Convert, e, name(n.target));
+			return;
+		}
+		case ExecKind::ObjectAccess: {
+			const auto &n = static_cast<const ExecObjectAccess &>(*e);
+			expression(n.object.get());
+			if (n.dotKey) {
+				emit(OpCode::GetField, e, name(n.keyName));
+			} else {
+				expression(n.key.get());
+				emit(OpCode::GetKey, e);
+			}
+			return;
+		}
+		case ExecKind::ArrayAccess: {
+			const auto &n = static_cast<const ExecArrayAccess &>(*e);
+			expression(n.array.get());
+			expression(n.index.get());
+			emit(OpCode::GetIndex, e, n.inBounds);
+			return;
+		}
+		case ExecKind::FunctionCall: {
+			const auto &n = static_cast<const ExecCall &>(*e);
+			if (n.badName || n.badNamespace) {
+				break;
+			}
+			for (const auto &arg : n.args) {
+				expression(arg.get());
+			}
+			if (n.inlined) {
+				emit(OpCode::InlineCall, e, node(e));
+				return;
+			}
+			chunk.calls.push_back({n.name, n.ns, static_cast<int>(n.args.size())});
+			emit(OpCode::Call, e, static_cast<int>(chunk.calls.size()) - 1);
+			return;
+		}
+		case ExecKind::Length:
+			expression(static_cast<const ExecLength &>(*e).target.get());
+			emit(OpCode::Length, e);
+			return;
+		case ExecKind::Temp: {
+			const auto &n = static_cast<const ExecTemp &>(*e);
+			if (n.value) {
+				expression(n.value.get());
+				emit(OpCode::Keep, e, n.index);
+			} else {
+				emit(OpCode::Reuse, e, n.index);
+			}
+			return;
+		}
+		default:
+			break;
+		}
+		emit(OpCode::EvalExpr, e, node(e));
+	}
+};
+
+const Chunk &compileChunk(const vector<ExecNodePtr> &body, bool isFunction) {
+	auto &slot = compiledChunks[&body];
+	if (!slot) {
+		slot = make_unique<Chunk>();
+		BytecodeCompiler(*slot).compile(body, isFunction);
+	}
+	return *slot;
+}
+
+vector<Value> vmStack;
+
+// A call saves the caller's registers here and runChunk carries on with the
+// callee's chunk, so .thl recursion in the VM takes heap memory instead of
+// C++ stack and only --max-depth limits it.
+struct CallFrame {
+	const Chunk *chunk;
+	size_t pc;
+	size_t frame;
+	size_t scopes;
+	Value result;
+};
+vector<CallFrame> vmFrames;
+
+Value vmPop() {
+	Value v = std::move(vmStack.back());
+	vmStack.pop_back();
+	return v;
+}
+
+// preset is how many of the chunk's frame slots the caller has already pushed
+Value runChunk(const Chunk &entry, size_t start = 0, size_t preset = 0) {
+	// calls made below this run return here; returning past it leaves runChunk
+	const size_t base = vmFrames.size();
+	const Chunk *chunk = &entry;
+	size_t frame = vmStack.size() - preset;
+	vmStack.resize(frame + chunk->slotCount);
+	// Return closes the scopes this chunk opened, down to what the caller had
+	size_t scopes = scopeStarts.size();
+	Value result = nullptr;
+	size_t pc = start;
+
+	for (;;) {
+		const Instr &in = chunk->code[pc++];
+		switch (in.op) {
+		case OpCode::Constant: {
+			// strings can be changed in place, so each use gets its own
+			const Value &c = chunk->constants[in.a];
+			vmStack.push_back(c.holds<string>() ? Value(c.as<string>()) : c);
+			break;
+		}
+		case OpCode::Null:
+			vmStack.push_back(Value(monostate{}));
+			break;
+		case OpCode::NoValue:
+			vmStack.push_back(nullptr);
+			break;
+		case OpCode::LoadVar:
+			vmStack.push_back(lookvar(in.a, in.line, in.column)->value);
+			break;
+		case OpCode::StoreVar:
+			setvar(in.a, vmPop(), in.line, in.column, in.b != 0);
+			break;
+		case OpCode::Pop:
+			vmStack.pop_back();
+			break;
+		case OpCode::MakeArray: {
+			ValueHolder::ArraY arr(make_move_iterator(vmStack.end() - in.a),
+								   make_move_iterator(vmStack.end()));
+			vmStack.resize(vmStack.size() - in.a);
+			vmStack.push_back(Value(std::move(arr)));
+			break;
+		}
+		case OpCode::CheckKey:
+			literalKeyOf(vmStack.back(), in.line, in.column);
+			break;
+		case OpCode::MakeObject: {
+			ValueHolder::ObjecT obj;
+			for (auto it = vmStack.end() - 2 * in.a; it != vmStack.end(); it += 2) {
+				obj[it->as<string>()] = *(it + 1);
+			}
+			vmStack.resize(vmStack.size() - 2 * in.a);
+			vmStack.push_back(Value(std::move(obj)));
+			break;
+		}
+		case OpCode::Unary: {
+			Value operand = vmPop();
+			vmStack.push_back(applyUnary(static_cast<TokenType>(in.a), operand,
+										 in.line, in.column));
+			break;
+		}
+		case OpCode::StepVar:
+			vmStack.push_back(stepValue(static_cast<TokenType>(in.b),
+										lookvar(in.a, in.line, in.column)->value,
+										in.line, in.column));
+			break;
+		case OpCode::StepField:
+			vmStack.back() = stepValue(
+				static_cast<TokenType>(in.b),
+				objectField(vmStack.back(), chunk->names[in.a], in.line, in.column),
+				in.line, in.column);
+			break;
+		case OpCode::StepKey: {
+			string key = objectKeyOf(vmPop(), in.line, in.column);
+			vmStack.back() = stepValue(
+				static_cast<TokenType>(in.b),
+				objectField(vmStack.back(), key, in.line, in.column), in.line,
+				in.column);
+			break;
+		}
+		case OpCode::StepIndex: {
+			Value index = vmPop();
+			vmStack.back() = stepIndexed(static_cast<TokenType>(in.b),
+										 vmStack.back(), index, in.line, in.column);
+			break;
+		}
+		case OpCode::Binary: {
+			Value right = vmPop();
+			Value left = vmPop();
+			vmStack.push_back(evalBinary(
+				static_cast<const ExecBinary &>(*chunk->nodes[in.a]), left, right));
+			break;
+		}
+		case OpCode::Proven:
+			vmStack.push_back(
+				evalProven(static_cast<const ExecBinary &>(*chunk->nodes[in.a])));
+			break;
+		case OpCode::Ln:
+			vmStack.back() = naturalLog(vmStack.back(), in.line, in.column);
+			break;
+		case OpCode::Convert:
+			vmStack.back() = convertValue(chunk->names[in.a], vmStack.back(),
+										  in.line, in.column);
+			break;
+		case OpCode::GetField:
+			vmStack.back() = getObjectField(vmStack.back(), chunk->names[in.a],
+											in.line, in.column);
+			break;
+		case OpCode::GetKey: {
+			string key = objectKeyOf(vmPop(), in.line, in.column);
+			vmStack.back() = getObjectField(vmStack.back(), key, in.line, in.column);
+			break;
+		}
+		case OpCode::GetIndex: {
+			Value index = vmPop();
+			if (in.a) {
+				vmStack.back() = getInBounds(vmStack.back(), index, in.line, in.column);
+			} else {
+				vmStack.back() = getIndexed(vmStack.back(), index, in.line, in.column);
+			}
+			break;
+		}
+		case OpCode::Length:
+			vmStack.back() = lengthOf(vmStack.back(), in.line, in.column);
+			break;
+		case OpCode::Keep:
+			temps[in.a] = vmStack.back();
+			break;
+		case OpCode::Reuse:
+			vmStack.push_back(temps[in.a]);
+			break;
+		case OpCode::Call: {
+			const CallSite &site = chunk->calls[in.a];
+			const functionDef &def = resolveCall(site.cache, site.ns, site.name,
+												 site.argc, in.line, in.column);
+			enterCall(in.line, in.column);
+			vmFrames.push_back({chunk, pc, frame, scopes, std::move(result)});
+			// Create new scope and bind the arguments on top of vmStack
+			pushScope();
+			bindParameters(def.parameter, vmStack, site.argc);
+			chunk = &compileChunk(*def.body, true);
+			frame = vmStack.size();
+			vmStack.resize(frame + chunk->slotCount);
+			scopes = scopeStarts.size();
+			result = nullptr;
+			pc = 0;
+			break;
+		}
+		case OpCode::InlineCall: {
+			Value ret = callInlined(
+				static_cast<const ExecCall &>(*chunk->nodes[in.a]), vmStack);
+			vmStack.push_back(std::move(ret));
+			break;
+		}
+		case OpCode::Print:
+			printValue(vmPop());
+			break;
+		case OpCode::Jump:
+			pc = in.a;
+			break;
+		case OpCode::JumpIfFalse:
+			if (!vmPop().as<bool>()) {
+				pc = in.a;
+			}
+			break;
+		case OpCode::LoopIfFalse:
+			if (!getBool(vmPop())) {
+				pc = in.a;
+			}
+			break;
+		case OpCode::LoopIfTrue:
+			if (getBool(vmPop())) {
+				pc = in.a;
+			}
+			break;
+		case OpCode::JumpIfValue:
+			if (vmStack.back()) {
+				pc = in.a;
+			} else {
+				vmStack.pop_back();
+			}
+			break;
+		case OpCode::SetResult: {
+			Value v = vmPop();
+			if (v) {
+				result = std::move(v);
+			}
+			break;
+		}
+		case OpCode::Return:
+		case OpCode::End: {
+			Value v = in.op == OpCode::Return ? vmPop() : std::move(result);
+			while (scopeStarts.size() > scopes) {
+				popScope();
+			}
+			vmStack.resize(frame);
+			if (vmFrames.size() == base) {
+				return v;
+			}
+			// back in the caller: close the function's scope, push its value
+			popScope();
+			callDepth--;
+			CallFrame &caller = vmFrames.back();
+			chunk = caller.chunk;
+			pc = caller.pc;
+			frame = caller.frame;
+			scopes = caller.scopes;
+			result = std::move(caller.result);
+			vmFrames.pop_back();
+			vmStack.push_back(std::move(v));
+			break;
+		}
+		case OpCode::TailCall: {
+			const CallSite &site = chunk->calls[in.a];
+			const functionDef &def = resolveCall(site.cache, site.ns, site.name,
+												 site.argc, in.line, in.column);
+			// the callee runs in this frame, in the function's scope with
+			// every scope this chunk still has open merged into it
+			scopeStarts.resize(scopes);
+			bindParameters(def.parameter, vmStack, site.argc);
+			chunk = &compileChunk(*def.body, true);
+			vmStack.resize(frame + chunk->slotCount);
+			result = nullptr;
+			pc = 0;
+			break;
+		}
+		case OpCode::PushScope:
+			pushScope();
+			break;
+		case OpCode::PopScope:
+			popScope();
+			break;
+		case OpCode::ForPrep: {
+			Value step = vmPop();
+			vmStack[frame + in.a] = vmPop();
+			vmStack[frame + in.a + 1] =
+				forLoopStep(step, in.line, in.column);
+			break;
+		}
+		case OpCode::ForTest: {
+			const Value &stop = vmStack[frame + in.b];
+			const Value &step = vmStack[frame + in.b + 1];
+			if (!forLoopContinues(in.c, stop, step, in.line,
+								  in.column)) {
+				pc = in.a;
+			}
+			break;
+		}
+		case OpCode::ForStep:
+			forLoopAdvance(in.c, vmStack[frame + in.b + 1], in.line,
+						   in.column);
+			break;
+		case OpCode::SetField: {
+			Value key = vmPop();
+			Value obj = vmPop();
+			assignField(obj, key, vmPop(), in.line, in.column);
+			break;
+		}
+		case OpCode::SetIndex: {
+			Value index = vmPop();
+			Value arr = vmPop();
+			if (in.a) {
+				assignInBounds(arr, index, vmPop(), in.line, in.column);
+			} else {
+				assignIndex(arr, index, vmPop(), in.line, in.column);
+			}
+			break;
+		}
+		case OpCode::ArrayPush: {
+			Value value = vmPop();
+			pushItem(vmPop(), value, in.line, in.column);
+			break;
+		}
+		case OpCode::ArrayPop:
+			popItem(vmPop(), in.line, in.column);
+			break;
+		case OpCode::ArrayInsert: {
+			Value value = vmPop();
+			Value index = vmPop();
+			insertItem(vmPop(), index, value, in.line, in.column);
+			break;
+		}
+		case OpCode::ArrayErase: {
+			Value index = vmPop();
+			eraseItem(vmPop(), index, in.line, in.column);
+			break;
+		}
+		case OpCode::Input: {
+			string line;
+			getline(cin, line);
+			setvar(in.a, Value(line), in.line,
+				   in.column, false);
+			break;
+		}
+		case OpCode::DefineFunction: {
+			const auto &decl = static_cast<const ExecFunction &>(*chunk->nodes[in.a]);
+			functionTable[decl.name] = makeFunctionDef(decl);
+			break;
+		}
+		case OpCode::Export:
+			exportFunctions(static_cast<const ExecExport &>(*chunk->nodes[in.a]));
+			break;
+		case OpCode::Import:
+			importModule(static_cast<const ExecImport &>(*chunk->nodes[in.a]));
+			break;
+		case OpCode::EvalStatement:
+			evalStatement(chunk->nodes[in.a]);
+			break;
+		case OpCode::Exit:
+			exit(0);
+		case OpCode::EvalExpr:
+			vmStack.push_back(evalExpr(chunk->nodes[in.a]));
+			break;
+		}
+	}
+}
+
+// C++ output
+//
+// mmt <file>.thl <target>.cpp lowers the program as if to run it and writes
+// it out as C++. Each โปรแกรม becomes a C++ function and each statement the
+// helper calls evalExpr/evalStatement would make, in the same order, so the
+// built program prints what the interpreter prints and fails with the same
+// messages. It is built against runtime.h and linked with runtime.cpp.
+// Modules it imports are still read from <exe>/lib when the program runs and
+// run by the tree walker, so a program with นำเข้า links compiler.cpp too;
+// calls between the two go through functionTable as usual.
+
+class CppEmitter {
+public:
+	string emit(const ExecProgram &program, const string &source) {
+		depth = 2;
+		statements(program.statements);
+		string mainBody = std::move(code);
+
+		// function bodies can declare more functions
+		string bodies;
+		for (size_t i = 0; i < functions.size(); i++) {
+			bodies += function(*functions[i], static_cast<int>(i) + 1);
+		}
+
+		string out = "// Generated by mmt from " + source + ". Build it with the mmt\n"
+					 "// runtime:\n"
+					 "//   g++ -std=c++17 -O2 -I<mmt dir> <this file> <mmt dir>/runtime.cpp\n";
+		if (imports) {
+			out += "// It imports modules, which the interpreter runs, so add\n"
+				   "//   -DMMT_RUNTIME <mmt dir>/compiler.cpp\n";
+		}
+		out += "#include \"runtime.h\"\n"
+			   "#ifdef _WIN32\n"
+			   "#include <windows.h>\n"
+			   "#endif\n\n";
+		// registered in the order lowering gave them their slots
+		out += "const vector<string> slotNames = {";
+		for (size_t i = 0; i < variableNames.size(); i++) {
+			out += (i % 8 == 0 ? "\n\t" : " ") + quote(variableNames[i]) + ",";
+		}
+		out += "\n};\n\n" + sites;
+		if (!functions.empty()) {
+			out += "\n";
+			for (size_t i = 0; i < functions.size(); i++) {
+				out += "Completion fn_" + to_string(i + 1) + "(); // " +
+					   functions[i]->name + "\n";
+			}
+		}
+		out += bodies;
+		out += "\nint main() {\n"
+			   "\tios::sync_with_stdio(false);\n"
+			   "\tcout.tie(nullptr);\n"
+			   "#ifdef _WIN32\n"
+			   "\tSetConsoleOutputCP(65001);\n"
+			   "#endif\n"
+			   "\tfor (const string &name : slotNames) {\n"
+			   "\t\tvariableSlot(name);\n"
+			   "\t}\n"
+			   "\ttry {\n"
+			   "\t\tpushScope();\n" +
+			   mainBody +
+			   "\t\tpopScope();\n"
+			   "\t} catch (const exception &e) {\n"
+			   "\t\tcerr << \"\\nCompilation failed: \" << e.what() << \"\";\n"
+			   "\t\treturn 1;\n"
+			   "\t}\n"
+			   "\treturn 0;\n"
+			   "}\n";
+		return out;
+	}
+
+private:
+	// What becomes of the value of a statement that has one: dropped in a
+	// loop, block or the program, kept as the function's result, or ending
+	// the if branch it is in (see evalBranch).
+	enum class Use : uint8_t { Drop, Result, Branch };
+	struct If {
+		string id;
+		bool ended = false; // something jumps to its end
+	};
+	struct Loop {
+		string id;
+		size_t scopes; // open outside the loop body
+		bool broken = false;
+		bool continued = false;
+	};
+
+	string code; // the function being written
+	string sites;
+	int depth = 1;
+	int names = 0;
+	size_t openScopes = 0; // pushScope()s since the function began
+	Use use = Use::Drop;
+	If *branch = nullptr;
+	vector<Loop> loops;
+	vector<const ExecFunction *> functions;
+	unordered_map<const ExecFunction *, int> functionIds;
+	bool imports = false;
+
+	static string quote(const string &s) {
+		string q = "\"";
+		for (unsigned char c : s) {
+			if (c == '"' || c == '\\') {
+				q += '\\';
+				q += static_cast<char>(c);
+			} else if (c < 0x20 || c == 0x7f) {
+				char esc[8];
+				snprintf(esc, sizeof esc, "\\%03o", c);
+				q += esc;
+			} else {
+				q += static_cast<char>(c);
+			}
+		}
+		return q + "\"";
+	}
+	static string where(const ExecNode *node) {
+		return to_string(node->line) + ", " + to_string(node->column);
+	}
+	static string moved(const string &value) {
+		return value[0] == 't' ? "std::move(" + value + ")" : value;
+	}
+
+	void line(const string &text) {
+		code.append(depth, '\t');
+		code += text;
+		code += '\n';
+	}
+	string fresh(const char *prefix) { return prefix + to_string(++names); }
+	void fail(const string &message) {
+		line("cerr << " + quote(message) + ";");
+		line("exit(1);");
+	}
+
+	int functionId(const ExecFunction &decl) {
+		auto [it, added] = functionIds.emplace(&decl, static_cast<int>(functions.size()) + 1);
+		if (added) {
+			functions.push_back(&decl);
+		}
+		return it->second;
+	}
+	string functionDefOf(const ExecFunction &decl) {
+		string params;
+		for (int slot : decl.parameters) {
+			params += (params.empty() ? "" : ", ") + to_string(slot);
+		}
+		return "nativeFunctionDef(" + quote(decl.name) + ", {" + params +
+			   "}, fn_" + to_string(functionId(decl)) + ")";
+	}
+
+	string function(const ExecFunction &decl, int id) {
+		string outer = std::move(code);
+		code.clear();
+		depth = 1;
+		openScopes = 0;
+		use = Use::Result;
+		branch = nullptr;
+		code = "\n// โปรแกรม " + decl.name + "\nCompletion fn_" + to_string(id) + "() {\n";
+		line("Value result = nullptr;");
+		statements(decl.body);
+		line("return result;");
+		code += "}\n";
+		string text = std::move(code);
+		code = std::move(outer);
+		return text;
+	}
+
+	// Values are held in locals so operands are evaluated in source order.
+	// Literals, which cannot fail, are written in place.
+	string expr(const ExecNode *node) {
+		const string at = where(node);
+		string t;
+		switch (node->kind) {
+		case ExecKind::Invalid:
+			fail("❌ expr ไม่ใช่ json object แต่เป็น: " +
+				 static_cast<const ExecInvalid *>(node)->text);
+			return "Value()";
+		case ExecKind::Int: {
+			int v = static_cast<const ExecInt *>(node)->value;
+			return v == INT_MIN ? "Value(INT_MIN)" : "Value(" + to_string(v) + ")";
+		}
+		case ExecKind::Float: {
+			char hex[64];
+			snprintf(hex, sizeof hex, "%a", static_cast<const ExecFloat *>(node)->value);
+			return string("Value(") + hex + ")";
+		}
+		case ExecKind::Bool:
+			return static_cast<const ExecBool *>(node)->value ? "Value(true)" : "Value(false)";
+		case ExecKind::String: {
+			const string &s = static_cast<const ExecString *>(node)->value;
+			return "Value(string(" + quote(s) + ", " + to_string(s.size()) + "))";
+		}
+		case ExecKind::Null:
+			return "Value(monostate{})";
+		case ExecKind::Variable:
+			t = fresh("t");
+			line("Value " + t + " = lookvar(" +
+				 to_string(static_cast<const ExecVariable *>(node)->slot) + ", " + at +
+				 ")->value;");
+			return t;
+		case ExecKind::ArrayLiteral: {
+			string arr = fresh("a");
+			line("ValueHolder::ArraY " + arr + ";");
+			for (const auto &e : static_cast<const ExecArrayLiteral *>(node)->elements) {
+				string v = expr(e.get());
+				line(arr + ".push_back(" + moved(v) + ");");
+			}
+			t = fresh("t");
+			line("Value " + t + "(std::move(" + arr + "));");
+			return t;
+		}
+		case ExecKind::ObjectLiteral: {
+			string obj = fresh("o");
+			line("ValueHolder::ObjecT " + obj + ";");
+			for (const auto &[keyNode, valueNode] :
+				 static_cast<const ExecObjectLiteral *>(node)->properties) {
+				string k = expr(keyNode.get());
+				string key = fresh("k");
+				line("string " + key + " = literalKeyOf(" + k + ", " +
+					 where(keyNode.get()) + ");");
+				string v = expr(valueNode.get());
+				line(obj + "[" + key + "] = " + moved(v) + ";");
+			}
+			t = fresh("t");
+			line("Value " + t + "(std::move(" + obj + "));");
+			return t;
+		}
+		case ExecKind::UnaryOp: {
+			const auto &e = static_cast<const ExecUnary &>(*node);
+			if (e.knownOp &&
+				(e.op == TokenType::INCREMENT || e.op == TokenType::DECREMENT)) {
+				return step(e.op, e.operand.get());
+			}
+			string v = expr(e.operand.get());
+			if (!e.knownOp) {
+				line("unknownExpression(" + at + ");");
+				return "Value()";
+			}
+			t = fresh("t");
+			line("Value " + t + " = applyUnary(TokenType::" + tokenTypeName(e.op) +
+				 ", " + v + ", " + at + ");");
+			return t;
+		}
+		case ExecKind::Ln: {
+			string v = expr(static_cast<const ExecLn *>(node)->value.get());
+			t = fresh("t");
+			line("Value " + t + " = naturalLog(" + v + ", " + at + ");");
+			return t;
+		}
+		case ExecKind::BinaryOp: {
+			const auto &e = static_cast<const ExecBinary &>(*node);
+			string l = expr(e.left.get());
+			string r = expr(e.right.get());
+			if (!e.knownOp) {
+				line("unknownExpression(" + at + ");");
+				return "Value()";
+			}
+			t = fresh("t");
+			line("Value " + t + " = nativeBinary<TokenType::" + tokenTypeName(e.op) +
+				 ">(" + l + ", " + r + ", " + at + ");");
+			return t;
+		}
+		case ExecKind::Convert: {
+			const auto &e = static_cast<const ExecConvert &>(*node);
+			string v = expr(e.expression.get());
+			t = fresh("t");
+			line("Value " + t + " = convertValue(" + quote(e.target) + ", " + v +
+				 ", " + at + ");");
+			return t;
+		}
+		case ExecKind::ObjectAccess: {
+			const auto &e = static_cast<const ExecObjectAccess &>(*node);
+			string obj = expr(e.object.get());
+			string key = e.dotKey ? quote(e.keyName)
+								  : "objectKeyOf(" + expr(e.key.get()) + ", " + at + ")";
+			t = fresh("t");
+			line("Value " + t + " = getObjectField(" + obj + ", " + key + ", " + at +
+				 ");");
+			return t;
+		}
+		case ExecKind::ArrayAccess: {
+			const auto &e = static_cast<const ExecArrayAccess &>(*node);
+			string arr = expr(e.array.get());
+			string index = expr(e.index.get());
+			t = fresh("t");
+			line("Value " + t + " = getIndexed(" + arr + ", " + index + ", " + at +
+				 ");");
+			return t;
+		}
+		case ExecKind::FunctionCall: {
+			string site = call(static_cast<const ExecCall &>(*node));
+			if (site.empty()) {
+				return "Value()";
+			}
+			t = fresh("t");
+			line("Value " + t + " = nativeCall(" + site + ", " + at + ");");
+			return t;
+		}
+		case ExecKind::Length: {
+			string v = expr(static_cast<const ExecLength *>(node)->target.get());
+			t = fresh("t");
+			line("Value " + t + " = lengthOf(" + v + ", " + at + ");");
+			return t;
+		}
+		default:
+			line("unknownExpression(" + at + ");");
+			return "Value()";
+		}
+	}
+
+	// ++/-- on a variable, element or field; see evalStep
+	string step(TokenType op, const ExecNode *target) {
+		const string at = where(target);
+		const string kind = "TokenType::" + tokenTypeName(op);
+		string place;
+		switch (target->kind) {
+		case ExecKind::Variable:
+			place = "lookvar(" + to_string(static_cast<const ExecVariable *>(target)->slot) +
+					", " + at + ")->value";
+			break;
+		case ExecKind::ObjectAccess: {
+			const auto &access = static_cast<const ExecObjectAccess &>(*target);
+			string obj = expr(access.object.get());
+			string key = access.dotKey
+							 ? quote(access.keyName)
+							 : "objectKeyOf(" + expr(access.key.get()) + ", " + at + ")";
+			place = "objectField(" + obj + ", " + key + ", " + at + ")";
+			break;
+		}
+		case ExecKind::ArrayAccess: {
+			const auto &access = static_cast<const ExecArrayAccess &>(*target);
+			string arr = expr(access.array.get());
+			string index = expr(access.index.get());
+			string t = fresh("t");
+			line("Value " + t + " = stepIndexed(" + kind + ", " + arr + ", " + index +
+				 ", " + at + ");");
+			return t;
+		}
+		default: {
+			string v = expr(target);
+			string t = fresh("t");
+			line("Value " + t + " = applyUnary(" + kind + ", " + v + ", " + at + ");");
+			return t;
+		}
+		}
+		string t = fresh("t");
+		line("Value " + t + " = stepValue(" + kind + ", " + place + ", " + at + ");");
+		return t;
+	}
+
+	// Pushes the arguments and returns the call site, or "" when the call
+	// fails before that.
+	string call(const ExecCall &node) {
+		if (node.badName) {
+			fail("ชื่อโปรแกรมไม่ถูกต้อง (ต้องเป็นตัวแปร) ที่บรรทัด " + to_string(node.line) +
+				 " คอลัมน์ " + to_string(node.column));
+			return "";
+		}
+		if (node.badNamespace) {
+			fail("Namespace ต้องเป็นตัวแปร ที่บรรทัด " + to_string(node.line) +
+				 " คอลัมน์ " + to_string(node.column));
+			return "";
+		}
+		for (const auto &arg : node.args) {
+			string v = expr(arg.get());
+			line("callArgs.push_back(" + moved(v) + ");");
+		}
+		string site = fresh("site_");
+		sites += "CallSite " + site + "{" + quote(node.name) + ", " + quote(node.ns) +
+				 ", " + to_string(node.args.size()) + "};\n";
+		return site;
+	}
+
+	// the value of a call statement or an if
+	void produce(const string &value) {
+		if (use == Use::Result) {
+			line("if (" + value + ") result = std::move(" + value + ");");
+		} else if (use == Use::Branch) {
+			line("if (" + value + ") {");
+			line("\tifv" + branch->id + " = std::move(" + value + ");");
+			line("\tgoto end" + branch->id + ";");
+			line("}");
+			branch->ended = true;
+		}
+	}
+
+	void statements(const vector<ExecNodePtr> &body) {
+		for (const auto &s : body) {
+			statement(s.get());
+		}
+	}
 
-	    evalProgram(importedAST);
-	    importModules[namespaceName] = exportedFunctions;
-	    exportedFunctions.clear();
+	// A scope of its own, as in evalScoped
+	void scoped(const vector<ExecNodePtr> &body) {
+		Use outer = use;
+		use = Use::Drop;
+		line("pushScope();");
+		openScopes++;
+		line("{");
+		depth++;
+		statements(body);
+		depth--;
+		line("}");
+		openScopes--;
+		line("popScope();");
+		use = outer;
+	}
+
+	void loopBody(const vector<ExecNodePtr> &body, Loop &loop) {
+		loops.push_back(loop);
+		scoped(body);
+		loop = loops.back();
+		loops.pop_back();
+		if (loop.continued) {
+			line("cont" + loop.id + ":;");
+		}
+	}
+
+	void jump(const ExecNode *stmt, bool isBreak) {
+		if (!static_cast<const ExecJump *>(stmt)->inLoop) {
+			line(string("misplacedStatement(\"") + (isBreak ? "ออก" : "ถัดไป") +
+				 "\", \"ลูป\", " + where(stmt) + ");");
+			return;
+		}
+		Loop &loop = loops.back();
+		for (size_t i = loop.scopes; i < openScopes; i++) {
+			line("popScope();");
+		}
+		if (isBreak) {
+			loop.broken = true;
+			line("goto brk" + loop.id + ";");
+		} else {
+			loop.continued = true;
+			line("goto cont" + loop.id + ";");
+		}
+	}
+
+	void ifChain(const ExecIf &stmt, If &self, size_t k) {
+		const ExecBranch &b = k == 0 ? stmt.then : stmt.elifs[k - 1];
+		string c = expr(b.condition.get());
+		line("if (" + c + ".as<bool>()) {");
+		branchBody(b.body, self);
+		if (k < stmt.elifs.size()) {
+			line("} else {");
+			depth++;
+			ifChain(stmt, self, k + 1);
+			depth--;
+		} else if (stmt.hasElse) {
+			line("} else {");
+			branchBody(stmt.elseBody, self);
+		}
+		line("}");
+	}
+
+	void branchBody(const vector<ExecNodePtr> &body, If &self) {
+		Use outerUse = use;
+		If *outerBranch = branch;
+		use = Use::Branch;
+		branch = &self;
+		depth++;
+		statements(body);
+		depth--;
+		use = outerUse;
+		branch = outerBranch;
+	}
+
+	void statement(const ExecNode *stmt) {
+		const string at = where(stmt);
+		switch (stmt->kind) {
+		case ExecKind::Invalid:
+			fail("❌ stmt ไม่ใช่ json object แต่เป็น: " +
+				 static_cast<const ExecInvalid *>(stmt)->text);
+			return;
+		case ExecKind::Print: {
+			const auto &print = static_cast<const ExecPrint &>(*stmt);
+			if (!print.hasList) {
+				fail(" print ต้องการ array ของ expressions\n");
+				return;
+			}
+			for (const auto &e : print.expressions) {
+				line("printValue(" + expr(e.get()) + ");");
+			}
+			return;
+		}
+		case ExecKind::Block:
+			scoped(static_cast<const ExecBlock *>(stmt)->statements);
+			return;
+		case ExecKind::If: {
+			If self{to_string(++names)};
+			line("{");
+			depth++;
+			size_t declaration = code.size();
+			ifChain(static_cast<const ExecIf &>(*stmt), self, 0);
+			if (self.ended) {
+				code.insert(declaration, string(depth, '\t') + "Value ifv" + self.id + ";\n");
+				line("end" + self.id + ":;");
+				produce("ifv" + self.id);
+			}
+			depth--;
+			line("}");
+			return;
+		}
+		case ExecKind::Assignment: {
+			const auto &assign = static_cast<const ExecAssignment &>(*stmt);
+			const ExecNode *target = assign.target.get();
+			string v = expr(assign.value.get());
+			if (target->kind == ExecKind::Variable) {
+				line("setvar(" + to_string(static_cast<const ExecVariable *>(target)->slot) +
+					 ", " + moved(v) + ", " + at + ", " +
+					 (assign.isConst ? "true" : "false") + ");");
+			} else if (target->kind == ExecKind::ObjectAccess) {
+				const auto &access = static_cast<const ExecObjectAccess &>(*target);
+				string obj = expr(access.object.get());
+				string key = expr(access.key.get());
+				line("assignField(" + obj + ", " + key + ", " + v + ", " + at + ");");
+			} else if (target->kind == ExecKind::ArrayAccess) {
+				const auto &access = static_cast<const ExecArrayAccess &>(*target);
+				string arr = expr(access.array.get());
+				string index = expr(access.index.get());
+				line("assignIndex(" + arr + ", " + index + ", " + v + ", " + at + ");");
+			} else {
+				fail("ไม่สามารถกำหนดค่าสิ่งนี้ได้ ที่บรรทัด " + to_string(stmt->line) +
+					 " คอลัมน์ " + to_string(stmt->column));
+			}
+			return;
+		}
+		case ExecKind::Input: {
+			string in = fresh("in");
+			line("string " + in + ";");
+			line("getline(cin, " + in + ");");
+			line("setvar(" + to_string(static_cast<const ExecInput *>(stmt)->slot) +
+				 ", Value(" + in + "), " + at + ", false);");
+			return;
+		}
+		case ExecKind::Break:
+		case ExecKind::Continue:
+			jump(stmt, stmt->kind == ExecKind::Break);
+			return;
+		case ExecKind::WhileLoop:
+		case ExecKind::DoWhileLoop: {
+			const auto &loop = static_cast<const ExecLoop &>(*stmt);
+			Loop self{to_string(++names), openScopes};
+			line("for (;;) {");
+			depth++;
+			if (stmt->kind == ExecKind::WhileLoop) {
+				line("if (!getBool(" + expr(loop.condition.get()) + ")) break;");
+				loopBody(loop.body, self);
+			} else {
+				loopBody(loop.body, self);
+				line("if (!getBool(" + expr(loop.condition.get()) + ")) break;");
+			}
+			depth--;
+			line("}");
+			if (self.broken) {
+				line("brk" + self.id + ":;");
+			}
+			return;
+		}
+		case ExecKind::ForLoop: {
+			const auto &loop = static_cast<const ExecFor &>(*stmt);
+			const string slot = to_string(loop.variable);
+			line("{");
+			depth++;
+			line("pushScope();");
+			openScopes++;
+			Loop self{to_string(++names), openScopes};
+			line("setvar(" + slot + ", " + moved(expr(loop.init.get())) + ", " + at +
+				 ", false);");
+			string stop = "stop" + self.id;
+			line("Value " + stop + " = " + moved(expr(loop.stop.get())) + ";");
+			string stepVal = "step" + self.id;
+			line("Value " + stepVal + " = forLoopStep(" + expr(loop.step.get()) + ", " +
+				 at + ");");
+			line("while (forLoopContinues(" + slot + ", " + stop + ", " + stepVal + ", " +
+				 at + ")) {");
+			depth++;
+			loopBody(loop.body, self);
+			line("forLoopAdvance(" + slot + ", " + stepVal + ", " + at + ");");
+			depth--;
+			line("}");
+			if (self.broken) {
+				line("brk" + self.id + ":;");
+			}
+			openScopes--;
+			line("popScope();");
+			depth--;
+			line("}");
+			return;
+		}
+		case ExecKind::Return: {
+			const auto &ret = static_cast<const ExecReturn &>(*stmt);
+			if (ret.tailCall) {
+				const auto &target = static_cast<const ExecCall &>(*ret.value);
+				line("return nativeTailCall(" + call(target) + ", " + where(&target) + ");");
+				return;
+			}
+			string v = expr(ret.value.get());
+			if (!ret.inFunction) {
+				line("misplacedStatement(\"คืนค่า\", \"โปรแกรม\", " + at + ");");
+				return;
+			}
+			line("return {Flow::Return, " + moved(v) + "};");
+			return;
+		}
+		case ExecKind::FunctionDeclaration: {
+			const auto &decl = static_cast<const ExecFunction &>(*stmt);
+			line("functionTable[" + quote(decl.name) + "] = " + functionDefOf(decl) + ";");
+			return;
+		}
+		case ExecKind::Push: {
+			const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+			string arr = expr(op.array.get());
+			string v = expr(op.value.get());
+			line("pushItem(" + arr + ", " + v + ", " + at + ");");
+			return;
+		}
+		case ExecKind::Pop: {
+			const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+			line("popItem(" + expr(op.array.get()) + ", " + at + ");");
+			return;
+		}
+		case ExecKind::Insert: {
+			const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+			string arr = expr(op.array.get());
+			string index = expr(op.index.get());
+			string v = expr(op.value.get());
+			line("insertItem(" + arr + ", " + index + ", " + v + ", " + at + ");");
+			return;
+		}
+		case ExecKind::Erase: {
+			const auto &op = static_cast<const ExecArrayOp &>(*stmt);
+			string arr = expr(op.array.get());
+			string index = expr(op.index.get());
+			line("eraseItem(" + arr + ", " + index + ", " + at + ");");
+			return;
+		}
+		case ExecKind::ExitProcess:
+			line("exit(0);");
+			return;
+		case ExecKind::Export:
+			for (const auto &func : static_cast<const ExecExport &>(*stmt).functions) {
+				string def = fresh("def");
+				line("functionDef " + def + " = " + functionDefOf(*func) + ";");
+				line("exportedFunctions[" + quote(func->name) + "] = " + def + ";");
+				line("functionTable[" + quote(func->name) + "] = " + def + ";");
+			}
+			return;
+		case ExecKind::Import: {
+			const auto &import = static_cast<const ExecImport &>(*stmt);
+			imports = true;
+			line("importModule(" + quote(import.file) + ", " + quote(import.name) + ", " +
+				 quote(import.currentFilePath) + ", " + at + ");");
+			return;
+		}
+		case ExecKind::Comment:
+			return;
+		case ExecKind::FunctionCall: {
+			string site = call(static_cast<const ExecCall &>(*stmt));
+			if (site.empty()) {
+				return;
+			}
+			if (use == Use::Drop) {
+				line("nativeCall(" + site + ", " + at + ");");
+				return;
+			}
+			string t = fresh("t");
+			line("Value " + t + " = nativeCall(" + site + ", " + at + ");");
+			produce(t);
+			return;
+		}
+		default:
+			fail("ไม่รู้จักคำสั่งประเภทนี้  ที่บรรทัด " + to_string(stmt->line) + " คอลัมน์ " +
+				 to_string(stmt->column));
+			return;
+		}
+	}
+};
 
-	    return nullptr;
+string emitCpp(const ASTNodePtr &programAST, const string &source) {
+	ExecNodePtr lowered = lowerNode(programAST);
+	if (lowered->kind != ExecKind::Program) {
+		cerr << "AST ที่ส่งเข้า evalProgram ต้องเป็น Program node\n";
+		exit(1);
 	}
+	auto &program = static_cast<ExecProgram &>(*lowered);
+	if (runOptions.optLevel >= 1) {
+		foldProgram(program, true);
+	}
+	return CppEmitter().emit(program, source);
+}
 
+// On-stack replacement
+//
+// With --osr (or --jit; see jitLoop) the tree walker counts each loop's back
+// edges. Once a loop reaches osrThreshold it is compiled on its own and the
+// iteration after the current one runs in the VM, which keeps the loop to its
+// end, along with whatever it calls. Both engines keep variables and scopes
+// in the same slots, so nothing has to be copied over but a for loop's stop
+// and step. Later runs of the same loop switch at their first back edge.
 
+vector<unique_ptr<Chunk>> loopChunks;
 
-else if(type == "Comment"){
-		return nullptr;
-	}else if (type == "FunctionCall") {
-        return evalExpr(stmt);  // คืนค่าที่ evalExpr คืนกลับมาเลย
-    }
+bool hotLoop(const ExecNode &loop, LoopTier &tier) {
+	if (tier.chunk) {
+		return true;
+	}
+	if (++tier.backEdges != runOptions.osrThreshold) {
+		return false;
+	}
+	if (runOptions.jit) {
+		jitLoop(loop);
+		return false;
+	}
+	if (tier.holdsReturn) {
+		return false;
+	}
+	loopChunks.push_back(make_unique<Chunk>());
+	BytecodeCompiler(*loopChunks.back()).compileLoop(&loop);
+	tier.chunk = loopChunks.back().get();
+	return true;
+}
 
-	cerr << "ไม่รู้จักคำสั่งประเภทนี้ "<<" ที่บรรทัด "<<stmt["line"]<<" คอลัมน์ "<<stmt["column"]<< "";
-	exit(1);
-	// bracket below refer to evalStatement
+void resumeLoop(const Chunk &chunk, const Value *stop, const Value *step) {
+	if (stop) {
+		vmStack.push_back(*stop);
+		vmStack.push_back(*step);
+	}
+	runChunk(chunk, chunk.entry, stop ? 2 : 0);
 }
 
 // make AST
@@ -1747,6 +6184,7 @@ public:
 class PrintNode : public ASTNode {
 public:
 	vector<ASTNodePtr> expression;
+	bool hasList = true; // false for a module's print with no expression list
 	PrintNode(vector<ASTNodePtr> expression, const Token &t) :
 		expression(move(expression)), ASTNode(t) {}
 
@@ -1811,6 +6249,8 @@ class ImportNode : public ASTNode {
 public:
     string file;
     string name;
+    // the module this import is in, for a nested import; empty in a script
+    string currentFilePath;
     ImportNode(const string &file, const string &name, const Token &t) :
         file(file), name(name), ASTNode(t) {}
 
@@ -2280,6 +6720,7 @@ public:
 class ArrayAccessNode : public ASTNode {
 	ASTNodePtr array;
 	ASTNodePtr index;
+	friend ExecNodePtr lowerNode(const ASTNodePtr &node);
 
 public:
 	ArrayAccessNode(ASTNodePtr array, ASTNodePtr index, const Token &t) :
@@ -2319,6 +6760,7 @@ public:
 };
 class ObjectLiteralNode : public ASTNode {
 	std::vector<std::pair<ASTNodePtr, ASTNodePtr>> properties;
+	friend ExecNodePtr lowerNode(const ASTNodePtr &node);
 
 public:
 	ObjectLiteralNode(std::vector<std::pair<ASTNodePtr, ASTNodePtr>> props,
@@ -2438,45 +6880,638 @@ class EmptyStatementNode : public ASTNode {
 public:
 	string print() const override { return "{\"type\":\"EmptyStatement\"}"; }
 };
+
+// Nodes only a module's json makes: a statement list of its own, and what
+// stands where the json is not a node mmt knows.
+class BlockNode : public ASTNode {
+public:
+	vector<ASTNodePtr> statements;
+	BlockNode(vector<ASTNodePtr> statements, const Token &t) :
+		ASTNode(t), statements(move(statements)) {}
+	string print() const override {
+		string stmts = "[";
+		for (size_t i = 0; i < statements.size(); i++) {
+			if (i > 0)
+				stmts += ",";
+			stmts += statements[i] ? statements[i]->print() : "null";
+		}
+		stmts += "]";
+		return "{\"type\":\"block\",\"statements\":" + stmts +
+			   ",\"line\":" + to_string(token.line) +
+			   ",\"column\":" + to_string(token.column) + "}";
+	}
+};
+class MalformedNode : public ASTNode {
+public:
+	string text;   // the json as it was
+	bool isObject; // an object of an unknown type rather than not an object
+	MalformedNode(const string &text, bool isObject, const Token &t) :
+		ASTNode(t), text(text), isObject(isObject) {}
+	string print() const override { return text; }
+};
+
+// Lowering the parsed tree
+//
+// Scripts and imported modules alike are lowered from these nodes: a script
+// as the parser made them, a module as nodeFromJson reads them back from its
+// .json file. Children are visited in source order, which is the order
+// variables get their slots in.
+
+template <class T> unique_ptr<T> makeExec(ExecKind kind, const ASTNode &n) {
+	auto node = make_unique<T>();
+	node->kind = kind;
+	node->line = n.token.line;
+	node->column = n.token.column;
+	return node;
+}
+
+vector<ExecNodePtr> lowerList(const vector<ASTNodePtr> &list) {
+	vector<ExecNodePtr> nodes;
+	nodes.reserve(list.size());
+	for (const auto &item : list) {
+		nodes.push_back(lowerNode(item));
+	}
+	return nodes;
+}
+
+// "" unless node is a plain variable
+string variableName(const ASTNodePtr &node) {
+	auto variable = dynamic_cast<const VariableNode *>(node.get());
+	return variable ? variable->name : "";
+}
+
+unique_ptr<ExecFunction> lowerFunction(const ASTNodePtr &f) {
+	auto decl = dynamic_cast<const FunctionDeclaretionNode *>(f.get());
+	if (!decl) {
+		auto node = make_unique<ExecFunction>();
+		node->kind = ExecKind::FunctionDeclaration;
+		if (f) {
+			node->line = f->token.line;
+			node->column = f->token.column;
+		}
+		return node;
+	}
+	auto node = makeExec<ExecFunction>(ExecKind::FunctionDeclaration, *decl);
+	node->name = decl->funcName;
+	for (const auto &p : decl->parasmeter) {
+		auto param = dynamic_cast<const AssignmentNode *>(p.get());
+		node->parameters.push_back(
+			variableSlot(param ? variableName(param->varname) : ""));
+	}
+	LoweringContext outer = lowering;
+	lowering = {0, true, 0};
+	node->body = lowerList(decl->expression);
+	lowering = outer;
+	return node;
+}
+
+// false when name is not an operator the evaluator implements
+bool lowerOperator(const string &name, TokenType &op) {
+	auto it = operatorKinds().find(name);
+	if (it == operatorKinds().end()) {
+		return false;
+	}
+	op = it->second;
+	return true;
+}
+
+// The statements of an elif or else branch
+vector<ExecNodePtr> lowerBranchBody(const ASTNodePtr &branch) {
+	if (auto e = dynamic_cast<const ElifNode *>(branch.get())) {
+		return lowerList(e->statement);
+	} else if (auto e = dynamic_cast<const ElseNode *>(branch.get())) {
+		return lowerList(e->statement);
+	}
+	return {};
+}
+
+ExecNodePtr lowerNode(const ASTNodePtr &ast) {
+	const ASTNode *n = ast.get();
+	if (!n) {
+		auto node = make_unique<ExecInvalid>();
+		node->kind = ExecKind::Invalid;
+		node->text = "null";
+		return node;
+	}
+	if (auto a = dynamic_cast<const MalformedNode *>(n)) {
+		if (a->isObject) {
+			return makeExec<ExecNode>(ExecKind::Unknown, *a);
+		}
+		auto node = make_unique<ExecInvalid>();
+		node->kind = ExecKind::Invalid;
+		node->text = a->text;
+		return node;
+	}
+
+	if (auto a = dynamic_cast<const IntNode *>(n)) {
+		auto node = makeExec<ExecInt>(ExecKind::Int, *a);
+		node->value = a->value;
+		return node;
+	} else if (auto a = dynamic_cast<const FloatNode *>(n)) {
+		auto node = makeExec<ExecFloat>(ExecKind::Float, *a);
+		node->value = a->value;
+		return node;
+	} else if (auto a = dynamic_cast<const BoolNode *>(n)) {
+		auto node = makeExec<ExecBool>(ExecKind::Bool, *a);
+		node->value = a->value;
+		return node;
+	} else if (auto a = dynamic_cast<const StringNode *>(n)) {
+		auto node = makeExec<ExecString>(ExecKind::String, *a);
+		node->value = a->value;
+		return node;
+	} else if (dynamic_cast<const NullNode *>(n)) {
+		return makeExec<ExecNode>(ExecKind::Null, *n);
+	} else if (auto a = dynamic_cast<const VariableNode *>(n)) {
+		auto node = makeExec<ExecVariable>(ExecKind::Variable, *a);
+		node->name = a->name;
+		node->slot = variableSlot(node->name);
+		return node;
+	} else if (auto a = dynamic_cast<const ArrayLiterelNode *>(n)) {
+		auto node = makeExec<ExecArrayLiteral>(ExecKind::ArrayLiteral, *a);
+		node->elements = lowerList(a->element);
+		return node;
+	} else if (auto a = dynamic_cast<const ObjectLiteralNode *>(n)) {
+		auto node = makeExec<ExecObjectLiteral>(ExecKind::ObjectLiteral, *a);
+		for (const auto &[key, value] : a->properties) {
+			node->properties.emplace_back(lowerNode(key), lowerNode(value));
+		}
+		return node;
+	} else if (auto a = dynamic_cast<const UnaryOpNode *>(n)) {
+		auto node = makeExec<ExecUnary>(ExecKind::UnaryOp, *a);
+		node->knownOp = lowerOperator(a->op, node->op);
+		node->operand = lowerNode(a->operand);
+		return node;
+	} else if (auto a = dynamic_cast<const logarithmNode *>(n)) {
+		auto node = makeExec<ExecLn>(ExecKind::Ln, *a);
+		node->value = lowerNode(a->value);
+		return node;
+	} else if (auto a = dynamic_cast<const BinaryOPNode *>(n)) {
+		auto node = makeExec<ExecBinary>(ExecKind::BinaryOp, *a);
+		node->knownOp = lowerOperator(a->op, node->op);
+		node->left = lowerNode(a->left);
+		node->right = lowerNode(a->right);
+		return node;
+	} else if (auto a = dynamic_cast<const ConvertNode *>(n)) {
+		auto node = makeExec<ExecConvert>(ExecKind::Convert, *a);
+		node->target = a->targetType;
+		node->expression = lowerNode(a->expression);
+		return node;
+	} else if (auto a = dynamic_cast<const ObjectAccessNode *>(n)) {
+		auto node = makeExec<ExecObjectAccess>(ExecKind::ObjectAccess, *a);
+		node->object = lowerNode(a->object);
+		node->key = lowerNode(a->key);
+		if (node->key->kind == ExecKind::Variable) {
+			node->dotKey = true;
+			node->keyName = static_cast<ExecVariable &>(*node->key).name;
+		}
+		return node;
+	} else if (auto a = dynamic_cast<const ArrayAccessNode *>(n)) {
+		auto node = makeExec<ExecArrayAccess>(ExecKind::ArrayAccess, *a);
+		node->array = lowerNode(a->array);
+		node->index = lowerNode(a->index);
+		return node;
+	} else if (auto a = dynamic_cast<const FunctionCallNode *>(n)) {
+		auto node = makeExec<ExecCall>(ExecKind::FunctionCall, *a);
+		auto name = dynamic_cast<const VariableNode *>(a->funcname.get());
+		node->badName = !name;
+		if (name) {
+			node->name = name->name;
+		}
+		if (a->namespaceName) {
+			auto ns = dynamic_cast<const VariableNode *>(a->namespaceName.get());
+			node->badNamespace = !ns;
+			if (ns) {
+				node->ns = ns->name;
+			}
+		}
+		node->args = lowerList(a->argument);
+		return node;
+	} else if (auto a = dynamic_cast<const LengthNode *>(n)) {
+		auto node = makeExec<ExecLength>(ExecKind::Length, *a);
+		node->target = lowerNode(a->target);
+		return node;
+	} else if (auto a = dynamic_cast<const PrintNode *>(n)) {
+		auto node = makeExec<ExecPrint>(ExecKind::Print, *a);
+		node->hasList = a->hasList;
+		node->expressions = lowerList(a->expression);
+		return node;
+	} else if (auto a = dynamic_cast<const BlockNode *>(n)) {
+		auto node = makeExec<ExecBlock>(ExecKind::Block, *a);
+		node->statements = lowerList(a->statements);
+		return node;
+	} else if (auto a = dynamic_cast<const IfNode *>(n)) {
+		auto node = makeExec<ExecIf>(ExecKind::If, *a);
+		node->then.condition = lowerNode(a->condition);
+		node->then.body = lowerList(a->body);
+		for (const auto &e : a->ELIF) {
+			ExecBranch branch;
+			auto elif = dynamic_cast<const ElifNode *>(e.get());
+			branch.condition = lowerNode(elif ? elif->condition : nullptr);
+			branch.body = lowerBranchBody(e);
+			node->elifs.push_back(std::move(branch));
+		}
+		node->hasElse = a->ELSE != nullptr;
+		node->elseBody = lowerBranchBody(a->ELSE);
+		return node;
+	} else if (auto a = dynamic_cast<const AssignmentNode *>(n)) {
+		auto node = makeExec<ExecAssignment>(ExecKind::Assignment, *a);
+		node->target = lowerNode(a->varname);
+		node->value = lowerNode(a->value);
+		node->isConst = a->isconst;
+		return node;
+	} else if (auto a = dynamic_cast<const InputNode *>(n)) {
+		auto node = makeExec<ExecInput>(ExecKind::Input, *a);
+		node->slot = variableSlot(variableName(a->varname));
+		return node;
+	} else if (dynamic_cast<const BreakNode *>(n) ||
+			   dynamic_cast<const ContinueNode *>(n)) {
+		auto node = makeExec<ExecJump>(dynamic_cast<const BreakNode *>(n)
+										   ? ExecKind::Break
+										   : ExecKind::Continue,
+									   *n);
+		node->inLoop = lowering.loops > 0;
+		return node;
+	} else if (dynamic_cast<const WhileNode *>(n) ||
+			   dynamic_cast<const DoWhileNode *>(n)) {
+		auto w = dynamic_cast<const WhileNode *>(n);
+		auto d = dynamic_cast<const DoWhileNode *>(n);
+		auto node = makeExec<ExecLoop>(
+			w ? ExecKind::WhileLoop : ExecKind::DoWhileLoop, *n);
+		node->condition = lowerNode(w ? w->condition : d->condition);
+		int returns = lowering.returns;
+		lowering.loops++;
+		node->body = lowerList(w ? w->expression : d->expression);
+		lowering.loops--;
+		node->tier.holdsReturn = lowering.returns != returns;
+		return node;
+	} else if (auto a = dynamic_cast<const ForNode *>(n)) {
+		auto node = makeExec<ExecFor>(ExecKind::ForLoop, *a);
+		node->variable = variableSlot(variableName(a->variable));
+		node->init = lowerNode(a->initialization);
+		node->stop = lowerNode(a->condition);
+		node->step = lowerNode(a->chagevalue);
+		int returns = lowering.returns;
+		lowering.loops++;
+		node->body = lowerList(a->statement);
+		lowering.loops--;
+		node->tier.holdsReturn = lowering.returns != returns;
+		return node;
+	} else if (auto a = dynamic_cast<const ReturnNode *>(n)) {
+		auto node = makeExec<ExecReturn>(ExecKind::Return, *a);
+		lowering.returns++;
+		node->value = lowerNode(a->value);
+		node->inFunction = lowering.inFunction;
+		if (node->inFunction && node->value->kind == ExecKind::FunctionCall) {
+			const auto &call = static_cast<const ExecCall &>(*node->value);
+			node->tailCall = !call.badName && !call.badNamespace;
+		}
+		return node;
+	} else if (dynamic_cast<const FunctionDeclaretionNode *>(n)) {
+		return lowerFunction(ast);
+	} else if (auto a = dynamic_cast<const PushNode *>(n)) {
+		auto node = makeExec<ExecArrayOp>(ExecKind::Push, *a);
+		node->array = lowerNode(a->array);
+		node->value = lowerNode(a->value);
+		return node;
+	} else if (auto a = dynamic_cast<const PopNode *>(n)) {
+		auto node = makeExec<ExecArrayOp>(ExecKind::Pop, *a);
+		node->array = lowerNode(a->array);
+		return node;
+	} else if (auto a = dynamic_cast<const InsertNode *>(n)) {
+		auto node = makeExec<ExecArrayOp>(ExecKind::Insert, *a);
+		node->array = lowerNode(a->array);
+		node->index = lowerNode(a->index);
+		node->value = lowerNode(a->value);
+		return node;
+	} else if (auto a = dynamic_cast<const EraseNode *>(n)) {
+		auto node = makeExec<ExecArrayOp>(ExecKind::Erase, *a);
+		node->array = lowerNode(a->array);
+		node->index = lowerNode(a->index);
+		return node;
+	} else if (dynamic_cast<const ExitProcessNode *>(n)) {
+		return makeExec<ExecNode>(ExecKind::ExitProcess, *n);
+	} else if (auto a = dynamic_cast<const ExportNode *>(n)) {
+		auto node = makeExec<ExecExport>(ExecKind::Export, *a);
+		for (const auto &f : a->functions) {
+			node->functions.push_back(lowerFunction(f));
+		}
+		return node;
+	} else if (auto a = dynamic_cast<const ImportNode *>(n)) {
+		auto node = makeExec<ExecImport>(ExecKind::Import, *a);
+		node->file = a->file;
+		node->name = a->name;
+		node->currentFilePath = a->currentFilePath;
+		return node;
+	} else if (dynamic_cast<const CommentNode *>(n)) {
+		return makeExec<ExecNode>(ExecKind::Comment, *n);
+	} else if (auto a = dynamic_cast<const ProgramNode *>(n)) {
+		auto node = make_unique<ExecProgram>();
+		node->kind = ExecKind::Program;
+		node->statements = lowerList(a->statements);
+		return node;
+	}
+	return makeExec<ExecNode>(ExecKind::Unknown, *n);
+}
+const json &jsonField(const json &j, const char *key) {
+	static const json missing;
+	if (!j.is_object()) {
+		return missing;
+	}
+	auto it = j.find(key);
+	return it == j.end() ? missing : *it;
+}
+
+Token jsonToken(const json &j) {
+	Token t{TokenType::END_OF_FILE, 0, 0, ""};
+	if (jsonField(j, "line").is_number()) {
+		t.line = j["line"].get<int>();
+	}
+	if (jsonField(j, "column").is_number()) {
+		t.column = j["column"].get<int>();
+	}
+	return t;
+}
+
+string jsonString(const json &j) {
+	return j.is_string() ? j.get<string>() : "";
+}
+
+vector<ASTNodePtr> nodesFromJson(const json &list) {
+	vector<ASTNodePtr> nodes;
+	if (list.is_array()) {
+		nodes.reserve(list.size());
+		for (const auto &item : list) {
+			nodes.push_back(nodeFromJson(item));
+		}
+	}
+	return nodes;
+}
+
+// A loop body: a block's statements, or anything else as one statement
+vector<ASTNodePtr> bodyFromJson(const json &body) {
+	if (jsonField(body, "type") == "block") {
+		return nodesFromJson(body["statements"]);
+	}
+	vector<ASTNodePtr> nodes;
+	nodes.push_back(nodeFromJson(body));
+	return nodes;
+}
+
+// The variable j's "variable" field names, or one named "" if it names none
+ASTNodePtr variableFromJson(const json &j) {
+	const json &variable = jsonField(j, "variable");
+	return make_shared<VariableNode>(jsonString(jsonField(variable, "name")),
+									 jsonToken(variable));
+}
+
+// A call's name or namespace; a field with no name is kept for the call to
+// report
+ASTNodePtr nameFromJson(const json &j) {
+	const json &name = jsonField(j, "name");
+	if (name.is_string()) {
+		return make_shared<VariableNode>(name.get<string>(), jsonToken(j));
+	}
+	return make_shared<MalformedNode>(j.dump(), j.is_object(), jsonToken(j));
+}
+
+ASTNodePtr functionFromJson(const json &j) {
+	vector<ASTNodePtr> params;
+	const json &list = jsonField(j, "parameter");
+	if (list.is_array()) {
+		for (const auto &p : list) {
+			params.push_back(make_shared<AssignmentNode>(
+				variableFromJson(p), nullptr, jsonToken(p), false));
+		}
+	}
+	vector<ASTNodePtr> body =
+		nodesFromJson(jsonField(jsonField(j, "body"), "statements"));
+	return make_shared<FunctionDeclaretionNode>(
+		jsonString(jsonField(j, "name")), std::move(params), std::move(body),
+		jsonString(jsonField(j, "returnType")), jsonToken(j));
+}
+
+// Reading a module back
+//
+// An imported module is a .json file holding what print() wrote for a
+// script. nodeFromJson builds the nodes again, children in the order
+// lowering visits them. A file written by hand may hold what the parser
+// never makes; that is kept in the tree (a null child, a MalformedNode, a
+// PrintNode without its list) and reported when it runs. A field of the
+// wrong json type throws json's type_error, as it did when modules were
+// run from the json itself.
+ASTNodePtr nodeFromJson(const json &j) {
+	if (j.is_null()) {
+		return nullptr;
+	}
+	Token t = jsonToken(j);
+	if (!j.is_object()) {
+		return make_shared<MalformedNode>(j.dump(), false, t);
+	}
+	const string type = jsonString(jsonField(j, "type"));
+
+	if (type == "int") {
+		return make_shared<IntNode>(j["value"].get<int>(), t);
+	} else if (type == "float") {
+		return make_shared<FloatNode>(j["value"].get<double>(), t);
+	} else if (type == "bool") {
+		return make_shared<BoolNode>(j["value"].get<bool>(), t);
+	} else if (type == "string") {
+		return make_shared<StringNode>(j["value"].get<string>(), t);
+	} else if (type == "null") {
+		return make_shared<NullNode>(t);
+	} else if (type == "variable") {
+		return make_shared<VariableNode>(j["name"].get<string>(), t);
+	} else if (type == "ArrayLiterel") {
+		return make_shared<ArrayLiterelNode>(
+			nodesFromJson(jsonField(j, "element")), t);
+	} else if (type == "ObjectLiteral") {
+		vector<pair<ASTNodePtr, ASTNodePtr>> properties;
+		const json &list = jsonField(j, "properties");
+		if (list.is_array()) {
+			for (const auto &prop : list) {
+				ASTNodePtr key = nodeFromJson(jsonField(prop, "key"));
+				properties.emplace_back(key, nodeFromJson(jsonField(prop, "value")));
+			}
+		}
+		return make_shared<ObjectLiteralNode>(std::move(properties), t);
+	} else if (type == "unaryOp") {
+		return make_shared<UnaryOpNode>(jsonString(jsonField(j, "operator")),
+										nodeFromJson(jsonField(j, "operand")), t);
+	} else if (type == "ln") {
+		return make_shared<logarithmNode>(nodeFromJson(jsonField(j, "value")), t);
+	} else if (type == "binaryOp") {
+		ASTNodePtr left = nodeFromJson(jsonField(j, "left"));
+		ASTNodePtr right = nodeFromJson(jsonField(j, "right"));
+		return make_shared<BinaryOPNode>(jsonString(jsonField(j, "Op")), left,
+										 right, t);
+	} else if (type == "Convert") {
+		string target = j["target"].get<string>();
+		return make_shared<ConvertNode>(nodeFromJson(jsonField(j, "expression")),
+										target, t);
+	} else if (type == "ObjectAccess") {
+		ASTNodePtr object = nodeFromJson(jsonField(j, "object"));
+		ASTNodePtr key = nodeFromJson(jsonField(j, "key"));
+		return make_shared<ObjectAccessNode>(object, key, t);
+	} else if (type == "ArrayAccess") {
+		ASTNodePtr array = nodeFromJson(jsonField(j, "array"));
+		ASTNodePtr index = nodeFromJson(jsonField(j, "index"));
+		return make_shared<ArrayAccessNode>(array, index, t);
+	} else if (type == "FunctionCall") {
+		ASTNodePtr name = nameFromJson(jsonField(j, "name"));
+		const json &ns = jsonField(j, "namespace");
+		ASTNodePtr namespaceName = ns.is_null() ? nullptr : nameFromJson(ns);
+		return make_shared<FunctionCallNode>(
+			namespaceName, name, nodesFromJson(jsonField(j, "argument")), t);
+	} else if (type == "Length") {
+		return make_shared<LengthNode>(nodeFromJson(jsonField(j, "target")), t);
+	} else if (type == "print") {
+		const json &list = jsonField(j, "expression");
+		auto node = make_shared<PrintNode>(nodesFromJson(list), t);
+		node->hasList = list.is_array();
+		return node;
+	} else if (type == "block") {
+		return make_shared<BlockNode>(nodesFromJson(jsonField(j, "statements")),
+									  t);
+	} else if (type == "if") {
+		ASTNodePtr condition = nodeFromJson(jsonField(j, "condition"));
+		vector<ASTNodePtr> body =
+			nodesFromJson(jsonField(jsonField(j, "body"), "statements"));
+		vector<ASTNodePtr> elifs;
+		const json &list = jsonField(j, "elif");
+		if (list.is_array()) {
+			for (const auto &e : list) {
+				ASTNodePtr elifCondition = nodeFromJson(jsonField(e, "condition"));
+				elifs.push_back(make_shared<ElifNode>(
+					elifCondition,
+					nodesFromJson(jsonField(jsonField(e, "body"), "statements")),
+					jsonToken(e)));
+			}
+		}
+		const json &elseNode = jsonField(j, "else");
+		ASTNodePtr elseBranch;
+		if (elseNode.is_object()) {
+			elseBranch = make_shared<ElseNode>(
+				nodesFromJson(jsonField(jsonField(elseNode, "body"), "statements")),
+				jsonToken(elseNode));
+		}
+		return make_shared<IfNode>(condition, std::move(body), t,
+								   std::move(elifs), elseBranch);
+	} else if (type == "assignment") {
+		ASTNodePtr variable = nodeFromJson(jsonField(j, "variable"));
+		ASTNodePtr value = nodeFromJson(jsonField(j, "value"));
+		const json &isConst = jsonField(j, "isconst");
+		return make_shared<AssignmentNode>(
+			variable, value, t,
+			isConst.is_boolean() ? isConst.get<bool>() : jsonString(isConst) == "true");
+	} else if (type == "input") {
+		return make_shared<InputNode>(variableFromJson(j), t);
+	} else if (type == "Break") {
+		return make_shared<BreakNode>(t);
+	} else if (type == "Continue") {
+		return make_shared<ContinueNode>(t);
+	} else if (type == "whileloop" || type == "dowhileloop") {
+		ASTNodePtr condition = nodeFromJson(jsonField(j, "condition"));
+		vector<ASTNodePtr> body = bodyFromJson(jsonField(j, "body"));
+		if (type == "whileloop") {
+			return make_shared<WhileNode>(condition, std::move(body), t);
+		}
+		return make_shared<DoWhileNode>(condition, std::move(body), t);
+	} else if (type == "forloop") {
+		ASTNodePtr init = nodeFromJson(jsonField(j, "initialization"));
+		ASTNodePtr stop = nodeFromJson(jsonField(j, "condition"));
+		ASTNodePtr step = nodeFromJson(jsonField(j, "changevalue"));
+		vector<ASTNodePtr> body = bodyFromJson(jsonField(j, "body"));
+		return make_shared<ForNode>(init, stop, step, std::move(body), t,
+									variableFromJson(j));
+	} else if (type == "return") {
+		return make_shared<ReturnNode>(nodeFromJson(jsonField(j, "value")), t);
+	} else if (type == "functionDeclaretion") {
+		return functionFromJson(j);
+	} else if (type == "Push" || type == "Pop" || type == "Insert" ||
+			   type == "Erase") {
+		ASTNodePtr array = nodeFromJson(jsonField(j, "array"));
+		if (type == "Pop") {
+			return make_shared<PopNode>(array, t);
+		} else if (type == "Push") {
+			return make_shared<PushNode>(array, nodeFromJson(jsonField(j, "value")),
+										 t);
+		}
+		ASTNodePtr index = nodeFromJson(jsonField(j, "index"));
+		if (type == "Erase") {
+			return make_shared<EraseNode>(array, index, t);
+		}
+		return make_shared<InsertNode>(array, index,
+									   nodeFromJson(jsonField(j, "value")), t);
+	} else if (type == "ExitProcess") {
+		return make_shared<ExitProcessNode>(t);
+	} else if (type == "export") {
+		vector<ASTNodePtr> functions;
+		const json &list = jsonField(j, "function");
+		if (list.is_array()) {
+			for (const auto &f : list) {
+				functions.push_back(functionFromJson(f));
+			}
+		}
+		return make_shared<ExportNode>(functions, t);
+	} else if (type == "import") {
+		string file = j["file"].get<string>();
+		auto node = make_shared<ImportNode>(file, j["name"].get<string>(), t);
+		node->currentFilePath = j.value("__currentFilePath", "");
+		return node;
+	} else if (type == "Comment") {
+		return make_shared<CommentNode>(jsonString(jsonField(j, "text")), t);
+	} else if (type == "Program") {
+		return make_shared<ProgramNode>(nodesFromJson(jsonField(j, "statements")),
+										t);
+	}
+	return make_shared<MalformedNode>(j.dump(), true, t);
+}
+
 	class Parser {
-	    vector<Token> tokens;
+	    const vector<Token> &tokens;
 	    size_t pos = 0;
 	    bool expecting_indent = false;
 
 	public:
 	    Parser(const vector<Token> &t) : tokens(t) {}
 
-	    Token peek() {
+	    const Token &peek() const {
 	        if (pos < tokens.size()) {
 	            return tokens[pos];
 	        }
-	        return {"EOF", "", 0, 0};
+	        return endOfInput();
 	    }
 
-	    Token advance() {
+	    const Token &advance() {
 	        if (pos < tokens.size()) {
-	            Token tok = tokens[pos];
+	            const Token &tok = tokens[pos];
 	            pos++;
 
 	            // After certain tokens, we expect an indented block
-	            if (tok.type == "IF" || tok.type == "ELIF" || tok.type == "ELSE" ||
-	                tok.type == "WHILE" || tok.type == "FOR" || tok.type == "DO" ||
-	                tok.type == "PROGRAM" || tok.type == "FUNCTION") {
+	            if (tok.type == TokenType::IF || tok.type == TokenType::ELIF ||
+	                tok.type == TokenType::ELSE || tok.type == TokenType::WHILE ||
+	                tok.type == TokenType::FOR || tok.type == TokenType::DO ||
+	                tok.type == TokenType::PROGRAM) {
 	                expecting_indent = true;
 	            }
 
 	            return tok;
 	        }
-	        return {"EOF", "", 0, 0};
+	        return endOfInput();
+	    }
+
+	    static const Token &endOfInput() {
+	        static const Token eof{TokenType::END_OF_FILE, 0, 0, ""};
+	        return eof;
 	    }
 
 	    void skip_newlines() {
-	        while (peek().type == "NEWLINE") {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 	    }
 
-	    bool match(const string &type) {
+	    bool match(TokenType type) {
 	        if (peek().type == type) {
 	            advance();
 	            return true;
@@ -2486,7 +7521,7 @@ public:
 
 	    void expect_indent() {
 	        skip_newlines();
-	        if (!match("INDENT")) {
+	        if (!match(TokenType::INDENT)) {
 	            syntaxError(peek(), "ต้องการการย่อหน้า");
 	        }
 	    }
@@ -2494,7 +7529,7 @@ public:
 	    void expect_dedent() {
 	        // Skip newlines before dedent
 	        skip_newlines();
-	        if (!match("DEDENT")) {
+	        if (!match(TokenType::DEDENT)) {
 	            syntaxError(peek(), "ต้องการลดระดับการย่อหน้า");
 	        }
 	    }
@@ -2502,9 +7537,9 @@ public:
 	        Token t = peek();
 	        vector<ASTNodePtr> statements;
 
-	        while (peek().type != "EOF") {
+	        while (peek().type != TokenType::END_OF_FILE) {
 	            skip_newlines();
-	            if (peek().type == "EOF") break;
+	            if (peek().type == TokenType::END_OF_FILE) break;
 
 	            statements.push_back(parseStatement());
 	        }
@@ -2514,14 +7549,14 @@ public:
 	ASTNodePtr parseExpression() { return parseAssigment(); }
 	ASTNodePtr parseAssigment() {
 		bool isconst  = false;
-		if(match("CONST") ){
+		if(match(TokenType::CONST) ){
 
 			isconst = true;
 		}
 
 		ASTNodePtr left = parseLogicalOR();
 		Token t = peek();
-		if (match("EQUALSSIGN")) {
+		if (match(TokenType::EQUALSSIGN)) {
 			ASTNodePtr right = parseExpression();
 			return make_shared<AssignmentNode>(left, right, t,isconst);
 		}
@@ -2536,10 +7571,10 @@ public:
 	ASTNodePtr parseLogicalOR() {
 
 		ASTNodePtr left = parseLogicalAND();
-		while (peek().type =="OR")
+		while (peek().type ==TokenType::OR)
 		{
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr right = parseLogicalAND();
 			left = make_shared<BinaryOPNode>(op, left, right, t);
 		}
@@ -2550,10 +7585,10 @@ public:
 
 		ASTNodePtr left = parseLogicalBiswiseOR();
 		while (peek().type ==
-			   "AND") // match("AND", "AND in parseLOgicalAND")
+			   TokenType::AND) // match("AND", "AND in parseLOgicalAND")
 		{
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr right = parseLogicalBiswiseOR();
 			left = make_shared<BinaryOPNode>(op, left, right, t);
 		}
@@ -2564,11 +7599,11 @@ public:
 
 		ASTNodePtr left = parseLogicalBiswiseXOR();
 		while (peek().type ==
-			   "BITWISE_OR") // match("BITWISE_OR", "BiswiseOR in
+			   TokenType::BITWISE_OR) // match("BITWISE_OR", "BiswiseOR in
 							 // parseLogicalBiswiseOR")
 		{
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr right = parseLogicalBiswiseXOR();
 			left = make_shared<BinaryOPNode>(op, left, right, t);
 		}
@@ -2578,11 +7613,11 @@ public:
 
 		ASTNodePtr left = parseLogicalBiswiseAND();
 		while (peek().type ==
-			   "XOR") // match("BITWISE_XOR", "BiswiseXOR in
+			   TokenType::XOR) // match("BITWISE_XOR", "BiswiseXOR in
 					  // parseLogicalBiswiseXOR")
 		{
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr right = parseLogicalBiswiseAND();
 			left = make_shared<BinaryOPNode>(op, left, right, t);
 		}
@@ -2591,10 +7626,10 @@ public:
 	ASTNodePtr parseLogicalBiswiseAND() {
 
 		ASTNodePtr left = parseEquality();
-		while (peek().type == "BITWISE_AND")
+		while (peek().type == TokenType::BITWISE_AND)
 		{
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr right = parseEquality();
 			left = make_shared<BinaryOPNode>(op, left, right, t);
 		}
@@ -2605,9 +7640,9 @@ public:
 		ASTNodePtr left = parseRelational();
 		while (true) {
 			Token t = peek();
-			if (peek().type == "EQUALTO" ||
-				peek().type == "NOTEQUAL") {
-				string op = advance().type;
+			if (peek().type == TokenType::EQUALTO ||
+				peek().type == TokenType::NOTEQUAL) {
+				const string &op = tokenTypeName(advance().type);
 				ASTNodePtr right = parseRelational();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
 			} else {
@@ -2620,14 +7655,14 @@ public:
 		ASTNodePtr left = parseShift();
 		while (true) {
 			Token t = peek();
-			if (peek().type == "GREATER" ||
-				peek().type == "LESSER" ||
+			if (peek().type == TokenType::GREATER ||
+				peek().type == TokenType::LESSER ||
 				peek().type ==
-					"GREATEROREQUAL" ||
+					TokenType::GREATEROREQUAL ||
 				peek().type ==
-					"LESSEROREQUAL") {
-				string op =
-					advance().type;
+					TokenType::LESSEROREQUAL) {
+				const string &op =
+					tokenTypeName(advance().type);
 				ASTNodePtr right = parseShift();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
 			} else {
@@ -2640,10 +7675,10 @@ public:
 		ASTNodePtr left = parseAdditive();
 		while (true) {
 			Token t = peek();
-			if (peek().type == "SHIFT_LEFT" ||
-				peek().type == "SHIFT_RIGHT")
+			if (peek().type == TokenType::SHIFT_LEFT ||
+				peek().type == TokenType::SHIFT_RIGHT)
 			{
-				string op = advance().type;
+				const string &op = tokenTypeName(advance().type);
 				ASTNodePtr right = parseAdditive();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
 			} else {
@@ -2656,10 +7691,10 @@ public:
 		ASTNodePtr left = Multiplicative();
 		while (true) {
 			Token t = peek();
-			if (peek().type == "ADDITION" ||
-				peek().type == "SUBTRACTION")
+			if (peek().type == TokenType::ADDITION ||
+				peek().type == TokenType::SUBTRACTION)
 			{
-				string op = advance().type;
+				const string &op = tokenTypeName(advance().type);
 				ASTNodePtr right = Multiplicative();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
 
@@ -2672,15 +7707,15 @@ public:
 		ASTNodePtr left = parseExponents();
 		while (true) {
 			Token t = peek();
-			if (peek().type == "MULTIPLICATION")
+			if (peek().type == TokenType::MULTIPLICATION)
 			{
-				string op =
-					advance().type;
+				const string &op =
+					tokenTypeName(advance().type);
 				ASTNodePtr right = parseExponents();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
-			} else if (peek().type == "FLOORDIVISION")
+			} else if (peek().type == TokenType::FLOORDIVISION)
 			{
-				string op = advance().type;
+				const string &op = tokenTypeName(advance().type);
 
 				ASTNodePtr right = parseExponents();
 				if (auto intNode = dynamic_cast<IntNode *>(right.get())) {
@@ -2694,10 +7729,10 @@ public:
 					}
 				}
 				left = make_shared<BinaryOPNode>(op, left, right, t);
-			} else if (peek().type == "DIVISION")
+			} else if (peek().type == TokenType::DIVISION)
 			{
-				string op =
-					advance().type;
+				const string &op =
+					tokenTypeName(advance().type);
 
 				ASTNodePtr right = parseExponents();
 				if (auto intNode = dynamic_cast<IntNode *>(right.get())) {
@@ -2711,9 +7746,9 @@ public:
 					}
 				}
 				left = make_shared<BinaryOPNode>(op, left, right, t);
-			} else if (peek().type =="MODULAS")
+			} else if (peek().type ==TokenType::MODULAS)
 			{
-				string op =advance().type;
+				const string &op = tokenTypeName(advance().type);
 
 				ASTNodePtr right = parseExponents();
 				if (auto intNode = dynamic_cast<IntNode *>(right.get())) {
@@ -2737,9 +7772,9 @@ public:
 		ASTNodePtr left = parseln();
 		while (true) {
 			Token t = peek();
-			if (peek().type =="EXPONENTIATION" ||
-				peek().type == "ROOT") {
-				string op = advance().type;
+			if (peek().type ==TokenType::EXPONENTIATION ||
+				peek().type == TokenType::ROOT) {
+				const string &op = tokenTypeName(advance().type);
 				ASTNodePtr right = parseln();
 				left = make_shared<BinaryOPNode>(op, left, right, t);
 			} else {
@@ -2750,14 +7785,14 @@ public:
 	}
 	ASTNodePtr parseln() {
 
-		if (peek().type == "LN") {
+		if (peek().type == TokenType::LN) {
 			Token t = peek();
 			advance();
-			if (!match("OPEN_PAREN")) {
+			if (!match(TokenType::OPEN_PAREN)) {
 				syntaxError(peek(), "ขาด วงเล็บเปิด ตรง ln");
 			}
 			ASTNodePtr val = parseExpression();
-			if (!match("CLOSE_PAREN")) {
+			if (!match(TokenType::CLOSE_PAREN)) {
 				syntaxError(peek(), "ขาด วงเล็บปิด ตรง ln");
 			}
 			return make_shared<logarithmNode>(val, t);
@@ -2766,13 +7801,13 @@ public:
 	}
 	ASTNodePtr parseUnary() {
 		// Prefix unary operators
-		if (peek().type == "NOT" ||
-			peek().type == "BITWISE_NOT" ||
-			peek().type == "INCREMENT" ||
-			peek().type == "DECREMENT"||
-			peek().type == "SUBTRACTION") {
+		if (peek().type == TokenType::NOT ||
+			peek().type == TokenType::BITWISE_NOT ||
+			peek().type == TokenType::INCREMENT ||
+			peek().type == TokenType::DECREMENT||
+			peek().type == TokenType::SUBTRACTION) {
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			ASTNodePtr operand = parseUnary(); // Recursively parse operand
 			return make_shared<UnaryOpNode>(op, operand, t);
 		}
@@ -2781,10 +7816,10 @@ public:
 		ASTNodePtr node = parsepimary();
 
 		// Postfix unary operators (e.g., x++, x--)
-		if (peek().type == "INCREMENT" ||
-			peek().type == "DECREMENT") {
+		if (peek().type == TokenType::INCREMENT ||
+			peek().type == TokenType::DECREMENT) {
 			Token t = peek();
-			string op = advance().type;
+			const string &op = tokenTypeName(advance().type);
 			return make_shared<UnaryOpNode>(
 				op, node, t); // Or a different node type like PostfixOpNode
 		}
@@ -2794,27 +7829,27 @@ public:
 
 	ASTNodePtr parsepimary() {
 
-		if (peek().type =="INTEGER_VALUE") {
+		if (peek().type ==TokenType::INTEGER_VALUE) {
 			return parseIntLiteral();
-		} else if (peek().type =="FLOAT_VALUE") {
+		} else if (peek().type ==TokenType::FLOAT_VALUE) {
 			return parseFloatLiteral();
-		} else if (peek().type =="STRING_VALUE") {
+		} else if (peek().type ==TokenType::STRING_VALUE) {
 			return parseStringLiteral();
-		} else if (peek().type =="TRUE_VALUE" ||
-				   peek().type =="FALSE_VALUE") {
+		} else if (peek().type ==TokenType::TRUE_VALUE ||
+				   peek().type ==TokenType::FALSE_VALUE) {
 			return parseBooliteral();
-		} else if (peek().type =="BRACKET_OPENING") {
+		} else if (peek().type ==TokenType::BRACKET_OPENING) {
 			return parseArrayLiteral();
-		} else if (peek().type =="OPEN_BRACKETS") {
+		} else if (peek().type ==TokenType::OPEN_BRACKETS) {
 			return parseObectLiteral();
-		} else if (peek().type =="OPEN_PAREN") {
+		} else if (peek().type ==TokenType::OPEN_PAREN) {
 			advance();
 			ASTNodePtr exps = parseExpression();
-			if (!match("CLOSE_PAREN")) {
+			if (!match(TokenType::CLOSE_PAREN)) {
 				syntaxError(peek(),"ขาด วงเล็บปิด");
 			}
 			return exps;
-		} else  if (peek().type == "IDENTIFIER") {
+		} else  if (peek().type == TokenType::IDENTIFIER) {
 	        ASTNodePtr base = parsevariable(); // Parse initial identifier
 
 	        // Handle chained accesses (array, object, function call)
@@ -2822,69 +7857,69 @@ public:
 	            Token t = peek();
 
 	            // 1. Array access: base[...]
-	            if (peek().type == "BRACKET_OPENING") {
+	            if (peek().type == TokenType::BRACKET_OPENING) {
 	                advance();
 	                ASTNodePtr index = parseExpression();
-	                if (!match("BRACKET_CLOSEING")) {
+	                if (!match(TokenType::BRACKET_CLOSEING)) {
 	                    syntaxError(peek(), "ขาด ] ในการเข้าถึง ชุดข้อมูล");
 	                }
 	                base = make_shared<ArrayAccessNode>(base, index, t);
 	            }
 	            // 2. Object access: base.property or base.method
-	            else if (peek().type == "DOT") {
+	            else if (peek().type == TokenType::DOT) {
 	                advance();
 
 	                // Handle built-in properties (like .length)
-	                if (peek().type == "LENGTH") {
+	                if (peek().type == TokenType::LENGTH) {
 	                    advance();
-	                    if (!match("OPEN_PAREN")) {
+	                    if (!match(TokenType::OPEN_PAREN)) {
 	                        syntaxError(peek(), "ขนาดต้องการ ()");
 	                    }
-	                    if (!match("CLOSE_PAREN")) {
+	                    if (!match(TokenType::CLOSE_PAREN)) {
 	                        syntaxError(peek(),"ขนาด ต้องการ )");
 	                    }
 	                    base = make_shared<LengthNode>(base, t);
 	                }
-		            else if (peek().type == "PUSH" ||
-		                     peek().type == "POP" ||
-		                     peek().type == "INSERT" ||
-		                     peek().type == "ERASE")
+		            else if (peek().type == TokenType::PUSH ||
+		                     peek().type == TokenType::POP ||
+		                     peek().type == TokenType::INSERT ||
+		                     peek().type == TokenType::ERASE)
 		            {
-		                string method = advance().type;
-		                if (!match("OPEN_PAREN")) {
-		                    syntaxError(peek(), "ขาด ( หลัง " + method);
+		                TokenType method = advance().type;
+		                if (!match(TokenType::OPEN_PAREN)) {
+		                    syntaxError(peek(), "ขาด ( หลัง " + tokenTypeName(method));
 		                }
 
-		                if (method == "POP" || method == "ERASE") {
+		                if (method == TokenType::POP || method == TokenType::ERASE) {
 		                    // POP and ERASE take one argument
 
-		                    if (method == "POP") {
+		                    if (method == TokenType::POP) {
 		                        base = make_shared<PopNode>(base, t);
 		                    } else {
 			                    ASTNodePtr arg = parseExpression();
 		                        base = make_shared<EraseNode>(base, arg, t);
 		                    }
-		                    if (!match("CLOSE_PAREN")) {
-		                        syntaxError(peek(), "ขาด ) หลัง " + method + " อากิวเมนต์");
+		                    if (!match(TokenType::CLOSE_PAREN)) {
+		                        syntaxError(peek(), "ขาด ) หลัง " + tokenTypeName(method) + " อากิวเมนต์");
 		                    }
 		                }
 		                else { // PUSH or INSERT
 		                    // First argument
 		                    ASTNodePtr arg1 = parseExpression();
 
-		                    if (method == "PUSH") {
-		                        if (!match("CLOSE_PAREN")) {
-		                            syntaxError(peek(), "ขาด ) หลัง " + method + " อากิวเมนต์");
+		                    if (method == TokenType::PUSH) {
+		                        if (!match(TokenType::CLOSE_PAREN)) {
+		                            syntaxError(peek(), "ขาด ) หลัง " + tokenTypeName(method) + " อากิวเมนต์");
 		                        }
 		                        base = make_shared<PushNode>(base, arg1, t);
 		                    }
 		                    else { // INSERT
-		                        if (!match("COMMA")) {
+		                        if (!match(TokenType::COMMA)) {
 		                            syntaxError(peek(), "ขาด , ในการ แทรก");
 		                        }
 
 		                        ASTNodePtr arg2 = parseExpression();
-		                        if (!match("CLOSE_PAREN")) {
+		                        if (!match(TokenType::CLOSE_PAREN)) {
 		                            syntaxError(peek(), "ขาด ) หลังการ แทรก");
 		                        }
 		                        base = make_shared<InsertNode>(base, arg1, arg2, t);
@@ -2894,7 +7929,7 @@ public:
 
 		            }
 	                // Regular member access
-	                else if (peek().type == "IDENTIFIER") {
+	                else if (peek().type == TokenType::IDENTIFIER) {
 	                    ASTNodePtr member = parsevariable();
 	                    base = make_shared<ObjectAccessNode>(base, member, t);
 	                }
@@ -2903,7 +7938,7 @@ public:
 	                }
 	            }
 	            // 3. Function call: base(...)
-	            else if (peek().type == "OPEN_PAREN") {
+	            else if (peek().type == TokenType::OPEN_PAREN) {
 	                // เก็บ base ปัจจุบันไว้ชั่วคราว
 	                ASTNodePtr potentialNamespace = base;
 	                ASTNodePtr functionName = nullptr;
@@ -2924,30 +7959,30 @@ public:
 	                vector<ASTNodePtr> args;
 
 	                // Parse arguments
-	                while (peek().type != "CLOSE_PAREN" &&
-	                       peek().type != "EOF")
+	                while (peek().type != TokenType::CLOSE_PAREN &&
+	                       peek().type != TokenType::END_OF_FILE)
 	                {
-	        		    while (peek().type == "NEWLINE") {
+	        		    while (peek().type == TokenType::NEWLINE) {
 	        		        advance();
 	        		    }
 	                    args.push_back(parseExpression());
-	            	    while (peek().type == "NEWLINE") {
+	            	    while (peek().type == TokenType::NEWLINE) {
 	            	        advance();
 	            	    }
-	                    if (match("COMMA")) {
+	                    if (match(TokenType::COMMA)) {
 	                        continue;
 	                    } else {
 	                        break;
 	                    }
-	        		    while (peek().type == "NEWLINE") {
+	        		    while (peek().type == TokenType::NEWLINE) {
 	        		        advance();
 	        		    }
 
 	                }
-	    		    while (peek().type == "NEWLINE") {
+	    		    while (peek().type == TokenType::NEWLINE) {
 	    		        advance();
 	    		    }
-	                if (!match("CLOSE_PAREN")) {
+	                if (!match(TokenType::CLOSE_PAREN)) {
 	                    syntaxError(peek(), "ขาด ) หลังการเรียก โปรแกรม");
 	                }
 
@@ -2977,15 +8012,15 @@ public:
 
 	        return base;
 	    }
-		 else if (peek().type =="CONVERTDATATYPE") {
+		 else if (peek().type ==TokenType::CONVERTDATATYPE) {
 			return parseConvertdataType();
-		} else if (peek().type == "NULL") {
+		} else if (peek().type == TokenType::NULL_VALUE) {
 			return parseNullLiteral();
 		}
 
 		stringstream ss;
-		ss << "คาดหวังนิพจน์แต่พบ '" << peek().value
-		   << "' (ชนิด: " << peek().type << ")";
+		ss << "คาดหวังนิพจน์แต่พบ '" << tokenText(peek())
+		   << "' (ชนิด: " << tokenTypeName(peek().type) << ")";
 		syntaxError(peek(), ss.str());
 		return nullptr;
 	}
@@ -2995,41 +8030,42 @@ public:
 	}
 	ASTNodePtr parseConvertdataType() {
 		Token t = peek();
-		if (!match("CONVERTDATATYPE")) {
+		if (!match(TokenType::CONVERTDATATYPE)) {
 			throw runtime_error("การเปลี่ยนชนิดข้อมูลผิดพลาด");
 		}
-		if (!match("OPEN_PAREN")) {
+		if (!match(TokenType::OPEN_PAREN)) {
 			syntaxError(peek(),"ต้องมี ( หลัง เปลี่ยนชนิดข้อมูล");
 		}
 		ASTNodePtr expr = parseExpression();
-		if (!match("COMMA")) {
+		if (!match(TokenType::COMMA)) {
 			syntaxError(peek(),"ขาด , ที่ เปลี่ยนชนิดข้อมูล");
 		}
-		static const set<string> validTypes = {"INTEGER", "FLOAT", "STRING",
-											   "BOOLLEAN"};
+		static const set<TokenType> validTypes = {
+			TokenType::INTEGER, TokenType::FLOAT, TokenType::STRING,
+			TokenType::BOOLLEAN};
 
 		Token typeToken = peek();
 		if (!validTypes.count(typeToken.type)) {
-			throw runtime_error("ชนิดข้อมูลไม่ถูกต้อง: " + typeToken.value +"การเปลี่ยนชนิดข้อมูลรอบรับแค่ จำนวนเต็ม ทศนิยม ข้อความ และ ค่าความจริง");
+			throw runtime_error("ชนิดข้อมูลไม่ถูกต้อง: " + tokenText(typeToken) +"การเปลี่ยนชนิดข้อมูลรอบรับแค่ จำนวนเต็ม ทศนิยม ข้อความ และ ค่าความจริง");
 		}
 		advance(); // Consume the
 																// type token
 
-		if (!match("CLOSE_PAREN")) {
+		if (!match(TokenType::CLOSE_PAREN)) {
 			syntaxError(
 				peek(),"ข้อผิดพลาด: ต้องการ ) ปิดการเปลี่ยนชนิดข้อมูล");
 		}
 
-		return make_shared<ConvertNode>(expr, typeToken.type, t);
+		return make_shared<ConvertNode>(expr, tokenTypeName(typeToken.type), t);
 	}
 	ASTNodePtr parseObjectAccess() {
 		auto object = parsepimary(); // Could be a variable or nested access
 		Token t = peek();
-		if (!match("DOT")) {
+		if (!match(TokenType::DOT)) {
 			syntaxError(peek(),"การเข้าถึง อ็อบเจกต์ต้องใช้ .");
 		}
 
-		if (peek().type != "STRING_VALUE") {
+		if (peek().type != TokenType::STRING_VALUE) {
 			syntaxError(peek(),"คีย์ต้องเป็น ข้อความ");
 		}
 		auto key = parseStringLiteral();
@@ -3040,11 +8076,11 @@ public:
 	ASTNodePtr parseArrayAccess() {
 		auto array = parsepimary(); // Could be a variable or nested access
 		Token t = peek();
-		if (!match("BRACKET_OPENING")) {
+		if (!match(TokenType::BRACKET_OPENING)) {
 			syntaxError(peek(),"การเข้าถึง ชุดข้อมูล ต้องใช้ [");
 		}
 		auto index = parseExpression();
-		if (!match("BRACKET_CLOSEING")) {
+		if (!match(TokenType::BRACKET_CLOSEING)) {
 			syntaxError(peek(), "ขาด ]");
 		}
 
@@ -3073,31 +8109,31 @@ public:
 
 	ASTNodePtr parseArrayLiteral() {
 		Token t = peek();
-		if (!match("BRACKET_OPENING")) {
+		if (!match(TokenType::BRACKET_OPENING)) {
 			syntaxError(peek(), "ขาดเครื่องหมาย [ ใน ชุดข้อมูล");
 		}
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 
 		vector<ASTNodePtr> element;
-		while (peek().type != "BRACKET_CLOSEING" &&
-			   peek().type != "EOF") {
-		    while (peek().type == "NEWLINE") {
+		while (peek().type != TokenType::BRACKET_CLOSEING &&
+			   peek().type != TokenType::END_OF_FILE) {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 			element.push_back(parseArrayElement());
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
-			if (!match("COMMA")) {
+			if (!match(TokenType::COMMA)) {
 				break;
 			}
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 		}
-		if (!match("BRACKET_CLOSEING")) {
+		if (!match(TokenType::BRACKET_CLOSEING)) {
 			syntaxError(peek(), "ขาดเครื่องหมาย ] ในชุดข้อมูล");
 		}
 
@@ -3125,146 +8161,146 @@ public:
 	}
 	ASTNodePtr parseObectLiteral() {
 	    Token t = peek();
-	    if (!match("OPEN_BRACKETS")) {
+	    if (!match(TokenType::OPEN_BRACKETS)) {
 	        syntaxError(peek(), "ขาดเครื่องหมาย { ใน อ็อบเจกต์");
 	    }
 
 	    vector<pair<ASTNodePtr, ASTNodePtr>> entrity;
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 
-	    while (peek().type != "CLOSE_BRACKETS" && peek().type != "EOF") {
-	        while (peek().type == "NEWLINE") {
+	    while (peek().type != TokenType::CLOSE_BRACKETS && peek().type != TokenType::END_OF_FILE) {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 
-	        if (peek().type == "CLOSE_BRACKETS") {
+	        if (peek().type == TokenType::CLOSE_BRACKETS) {
 	            break;
 	        }
 
 	        auto key = parseObjectKey();
 
-	        while (peek().type == "NEWLINE") {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 
-	        if (!match("COLON")) {
+	        if (!match(TokenType::COLON)) {
 	            syntaxError(peek(), "ขาดเครื่องหมาย : ใน อ็อบเจกต์");
 	        }
 
-	        while (peek().type == "NEWLINE") {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 	        auto value = parseArrayElement();
 	        entrity.emplace_back(key, value);
 
-	        while (peek().type == "NEWLINE") {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 
-	        if (peek().type == "CLOSE_BRACKETS") {
+	        if (peek().type == TokenType::CLOSE_BRACKETS) {
 	            break;
 	        }
 
-	        if (!match("COMMA")) {
+	        if (!match(TokenType::COMMA)) {
 
 	            break;
 	        }
 
-	        while (peek().type == "NEWLINE") {
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 
-	        if (peek().type == "CLOSE_BRACKETS") {
+	        if (peek().type == TokenType::CLOSE_BRACKETS) {
 	            break;
 	        }
 	    }
 
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 
-	    if (!match("CLOSE_BRACKETS")) {
+	    if (!match(TokenType::CLOSE_BRACKETS)) {
 	        syntaxError(peek(), "ขาดเครื่องหมาย } ใน อ็อบเจกต์");
 	    }
 
 	    return make_shared<ObjectLiteralNode>(entrity, t);
 	}
 	ASTNodePtr parseObjectKey() {
-		if (peek().type != "STRING_VALUE") {
+		if (peek().type != TokenType::STRING_VALUE) {
 			syntaxError(peek(), "คีย์ต้องเป็น ข้อความ");
 		}
 		return parseStringLiteral();
 	}
 	ASTNodePtr parseStringLiteral() {
 		Token t = peek();
-		if (peek().type !="STRING_VALUE") { // Add validation
+		if (peek().type !=TokenType::STRING_VALUE) { // Add validation
 			syntaxError(peek(), "ขาด ข้อความ");
 		}
-		Token token = advance();
-		return make_shared<StringNode>(token.value, t);
+		const Token &token = advance();
+		return make_shared<StringNode>(unescapeStringLiteral(token.value), t);
 	}
 	ASTNodePtr parseNullLiteral() {
 		Token t = peek();
-		if (peek().type != "NULL") { // Add validation
+		if (peek().type != TokenType::NULL_VALUE) { // Add validation
 			syntaxError(peek(), "ขาด ว่าง");
 		}
-		Token token = advance();
+		advance();
 		return make_shared<NullNode>(t);
 	}
 	ASTNodePtr parseIntLiteral() {
 		Token t = peek();
-		Token token = advance();
-		return make_shared<IntNode>(stoi(token.value), t);
+		const Token &token = advance();
+		return make_shared<IntNode>(stoi(string(token.value)), t);
 	}
 
 	ASTNodePtr parseFloatLiteral() {
 		Token t = peek();
-		Token token = advance();
-		return make_shared<FloatNode>(stod(token.value), t);
+		const Token &token = advance();
+		return make_shared<FloatNode>(stod(string(token.value)), t);
 	}
 
 	ASTNodePtr parseBooliteral() {
 		Token t = peek();
-		Token token = advance();
-		if (token.type != "TRUE_VALUE" && token.type != "FALSE_VALUE") {
+		const Token &token = advance();
+		if (token.type != TokenType::TRUE_VALUE && token.type != TokenType::FALSE_VALUE) {
 			syntaxError(peek(),
-						"ไม่มีค่าความจริง ชื่อ: " + token.type);
+						"ไม่มีค่าความจริง ชื่อ: " + tokenTypeName(token.type));
 		}
-		bool Boovalue = (token.type == "TRUE_VALUE" ? true : false);
+		bool Boovalue = (token.type == TokenType::TRUE_VALUE ? true : false);
 		return make_shared<BoolNode>(Boovalue, t);
 	}
 
 
 	ASTNodePtr parsevariable() {
 		Token t = peek();
-		string varname = advance().value;
+		string varname(advance().value);
 		return make_shared<VariableNode>(varname, t);
 	}
 
 	ASTNodePtr parsePrint() {
-		if (match("PRINT")) {
+		if (match(TokenType::PRINT)) {
 			Token t = peek();
-			if (match("OPEN_PAREN")) {
+			if (match(TokenType::OPEN_PAREN)) {
 				vector<ASTNodePtr> expressions;
-			    while (peek().type == "NEWLINE") {
+			    while (peek().type == TokenType::NEWLINE) {
 			        advance();
 			    }
 				// Parse first expression
 				expressions.push_back(parseExpression());
 
 				// Parse additional expressions
-				while (match("COMMA")) {
-				    while (peek().type == "NEWLINE") {
+				while (match(TokenType::COMMA)) {
+				    while (peek().type == TokenType::NEWLINE) {
 				        advance();
 				    }
 					expressions.push_back(parseExpression());
 				}
-			    while (peek().type == "NEWLINE") {
+			    while (peek().type == TokenType::NEWLINE) {
 			        advance();
 			    }
-				if (!match("CLOSE_PAREN"))
+				if (!match(TokenType::CLOSE_PAREN))
 					syntaxError(peek(), "ที่ แสดงผล ขาด )");
 
 
@@ -3276,41 +8312,41 @@ public:
 	ASTNodePtr parseForLoop() {
 	    Token t = peek();
 
-	    if (!match("FOR")) {
+	    if (!match(TokenType::FOR)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง สำหรับ");
 	    }
 
-	    if(peek().type != "IDENTIFIER") syntaxError(peek(), "ต้องมีการกำหนดตัวแปร");
+	    if(peek().type != TokenType::IDENTIFIER) syntaxError(peek(), "ต้องมีการกำหนดตัวแปร");
 	    ASTNodePtr var = parsevariable();
 
-	    if(!match("RANGE")) syntaxError(peek(), "ต้องมีคำว่า \"ในช่วง\"  ในการทำซ้า ");
+	    if(!match(TokenType::RANGE)) syntaxError(peek(), "ต้องมีคำว่า \"ในช่วง\"  ในการทำซ้า ");
 
-	    if (!match("OPEN_PAREN")) {
+	    if (!match(TokenType::OPEN_PAREN)) {
 	        syntaxError(peek(), "ต้องมี ( ที่ ทำซ้ำ");
 	    }
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 	    vector<ASTNodePtr>ran;
 
-	    while(peek().type != "CLOSE_PAREN"){
-	        while (peek().type == "NEWLINE") {
+	    while(peek().type != TokenType::CLOSE_PAREN){
+	        while (peek().type == TokenType::NEWLINE) {
 	            advance();
 	        }
 	    	ran.push_back(parseExpression());
-			if (!match("COMMA")) {
+			if (!match(TokenType::COMMA)) {
 				break;
 			}
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 	    }
 
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 
-	    if (!match("CLOSE_PAREN")) {
+	    if (!match(TokenType::CLOSE_PAREN)) {
 	        syntaxError(peek(), "ต้องมี ) ที่ ทำซ้ำ");
 	    }
 
@@ -3330,7 +8366,7 @@ public:
 	    	st2 = ran[1];
 	    	st3 = ran[2];
 	    }
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลังการวนซ้ำ");
 	    }
 
@@ -3338,7 +8374,7 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3349,28 +8385,28 @@ public:
 	ASTNodePtr parseWhileloop() {
 	    Token t = peek();
 
-	    if (!match("WHILE")) {
+	    if (!match(TokenType::WHILE)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง ขณะ");
 	    }
 
-	    if (!match("OPEN_PAREN")) {
+	    if (!match(TokenType::OPEN_PAREN)) {
 
 	    }
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 	    ASTNodePtr cond = nullptr;
-	    if (peek().type != "CLOSE_PAREN") {
+	    if (peek().type != TokenType::CLOSE_PAREN) {
 	        cond = parseExpression();
 	    }
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
-	    if (!match("CLOSE_PAREN")) {
+	    if (!match(TokenType::CLOSE_PAREN)) {
 
 	    }
 
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลังเงื่อนไข ขณะ");
 	    }
 
@@ -3378,7 +8414,7 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3388,11 +8424,11 @@ public:
 	}
 	ASTNodePtr parseDoWhile() {
 	    Token t = peek();
-	    if (!match("DO")) {
+	    if (!match(TokenType::DO)) {
 	        syntaxError(peek(), "ไม่พบ ทำ ใน ทำ..ขณะ");
 	    }
 
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลัง ทำ");
 	    }
 
@@ -3400,31 +8436,31 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
 
 	    expect_dedent();
 
-	    if (!match("WHILE")) {
+	    if (!match(TokenType::WHILE)) {
 	        syntaxError(peek(), "ไม่พบ ขณะ ใน ทำ..ขณะ");
 	    }
 
-	    if (!match("OPEN_PAREN")) {
+	    if (!match(TokenType::OPEN_PAREN)) {
 
 	    }
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 	    ASTNodePtr cond = nullptr;
-	    if (peek().type != "CLOSE_PAREN" && peek().type != "EOF") {
+	    if (peek().type != TokenType::CLOSE_PAREN && peek().type != TokenType::END_OF_FILE) {
 	        cond = parseExpression();
 	    }
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
-	    if (!match("CLOSE_PAREN")) {
+	    if (!match(TokenType::CLOSE_PAREN)) {
 
 	    }
 
@@ -3434,22 +8470,22 @@ public:
 	}
 	ASTNodePtr parseElif() {
 	    Token t = peek();
-	    if (!match("ELIF")) {
+	    if (!match(TokenType::ELIF)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง มิฉะนั้นถ้า");
 	    }
 
-	    if (!match("OPEN_PAREN")) {
+	    if (!match(TokenType::OPEN_PAREN)) {
 
 	    }
 	    ASTNodePtr cond = nullptr;
-	    if (peek().type != "CLOSE_PAREN") {
+	    if (peek().type != TokenType::CLOSE_PAREN) {
 	        cond = parseExpression();
 	    }
-	    if (!match("CLOSE_PAREN")) {
+	    if (!match(TokenType::CLOSE_PAREN)) {
 
 	    }
 
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลังเงื่อนไข");
 	    }
 
@@ -3457,8 +8493,8 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF" &&
-	           peek().type != "ELIF" && peek().type != "ELSE") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE &&
+	           peek().type != TokenType::ELIF && peek().type != TokenType::ELSE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3469,23 +8505,23 @@ public:
 
 	ASTNodePtr parseIf() {
 	    Token t = peek();
-	    if (!match("IF")) {
+	    if (!match(TokenType::IF)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง ถ้า");
 	    }
 
-	    if (!match("OPEN_PAREN")) {
+	    if (!match(TokenType::OPEN_PAREN)) {
 
 	    }
 	    ASTNodePtr cond = nullptr;
-	    if (peek().type != "CLOSE_PAREN") {
+	    if (peek().type != TokenType::CLOSE_PAREN) {
 	        cond = parseExpression();
 	    }
-	    if (!match("CLOSE_PAREN")) {
+	    if (!match(TokenType::CLOSE_PAREN)) {
 
 	    }
 
 	    // Expect colon and indented block
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลังเงื่อนไข");
 	    }
 
@@ -3493,8 +8529,8 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF" &&
-	           peek().type != "ELIF" && peek().type != "ELSE") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE &&
+	           peek().type != TokenType::ELIF && peek().type != TokenType::ELSE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3502,12 +8538,12 @@ public:
 	    expect_dedent();
 
 	    vector<ASTNodePtr> elifs;
-	    while (peek().type == "ELIF") {
+	    while (peek().type == TokenType::ELIF) {
 	        elifs.push_back(parseElif());
 	    }
 
 	    ASTNodePtr elsE = nullptr;
-	    if (peek().type == "ELSE") {
+	    if (peek().type == TokenType::ELSE) {
 	        elsE = parseElse();
 	    }
 
@@ -3515,11 +8551,11 @@ public:
 	}
 	ASTNodePtr parseElse() {
 	    Token t = peek();
-	    if (!match("ELSE")) {
+	    if (!match(TokenType::ELSE)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง มิฉะนั้น");
 	    }
 
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลัง มิฉะนั้น");
 	    }
 
@@ -3527,7 +8563,7 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3538,56 +8574,56 @@ public:
 
 	ASTNodePtr parseFunctionDef() {
 	    Token t = peek();
-	    if (!match("PROGRAM")) {
+	    if (!match(TokenType::PROGRAM)) {
 	        syntaxError(peek(), "ไม่พบคำสั่ง โปรแกรม");
 	    }
-		if (peek().type != "IDENTIFIER") {
+		if (peek().type != TokenType::IDENTIFIER) {
 			syntaxError(peek(),"ขาดชื่อ โปรแกรม ในการประกาศโปรแกรม");
 		}
-		string funcname = advance().value;
-		if (!match("OPEN_PAREN")) {
+		string funcname(advance().value);
+		if (!match(TokenType::OPEN_PAREN)) {
 			syntaxError(peek(), "ขาด ( ในการประกาศโปรแกรม");
 		}
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
 		vector<ASTNodePtr> pramas;
-		while (peek().type != "CLOSE_PAREN" &&
-			   peek().type != "EOF") {
+		while (peek().type != TokenType::CLOSE_PAREN &&
+			   peek().type != TokenType::END_OF_FILE) {
 			//pramas.push_back(parseVariableDecleartion());
 			Token t = peek();
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 			if (peek().type !=
-				"IDENTIFIER") {
+				TokenType::IDENTIFIER) {
 				syntaxError(peek(),"ไม่มีชื่อตัวแปร");
 			}
 			ASTNodePtr varname = parsevariable();
 			ASTNodePtr initialValue = nullptr;
 
-			if (peek().type =="EQUALSSIGN") {
+			if (peek().type ==TokenType::EQUALSSIGN) {
 				advance();
 				initialValue = parseExpression();
 			}
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 			pramas.push_back(make_shared<AssignmentNode>(varname, initialValue, t,true));
-			if (!match("COMMA")) {
+			if (!match(TokenType::COMMA)) {
 				break;
 			}
-		    while (peek().type == "NEWLINE") {
+		    while (peek().type == TokenType::NEWLINE) {
 		        advance();
 		    }
 		}
-	    while (peek().type == "NEWLINE") {
+	    while (peek().type == TokenType::NEWLINE) {
 	        advance();
 	    }
-		if (!match("CLOSE_PAREN")) {
+		if (!match(TokenType::CLOSE_PAREN)) {
 			syntaxError(peek(), "ขาด ( ในการประกาศโปรแกรม");
 		}
-	    if (!match("COLON")) {
+	    if (!match(TokenType::COLON)) {
 	        syntaxError(peek(), "ต้องการ : หลังพารามิเตอร์");
 	    }
 
@@ -3595,7 +8631,7 @@ public:
 	    expect_indent();
 
 	    vector<ASTNodePtr> body;
-	    while (peek().type != "DEDENT" && peek().type != "EOF") {
+	    while (peek().type != TokenType::DEDENT && peek().type != TokenType::END_OF_FILE) {
 	        body.push_back(parseStatement());
 	        skip_newlines();
 	    }
@@ -3605,10 +8641,10 @@ public:
 	}
 	ASTNodePtr parseInput() {
 		Token t = peek();
-		if (!match("INPUT")) {
+		if (!match(TokenType::INPUT)) {
 			syntaxError(peek(), "ขาด คำสั่ง รับข้อมูล");
 		}
-		if (peek().type != "IDENTIFIER") {
+		if (peek().type != TokenType::IDENTIFIER) {
 			syntaxError(peek(), "ขาดชื่อตัวแปร");
 		}
 		ASTNodePtr varname = parsevariable();
@@ -3617,7 +8653,7 @@ public:
 	}
 	ASTNodePtr parseReturn() {
 			Token t = peek();
-			if (!match("RETURN")) {
+			if (!match(TokenType::RETURN)) {
 				syntaxError(peek(), "ขาด คำสั่ง คืนค่า");
 			}
 			ASTNodePtr value = parseExpression();
@@ -3626,24 +8662,24 @@ public:
 		}
 	ASTNodePtr parseImport() {
 		Token t = peek();
-		if (!match("IMPORT")) {
+		if (!match(TokenType::IMPORT)) {
 			syntaxError(peek(), "ขาด คำสั่ง นำเข้า");
 		}
-		if (peek().type != "STRING_VALUE") {
+		if (peek().type != TokenType::STRING_VALUE) {
 			syntaxError(peek(), "ขาด ชื่อไฟล์");
 		}
-		string filename = advance().value;
-		if (!match("AS")) {
+		string filename = unescapeStringLiteral(advance().value);
+		if (!match(TokenType::AS)) {
 			syntaxError(peek(), "ขาด แทน");
 		}
-		string name = advance().value;
+		string name = tokenText(advance());
 
 		return make_shared<ImportNode>(filename, name, t);
 	}
 
 	ASTNodePtr parseExport() {
 		// ตรวจว่า token แรกต้องเป็น EXPORT
-		if (!match("EXPORT")) {
+		if (!match(TokenType::EXPORT)) {
 			syntaxError(peek(), "ขาด คำสั่ง ส่งออก");
 		}
 
@@ -3654,8 +8690,8 @@ public:
 			funcs.push_back(parseFunctionDef());
 
 			// ถ้ามี EXPORT อีก ต้อง match() ด้วยเพื่อขยับตำแหน่ง
-		} while (peek().type == "EXPORT" &&
-				 match("EXPORT"));
+		} while (peek().type == TokenType::EXPORT &&
+				 match(TokenType::EXPORT));
 
 		return make_shared<ExportNode>(funcs, t);
 	}
@@ -3663,49 +8699,49 @@ public:
 
 
 	ASTNodePtr parseStatement() {
-	    if (peek().type == "PROGRAM") {
+	    if (peek().type == TokenType::PROGRAM) {
 	        return parseFunctionDef();
-	    } else if (peek().type == "COMMENT") {
+	    } else if (peek().type == TokenType::COMMENT) {
 	        Token t = peek();
 	        advance();
-	        string commentText = tokens[pos - 1].value;
+	        string commentText(tokens[pos - 1].value);
 	        return make_shared<CommentNode>(commentText, t);
-	    } else if (peek().type == "EXITPROCESS") {
+	    } else if (peek().type == TokenType::EXITPROCESS) {
 	        Token t = peek();
 	        advance();
 
 	        return make_shared<ExitProcessNode>(t);
-	    } else if (peek().type == "INPUT") {
+	    } else if (peek().type == TokenType::INPUT) {
 	        return parseInput();
-	    } else if (peek().type == "PRINT") {
+	    } else if (peek().type == TokenType::PRINT) {
 	        return parsePrint();
-	    } else if (peek().type == "IF") {
+	    } else if (peek().type == TokenType::IF) {
 	        return parseIf();
-	    } else if (peek().type == "DO") {
+	    } else if (peek().type == TokenType::DO) {
 	        return parseDoWhile();
-	    } else if (peek().type == "WHILE") {
+	    } else if (peek().type == TokenType::WHILE) {
 	        return parseWhileloop();
-	    } else if (peek().type == "FOR") {
+	    } else if (peek().type == TokenType::FOR) {
 	        return parseForLoop();
-	    } else if (match("BREAK")) {
+	    } else if (match(TokenType::BREAK)) {
 	        Token t = tokens[pos - 1];
 
 	        return make_shared<BreakNode>(t);
-	    } else if (match("CONTINUE")) {
+	    } else if (match(TokenType::CONTINUE)) {
 	        Token t = tokens[pos - 1];
 
 	        return make_shared<ContinueNode>(t);
-	    } else if (peek().type == "ELIF") {
+	    } else if (peek().type == TokenType::ELIF) {
 	        return parseElif();
-	    } else if (peek().type == "ELSE") {
+	    } else if (peek().type == TokenType::ELSE) {
 	        return parseElse();
-	    } else if (peek().type == "RETURN") {
+	    } else if (peek().type == TokenType::RETURN) {
 	        return parseReturn();
-	    } else if (peek().type == "IMPORT") {
+	    } else if (peek().type == TokenType::IMPORT) {
 	        return parseImport();
-	    } else if (peek().type == "EXPORT") {
+	    } else if (peek().type == TokenType::EXPORT) {
 	        return parseExport();
-	    }else if (peek().type == "IDENTIFIER" || peek().type == "CONST") {
+	    }else if (peek().type == TokenType::IDENTIFIER || peek().type == TokenType::CONST) {
 	        // ใช้ parsepimary() ที่มีอยู่แล้วซึ่งจัดการ chain อยู่แล้ว
 	        ASTNodePtr expr = parseExpression();
 
@@ -3716,13 +8752,13 @@ public:
 	    skip_newlines();
 
 	    stringstream ss;
-	    ss << "คำสั่งไม่รู้จัก: '" << peek().value
-	       << "' (ชนิด: " << peek().type << ")";
+	    ss << "คำสั่งไม่รู้จัก: '" << tokenText(peek())
+	       << "' (ชนิด: " << tokenTypeName(peek().type) << ")";
 	    syntaxError(peek(), ss.str());
 	    return nullptr;
 	}
 };
-size_t count_utf8_chars(const string &str) {
+size_t count_utf8_chars(string_view str) {
 	size_t count = 0;
 	for (size_t i = 0; i < str.length();) {
 		unsigned char c = static_cast<unsigned char>(str[i]);
@@ -3760,89 +8796,213 @@ void update_counters(const string &str, size_t &line, size_t &col) {
 
 
 // command base
-vector<pair<string, string>> TokenPatterns = {
-    {"PROGRAM", "โปรแกรม"},
-    {"EXITPROCESS", "จบการทำงาน"},
-	{"OPEN_BRACKETS", "\\{"},
-	{"CLOSE_BRACKETS", "\\}"},
-    {"DECLARE", "ให้"},
-    {"INTEGER", "จำนวนเต็ม"},
-    {"FLOAT", "ทศนิยม"},
-    {"STRING", "ข้อความ"},
-    {"ARRAY", "ชุดข้อมูล"},
-    {"OBJECT", "อ็อบเจกต์"},
-    {"CONST", "ค่าคงที่"},
-    {"BOOLLEAN", "ค่าความจริง"},
-    {"NULL", "ว่าง"},
-    {"CONVERTDATATYPE", "เปลี่ยนชนิดข้อมูล"},
-    {"LENGTH", "ขนาด"},
-    {"POP", "ดึงออก"},
-    {"PUSH", "เพิ่ม"},
-    {"INSERT", "แทรก"},
-    {"ERASE", "ลบ"},
-    {"BE", "เป็น"},
-    {"ARROW", "->"},
-    {"EQUALSSIGN", "คือ"},
-    {"AS", "แทน"},
-    {"INCREMENT", "\\+\\+"},
-    {"ADDITION", "\\+"},
-    {"DECREMENT", "--"},
-    {"SUBTRACTION", "-"},
-    {"STRING_VALUE", R"("(?:[^"\\]|\\.)*")"},
-    {"FLOAT_VALUE", "-?\\d+\\.\\d+"},
-    {"INTEGER_VALUE", "-?\\d+"},
-    {"ROOT", "ราก"},
-    {"TRUE_VALUE", "จริง"},
-    {"FALSE_VALUE", "เท็จ"},
-    {"BRACKET_OPENING", "\\["},
-    {"BRACKET_CLOSEING", "\\]"},
-    {"EXPONENTIATION", "\\*\\*"},
-    {"MULTIPLICATION", "\\*"},
-    {"FLOORDIVISION", "//"},
-    {"DIVISION", "/"},
-    {"MODULAS", "%"},
-    {"SHIFT_LEFT", "<<"},
-    {"SHIFT_RIGHT", ">>"},
-    {"EQUALTO", "="},
-    {"NOTEQUAL", "!="},
-    {"GREATEROREQUAL", ">="},
-    {"LESSEROREQUAL", "<="},
-    {"LN", "ln"},
-    {"GREATER", ">"},
-    {"LESSER", "<"},
-    {"BITWISE_NOT", "!"},
-    {"BITWISE_AND", "&"},
-    {"BITWISE_OR", "\\|"},
-    {"NOT", "ไม่"},
-    {"OR", "หรือ"},
-    {"AND", "และ"},
-    {"XOR", "ซอร์"},
-    {"DOT", "\\."},
-    {"COMMA", ","},
-    {"INPUT", "รับ"},
-    {"PRINT", "แสดง"},
-    {"IF", "ถ้า"},
-    {"OPEN_PAREN", "\\("},
-    {"CLOSE_PAREN", "\\)"},
-    {"WHILE", "ขณะ"},
-    {"FOR", "สำหรับ"},
-	{"RANGE","ในช่วง"},
-    {"DO", "ทำ"},
-    {"IMPORT", "นำเข้า"},
-    {"EXPORT", "ส่งออก"},
-    {"BREAK", "ออก"},
-    {"CONTINUE", "ถัดไป"},
-    {"ELIF", "มิฉะนั้นถ้า"},
-    {"ELSE", "มิฉะนั้น"},
-    {"VOID", "เปล่า"},
-    {"RETURN", "คืนค่า"},
-    {"COLON", ":"},
-    {"IDENTIFIER", "[a-zA-Zก-๙_][a-zA-Zก-๙0-9_@$]*"},
-    {"NEWLINE", "\n"},
-    {"INDENT", "INDENT"},  // Virtual token
-    {"DEDENT", "DEDENT"}   // Virtual token
+// Token rules in match priority order: at each position the first rule that
+// matches wins, so keywords shadow identifiers that merely start with them.
+// Rules with an empty spelling are scanned by hand in lexer(), every other
+// spelling goes into the keyword trie. NEWLINE, INDENT and DEDENT are produced by the indentation
+// logic in lexer() and have no spelling.
+vector<pair<TokenType, string>> TokenPatterns = {
+    {TokenType::PROGRAM, "โปรแกรม"},
+    {TokenType::EXITPROCESS, "จบการทำงาน"},
+	{TokenType::OPEN_BRACKETS, "{"},
+	{TokenType::CLOSE_BRACKETS, "}"},
+    {TokenType::DECLARE, "ให้"},
+    {TokenType::INTEGER, "จำนวนเต็ม"},
+    {TokenType::FLOAT, "ทศนิยม"},
+    {TokenType::STRING, "ข้อความ"},
+    {TokenType::ARRAY, "ชุดข้อมูล"},
+    {TokenType::OBJECT, "อ็อบเจกต์"},
+    {TokenType::CONST, "ค่าคงที่"},
+    {TokenType::BOOLLEAN, "ค่าความจริง"},
+    {TokenType::NULL_VALUE, "ว่าง"},
+    {TokenType::CONVERTDATATYPE, "เปลี่ยนชนิดข้อมูล"},
+    {TokenType::LENGTH, "ขนาด"},
+    {TokenType::POP, "ดึงออก"},
+    {TokenType::PUSH, "เพิ่ม"},
+    {TokenType::INSERT, "แทรก"},
+    {TokenType::ERASE, "ลบ"},
+    {TokenType::BE, "เป็น"},
+    {TokenType::ARROW, "->"},
+    {TokenType::EQUALSSIGN, "คือ"},
+    {TokenType::AS, "แทน"},
+    {TokenType::INCREMENT, "++"},
+    {TokenType::ADDITION, "+"},
+    {TokenType::DECREMENT, "--"},
+    {TokenType::SUBTRACTION, "-"},
+    {TokenType::STRING_VALUE, ""},   // "..." with \ escapes
+    {TokenType::FLOAT_VALUE, ""},    // digits.digits
+    {TokenType::INTEGER_VALUE, ""},  // digits
+    {TokenType::ROOT, "ราก"},
+    {TokenType::TRUE_VALUE, "จริง"},
+    {TokenType::FALSE_VALUE, "เท็จ"},
+    {TokenType::BRACKET_OPENING, "["},
+    {TokenType::BRACKET_CLOSEING, "]"},
+    {TokenType::EXPONENTIATION, "**"},
+    {TokenType::MULTIPLICATION, "*"},
+    {TokenType::FLOORDIVISION, "//"},
+    {TokenType::DIVISION, "/"},
+    {TokenType::MODULAS, "%"},
+    {TokenType::SHIFT_LEFT, "<<"},
+    {TokenType::SHIFT_RIGHT, ">>"},
+    {TokenType::EQUALTO, "="},
+    {TokenType::NOTEQUAL, "!="},
+    {TokenType::GREATEROREQUAL, ">="},
+    {TokenType::LESSEROREQUAL, "<="},
+    {TokenType::LN, "ln"},
+    {TokenType::GREATER, ">"},
+    {TokenType::LESSER, "<"},
+    {TokenType::BITWISE_NOT, "!"},
+    {TokenType::BITWISE_AND, "&"},
+    {TokenType::BITWISE_OR, "|"},
+    {TokenType::NOT, "ไม่"},
+    {TokenType::OR, "หรือ"},
+    {TokenType::AND, "และ"},
+    {TokenType::XOR, "ซอร์"},
+    {TokenType::DOT, "."},
+    {TokenType::COMMA, ","},
+    {TokenType::INPUT, "รับ"},
+    {TokenType::PRINT, "แสดง"},
+    {TokenType::IF, "ถ้า"},
+    {TokenType::OPEN_PAREN, "("},
+    {TokenType::CLOSE_PAREN, ")"},
+    {TokenType::WHILE, "ขณะ"},
+    {TokenType::FOR, "สำหรับ"},
+	{TokenType::RANGE,"ในช่วง"},
+    {TokenType::DO, "ทำ"},
+    {TokenType::IMPORT, "นำเข้า"},
+    {TokenType::EXPORT, "ส่งออก"},
+    {TokenType::BREAK, "ออก"},
+    {TokenType::CONTINUE, "ถัดไป"},
+    {TokenType::ELIF, "มิฉะนั้นถ้า"},
+    {TokenType::ELSE, "มิฉะนั้น"},
+    {TokenType::VOID, "เปล่า"},
+    {TokenType::RETURN, "คืนค่า"},
+    {TokenType::COLON, ":"},
+    {TokenType::IDENTIFIER, ""}      // [a-zA-Z_ thai][a-zA-Z_ thai 0-9 @ $]*
+};
+
+// Byte-wise trie over the keyword spellings of TokenPatterns. Walking it once
+// from the current position yields every keyword that is a prefix of the
+// remaining input; the lexer keeps the one with the lowest rule index.
+class KeywordTrie {
+	struct TrieNode {
+		vector<pair<unsigned char, int>> next;
+		int rule = -1; // index in TokenPatterns of the keyword ending here
+	};
+	vector<TrieNode> nodes;
+
+public:
+	KeywordTrie() :
+		nodes(1) {}
+
+	void insert(const string &word, int rule) {
+		int cur = 0;
+		for (unsigned char c : word) {
+			int nxt = child(cur, c);
+			if (nxt < 0) {
+				nxt = static_cast<int>(nodes.size());
+				nodes[cur].next.push_back({c, nxt});
+				nodes.emplace_back();
+			}
+			cur = nxt;
+		}
+		if (nodes[cur].rule < 0) {
+			nodes[cur].rule = rule;
+		}
+	}
+
+	int child(int node, unsigned char c) const {
+		for (const auto &[ch, nxt] : nodes[node].next) {
+			if (ch == c) {
+				return nxt;
+			}
+		}
+		return -1;
+	}
+
+	int rule(int node) const { return nodes[node].rule; }
 };
 
+int tokenRuleIndex(TokenType type) {
+	for (size_t r = 0; r < TokenPatterns.size(); r++) {
+		if (TokenPatterns[r].first == type) {
+			return static_cast<int>(r);
+		}
+	}
+	return -1;
+}
+
+const KeywordTrie &keywordTrie() {
+	static const KeywordTrie trie = [] {
+		KeywordTrie t;
+		for (size_t r = 0; r < TokenPatterns.size(); r++) {
+			if (!TokenPatterns[r].second.empty()) {
+				t.insert(TokenPatterns[r].second, static_cast<int>(r));
+			}
+		}
+		return t;
+	}();
+	return trie;
+}
+
+// The identifier class was written as [a-zA-Zก-๙_] over UTF-8 bytes, which
+// the regex engine read as the byte range 0x81-0xE0 for the Thai part. Keep
+// exactly that set so identifiers split where they always did.
+bool isIdentifierStart(unsigned char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+		   (c >= 0x81 && c <= 0xE0);
+}
+
+bool isIdentifierPart(unsigned char c) {
+	return isIdentifierStart(c) || (c >= '0' && c <= '9') || c == '@' ||
+		   c == '$';
+}
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Length of the string literal starting at the quote in code[i], including
+// both quotes, or 0 if it is not terminated. An escape may not be followed by
+// a line break.
+size_t scanStringLiteral(const string &code, size_t i) {
+	size_t j = i + 1;
+	while (j < code.length()) {
+		char c = code[j];
+		if (c == '"') {
+			return j + 1 - i;
+		}
+		if (c == '\\') {
+			if (j + 1 >= code.length() || code[j + 1] == '\n' ||
+				code[j + 1] == '\r') {
+				return 0;
+			}
+			j += 2;
+		} else {
+			j++;
+		}
+	}
+	return 0;
+}
+
+string unescapeStringLiteral(string_view raw) {
+	string unescaped;
+	for (size_t j = 0; j < raw.length(); j++) {
+		if (raw[j] == '\\' && j + 1 < raw.length()) {
+			switch (raw[j + 1]) {
+				case 'n': unescaped += '\n'; break;
+				case 't': unescaped += '\t'; break;
+				case 'r': unescaped += '\r'; break;
+				case '"': unescaped += '"'; break;
+				case '\\': unescaped += '\\'; break;
+				default: unescaped += raw[j + 1];
+			}
+			j++;
+		} else {
+			unescaped += raw[j];
+		}
+	}
+	return unescaped;
+}
+
 vector<Token> lexer(const string &code) {
     vector<Token> tokens;
     vector<int> indent_stack = {0}; // Track indentation levels
@@ -3877,11 +9037,11 @@ vector<Token> lexer(const string &code) {
             // Handle indentation changes
             if (current_indent > indent_stack.back()) {
                 indent_stack.push_back(current_indent);
-                tokens.push_back({"INDENT", "", current_line, current_col});
+                tokens.push_back({TokenType::INDENT, current_line, current_col, ""});
             } else if (current_indent < indent_stack.back()) {
                 while (current_indent < indent_stack.back()) {
                     indent_stack.pop_back();
-                    tokens.push_back({"DEDENT", "", current_line, current_col});
+                    tokens.push_back({TokenType::DEDENT, current_line, current_col, ""});
                 }
                 if (current_indent != indent_stack.back()) {
                     lexerError(current_line, current_col,
@@ -3896,9 +9056,11 @@ vector<Token> lexer(const string &code) {
         // Handle newline
         if (code[i] == '\n') {
             // Only add NEWLINE if the line wasn't empty
-            if (!tokens.empty() && tokens.back().type != "NEWLINE" &&
-                tokens.back().type != "INDENT" && tokens.back().type != "DEDENT") {
-                tokens.push_back({"NEWLINE", "\n", current_line, current_col});
+            if (!tokens.empty() && tokens.back().type != TokenType::NEWLINE &&
+                tokens.back().type != TokenType::INDENT &&
+                tokens.back().type != TokenType::DEDENT) {
+                tokens.push_back({TokenType::NEWLINE, current_line, current_col,
+                                  string_view(code).substr(i, 1)});
             }
             i++;
             current_line++;
@@ -3934,51 +9096,72 @@ vector<Token> lexer(const string &code) {
         }
 
 
-        // Try to match tokens
-        bool matched = false;
-        string remaining = code.substr(i);
+        // Try to match tokens: one walk down the keyword trie, then the
+        // hand-scanned rules if they outrank the best keyword found.
+        static const KeywordTrie &trie = keywordTrie();
+        static const int stringRule = tokenRuleIndex(TokenType::STRING_VALUE);
+        static const int floatRule = tokenRuleIndex(TokenType::FLOAT_VALUE);
+        static const int integerRule = tokenRuleIndex(TokenType::INTEGER_VALUE);
+        static const int identifierRule = tokenRuleIndex(TokenType::IDENTIFIER);
+
+        int best = -1;
+        size_t best_len = 0;
+        int node = 0;
+        for (size_t j = i; j < code.length(); j++) {
+            node = trie.child(node, code[j]);
+            if (node < 0) break;
+            int rule = trie.rule(node);
+            if (rule >= 0 && (best < 0 || rule < best)) {
+                best = rule;
+                best_len = j + 1 - i;
+            }
+        }
 
-        for (const auto &[type, pattern] : TokenPatterns) {
-            // Skip NEWLINE, INDENT, DEDENT as they're virtual
-            if (type == "NEWLINE" || type == "INDENT" || type == "DEDENT")
-                continue;
+        auto outranks = [&](int rule) { return best < 0 || rule < best; };
+        if (code[i] == '"' && outranks(stringRule)) {
+            size_t len = scanStringLiteral(code, i);
+            if (len > 0) {
+                best = stringRule;
+                best_len = len;
+            }
+        } else if (isDigit(code[i]) && outranks(floatRule)) {
+            size_t j = i;
+            while (j < code.length() && isDigit(code[j])) j++;
+            best = integerRule;
+            if (j + 1 < code.length() && code[j] == '.' && isDigit(code[j + 1])) {
+                j++;
+                while (j < code.length() && isDigit(code[j])) j++;
+                best = floatRule;
+            }
+            best_len = j - i;
+        } else if (isIdentifierStart(code[i]) && outranks(identifierRule)) {
+            size_t j = i + 1;
+            while (j < code.length() && isIdentifierPart(code[j])) j++;
+            best = identifierRule;
+            best_len = j - i;
+        }
 
-            regex reg("^" + pattern);
-            smatch match;
-
-            if (regex_search(remaining, match, reg)) {
-                string token_value = match[0].str();
-
-                // Check if it's a string value and remove quotes
-                if (type == "STRING_VALUE") {
-                    token_value = token_value.substr(1, token_value.length() - 2);
-                    // Unescape string
-                    string unescaped;
-                    for (size_t j = 0; j < token_value.length(); j++) {
-                        if (token_value[j] == '\\' && j + 1 < token_value.length()) {
-                            switch (token_value[j + 1]) {
-                                case 'n': unescaped += '\n'; break;
-                                case 't': unescaped += '\t'; break;
-                                case 'r': unescaped += '\r'; break;
-                                case '"': unescaped += '"'; break;
-                                case '\\': unescaped += '\\'; break;
-                                default: unescaped += token_value[j + 1];
-                            }
-                            j++;
-                        } else {
-                            unescaped += token_value[j];
-                        }
-                    }
-                    token_value = unescaped;
-                }
+        bool matched = best >= 0;
+        if (matched) {
+            TokenType type = TokenPatterns[best].first;
+            string_view token_value = string_view(code).substr(i, best_len);
+
+            // String values keep their raw text without the quotes; the
+            // column still advances by the unescaped length.
+            size_t width;
+            if (best == stringRule) {
+                token_value = token_value.substr(1, token_value.length() - 2);
+                width = token_value.find('\\') == string_view::npos
+                            ? count_utf8_chars(token_value)
+                            : count_utf8_chars(unescapeStringLiteral(token_value));
+            } else {
+                width = count_utf8_chars(token_value);
+            }
 
-                tokens.push_back({type, token_value, current_line, current_col});
+            tokens.push_back({type, current_line, current_col, token_value});
 
-                i += match[0].length();
-                current_col += count_utf8_chars(token_value);
-                matched = true;
-                break;
-            }
+            i += best_len;
+            current_col += width;
         }
 
         if (!matched) {
@@ -4000,127 +9183,149 @@ vector<Token> lexer(const string &code) {
     // Add dedents at end of file
     while (indent_stack.size() > 1) {
         indent_stack.pop_back();
-        tokens.push_back({"DEDENT", "", current_line, current_col});
+        tokens.push_back({TokenType::DEDENT, current_line, current_col, ""});
     }
 
-    tokens.push_back({"EOF", "", current_line, current_col});
+    tokens.push_back({TokenType::END_OF_FILE, current_line, current_col, ""});
     return tokens;
 }
 
-Value evalFunctionFromParts(const vector<string> &params, const json &body,
-                            const vector<Value> &args) {
-    // Create new scope
-    env.push_back(unordered_map<string, EnvStruct>());
-
-    // Bind arguments to parameters
-    for (size_t i = 0; i < params.size(); i++) {
-        setvar(params[i], args[i], 0,0,false);
-    }
-
-    // Execute function body
-    Value result = nullptr;
-    try {
+Value evalFunctionFromParts(const functionDef &def, size_t argc) {
+    return callFunctionWith(def, argc, [](const vector<ExecNodePtr> &body) {
+        Value result = nullptr;
         for (const auto &stmt : body) {
-            Value tmp = evalStatement(stmt);
-            if (tmp) result = tmp;
+            Completion c = evalStatement(stmt.get());
+            if (c.flow == Flow::Return || c.flow == Flow::TailCall) {
+                return c;
+            }
+            if (c.value) result = std::move(c.value);
         }
-    } catch (const ReturnException &e) {
-        result = e.returnValue;
-    }
+        return Completion(std::move(result));
+    });
+}
 
-    // Clean up scope
-    env.pop_back();
-    return result;
+// entry: the program mmt was started on, not a module it imports
+void evalProgram(const ASTNodePtr &programAST, bool entry) {
+	runProgram(lowerNode(programAST), entry);
 }
 
-void evalProgram(const json &programAST) {
-	env.push_back({});
-	if (programAST["type"] != "Program") {
+void runProgram(ExecNodePtr lowered, bool entry) {
+	pushScope();
+	if (lowered->kind != ExecKind::Program) {
 		cerr << "AST ที่ส่งเข้า evalProgram ต้องเป็น Program node\n";
 		exit(1);
 	}
-
-	  json exprArray = programAST["statements"];
-	for (const auto &stmt : exprArray) {
-		evalStatement(stmt);
-	}
-
-	env.pop_back();
-}
-Value evalFunctionFromNode(const json &funcNode, const vector<Value> &args) {
-	// 1. ตรวจสอบว่าประเภทคือ functionDeclaretion
-	if (funcNode["type"] != "functionDeclaretion") {
-		cerr << "ไม่ใช่ฟังก์ชันที่สามารถเรียกได้" << "";
-		std::exit(1);
-	}
-
-	// 2. สร้าง Environment ใหม่
-	env.push_back({});
-
-	// 3. ผูก arguments กับ parameter
-	const auto &params = funcNode["parameter"];
-	if (params.size() != args.size()) {
-		cerr << "จำนวน arguments ไม่ตรงกับ parameter" << "";
-		std::exit(1);
-	}
-
-	for (size_t i = 0; i < params.size(); i++) {
-		string paramName = params[i]["variable"]["name"];
-		string paramType = params[i]["datatype"];
-		env.back()[paramName] = EnvStruct{args[i], false};
+	loadedPrograms.emplace_back(static_cast<ExecProgram *>(lowered.release()));
+	ExecProgram &program = *loadedPrograms.back();
+	if (runOptions.optLevel >= 1) {
+		if (entry) {
+			findReachableFunctions(program);
+		}
+		if (functionsPruned) {
+			dropUnreachableFunctions(program);
+		}
+		if (entry && runOptions.inlineSize > 0 && !runOptions.jit) {
+			inlineCalls(program);
+		}
+		foldProgram(program, entry);
+		if (entry) {
+			inferTypes(program);
+		}
+		optimizeIr(program, entry);
 	}
 
-	// 4. ประมวลผล statements
-	const auto &statements = funcNode["body"]["statements"];
-	for (const auto &stmt : statements) {
-		Value ret = evalStatement(stmt);
-		if (ret != nullptr) { // หาก return
-			env.pop_back();
-			return ret;
+	if (runOptions.useVM) {
+		runChunk(compileChunk(program.statements, false));
+	} else {
+		for (const auto &stmt : program.statements) {
+			evalStatement(stmt.get());
 		}
 	}
 
-	env.pop_back();
-	return make_shared<ValueHolder>(); // ถ้าไม่มี return ให้ส่ง null/monostate กลับ
+	popScope();
 }
 
 
 
-string ast_json(string content){
-			vector<Token> tokens = lexer(content);
+// The AST keeps string_views into content, so content must outlive it.
+ASTNodePtr parseProgram(const string &content) {
+	vector<Token> tokens = lexer(content);
+
+	// Parse tokens
+	Parser parser(tokens);
+	return parser.parse();
+}
 
-			// Parse tokens
-			Parser parser(tokens);
-			auto ast = parser.parse();
+string ast_json(const string &content){
+			auto ast = parseProgram(content);
 			// Get AST JSON string
 			string ast_json = ast->print();
 			return ast_json;
 }
-std::string sanitize_for_json(const std::string& input) {
-    std::string output;
-    for (char c : input) {
-        switch (c) {
-            case '\r': output += "\\r"; break;
-            case '\n': output += "\\n"; break;
-            case '\t': output += "\\t"; break;
-            default:   output += c;
-        }
+
+// The N of --name=N; prefix is the length of "--name=".
+size_t numericOption(const string &arg, size_t prefix) {
+    string value = arg.substr(prefix);
+    if (value.empty() || value.size() > 18 ||
+        value.find_first_not_of("0123456789") != string::npos) {
+        cerr << "Invalid value for " << arg.substr(0, prefix - 1) << ": " << value << "";
+        exit(1);
     }
-    return output;
+    return stoull(value);
 }
 
+#ifndef MMT_RUNTIME
 int main(int argc, char *argv[]) {
 
 	ios::sync_with_stdio(false);
 	cout.tie(nullptr);
+#ifdef _WIN32
     SetConsoleOutputCP(65001);
+#endif
+
+    // --options may appear anywhere; everything else is positional
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--vm") {
+            runOptions.useVM = true;
+        } else if (arg == "--jit") {
+            if (!jitSupported) {
+                cerr << "--jit needs Linux x86-64; running without it\n";
+            }
+            runOptions.jit = jitSupported;
+        } else if (arg == "--osr") {
+            runOptions.osr = true;
+        } else if (arg.rfind("--osr-threshold=", 0) == 0) {
+            runOptions.osrThreshold = static_cast<uint32_t>(
+                min<size_t>(max<size_t>(numericOption(arg, 16), 1), UINT32_MAX));
+        } else if (arg.rfind("--max-depth=", 0) == 0) {
+            maxCallDepth = numericOption(arg, 12);
+        } else if (arg.rfind("--opt=", 0) == 0) {
+            runOptions.optLevel = numericOption(arg, 6);
+        } else if (arg.rfind("--inline-size=", 0) == 0) {
+            runOptions.inlineSize = numericOption(arg, 14);
+        } else if (arg == "--report-types") {
+            runOptions.reportTypes = true;
+        } else if (arg == "--dump-ir") {
+            runOptions.dumpIr = true;
+        } else if (arg.rfind("--jit-threshold=", 0) == 0) {
+            runOptions.jitThreshold = static_cast<uint32_t>(
+                min<size_t>(max<size_t>(numericOption(arg, 16), 1), UINT32_MAX));
+        } else if (arg.rfind("--", 0) == 0) {
+            cerr << "Unknown option: " << arg << "";
+            exit(1);
+        } else {
+            args.push_back(arg);
+        }
+    }
 
-    if (argc < 2) {
-        cerr << "Usage: mmt <filename>.thl [target.json]\nor mmt <filename>.thl" << "";
+    if (args.empty()) {
+        cerr << "Usage: mmt [--vm] [--jit [--jit-threshold=N]] [--osr [--osr-threshold=N]] [--max-depth=N] [--opt=N [--inline-size=N] [--report-types] [--dump-ir]] <filename>.thl [target.json | target.cpp]\nor mmt <filename>.thl" << "";
         exit(1);
     }
 
-    string filename = argv[1];
+    string filename = args[0];
     string fileTarget;  // กำหนดค่าว่างก่อน
 
     // เช็คกรณี version command
@@ -4128,8 +9333,8 @@ int main(int argc, char *argv[]) {
         cout << "mmt version 1.0 Runes of Thai" << "";
         return 0;
     }
-    if (argc >= 3) {
-        fileTarget = argv[2];
+    if (args.size() >= 2) {
+        fileTarget = args[1];
     }
 
     fs::path filepath = fs::current_path() / filename;
@@ -4147,11 +9352,12 @@ int main(int argc, char *argv[]) {
     }
 
 
-    // กรณีมี fileTarget ให้ตรวจสอบนามสกุลต้องเป็น .json เท่านั้น
+    // กรณีมี fileTarget ให้ตรวจสอบนามสกุลต้องเป็น .json หรือ .cpp เท่านั้น
     if (!fileTarget.empty()) {
         fs::path filepathTarget = fs::current_path() / fileTarget;
-        if (filepathTarget.extension() != ".json") {
-            cerr << "ไฟล์เป้าหมายต้องเป็น .json เท่านั้น" << "";
+        if (filepathTarget.extension() != ".json" &&
+            filepathTarget.extension() != ".cpp") {
+            cerr << "ไฟล์เป้าหมายต้องเป็น .json หรือ .cpp เท่านั้น" << "";
             exit(1);
         }
     }
@@ -4183,16 +9389,17 @@ int main(int argc, char *argv[]) {
     }
 
     try {
-        string astText = ast_json(content);
-		//cout << astText<<"\n";
         if (fileTarget.empty()) {
-			astText = sanitize_for_json(astText);
-            json jsonWork = json::parse(astText);
-            evalProgram(jsonWork);
+            // hand the parsed tree straight to the evaluator; only the
+            // target.json mode needs the printed text
+            evalProgram(parseProgram(content), true);
 
         } else {
-            // กรณี argc == 3 และไฟล์เป้าหมาย .json
+            // กรณี argc == 3: .json เขียน AST, .cpp เขียนโปรแกรม C++
             fs::path filepathTarget = fs::current_path() / fileTarget;
+            string astText = filepathTarget.extension() == ".cpp"
+                                 ? emitCpp(parseProgram(content), filename)
+                                 : ast_json(content);
             fs::create_directories(filepathTarget.parent_path());
 
             ofstream ast_file(filepathTarget);
@@ -4212,6 +9419,7 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
+#endif
 
 /*
 this interpreter made by Mr.Phawat Matitham.
@@ -0,0 +1,1116 @@
+// The mmt runtime; see runtime.h.
+#include "runtime.h"
+
+const string &tokenTypeName(TokenType type) {
+	static const string names[] = {
+		"PROGRAM", "EXITPROCESS", "OPEN_BRACKETS", "CLOSE_BRACKETS", "DECLARE",
+		"INTEGER", "FLOAT", "STRING", "ARRAY", "OBJECT", "CONST", "BOOLLEAN", "NULL",
+		"CONVERTDATATYPE", "LENGTH", "POP", "PUSH", "INSERT", "ERASE", "BE", "ARROW",
+		"EQUALSSIGN", "AS", "INCREMENT", "ADDITION", "DECREMENT", "SUBTRACTION",
+		"STRING_VALUE", "FLOAT_VALUE", "INTEGER_VALUE", "ROOT", "TRUE_VALUE",
+		"FALSE_VALUE", "BRACKET_OPENING", "BRACKET_CLOSEING", "EXPONENTIATION",
+		"MULTIPLICATION", "FLOORDIVISION", "DIVISION", "MODULAS", "SHIFT_LEFT",
+		"SHIFT_RIGHT", "EQUALTO", "NOTEQUAL", "GREATEROREQUAL", "LESSEROREQUAL", "LN",
+		"GREATER", "LESSER", "BITWISE_NOT", "BITWISE_AND", "BITWISE_OR", "NOT", "OR",
+		"AND", "XOR", "DOT", "COMMA", "INPUT", "PRINT", "IF", "OPEN_PAREN",
+		"CLOSE_PAREN", "WHILE", "FOR", "RANGE", "DO", "IMPORT", "EXPORT", "BREAK",
+		"CONTINUE", "ELIF", "ELSE", "VOID", "RETURN", "COLON", "IDENTIFIER",
+		"NEWLINE", "INDENT", "DEDENT", "COMMENT", "EOF"
+	};
+	return names[static_cast<size_t>(type)];
+}
+
+bool operator==(const Value &a, const Value &b) {
+	if (a.type() != b.type()) {
+		return false;
+	}
+	switch (a.type()) {
+	case Value::Type::None:
+	case Value::Type::Null:
+		return true;
+	case Value::Type::Int:
+		return a.as<int>() == b.as<int>();
+	case Value::Type::Double:
+		return a.as<double>() == b.as<double>();
+	case Value::Type::Bool:
+		return a.as<bool>() == b.as<bool>();
+	case Value::Type::String:
+		return a.as<string>() == b.as<string>();
+	// arrays and objects are equal when they share storage, as copies of
+	// one do
+	case Value::Type::Array:
+		return &a.as<Value::ArraY>() == &b.as<Value::ArraY>();
+	default:
+		return &a.as<Value::ObjecT>() == &b.as<Value::ObjecT>();
+	}
+}
+
+string valueToString(const Value& val) {
+    return val.visit(overloaded{
+        [](int v) -> std::string { return std::to_string(v); },
+        [](double v) -> std::string { return std::to_string(v); },
+        [](const std::string& v) -> std::string { return "\"" + v + "\""; },
+        [](bool v) -> std::string { return v ? "true" : "false"; },
+        [](const ValueHolder::ArraY& vec) -> std::string {
+            std::string result = "[";
+            bool first = true;
+            for (const auto& item : vec) {
+                if (!first) result += ", ";
+                result += valueToString(item);
+                first = false;
+            }
+            result += "]";
+            return result;
+        },
+        [](const ValueHolder::ObjecT& obj) -> std::string {
+            std::string result = "{";
+            bool first = true;
+            for (const auto& [key, val] : obj) {
+                if (!first) result += ", ";
+                result += "\"" + key + "\": " + valueToString(val);
+                first = false;
+            }
+            result += "}";
+            return result;
+        },
+        [](std::monostate) -> std::string {
+            return "null";
+        }
+    });
+}
+
+unordered_map<string, unordered_map<string, functionDef>> importModules;
+unordered_map<string, functionDef> exportedFunctions;
+vector<EnvStruct> variables;
+vector<string> variableNames;
+unordered_map<string, int> variableSlots;
+vector<int> scopeSlots;
+vector<size_t> scopeStarts;
+unordered_map<string, functionDef> functionTable;
+size_t maxCallDepth = 100000;
+vector<Value> callArgs;
+size_t callDepth = 0;
+uint32_t moduleGeneration = 0;
+PendingTailCall tailCall;
+
+int variableSlot(const string &name) {
+	auto it = variableSlots.find(name);
+	if (it != variableSlots.end()) {
+		return it->second;
+	}
+	variables.emplace_back();
+	variableNames.push_back(name);
+	return variableSlots[name] = static_cast<int>(variables.size()) - 1;
+}
+
+[[noreturn]] void unknownExpression(int line, int column) {
+	cerr << "ไม่มี expression นี้ ที่ บรรทัด " << line
+		 << ", คอลัม์: " << column << "";
+	exit(1);
+}
+
+Value applyUnary(TokenType op, const Value &operand, int line, int column) {
+	switch (op) {
+	case TokenType::NOT:
+		if (operand.holds<bool>()) {
+			return Value(!operand.as<bool>());
+		} else if (operand.holds<int>()) {
+			return Value(!operand.as<int>());
+		} else if (operand.holds<double>()) {
+			return Value(!operand.as<double>());
+		}
+		cerr << "ไม่สามารถหา นิเสธของ " << valueToString(operand) << "";
+		exit(1);
+	case TokenType::BITWISE_NOT:
+		if (operand.holds<bool>()) {
+			return Value(~operand.as<bool>());
+		} else if (operand.holds<int>()) {
+			return Value(~operand.as<int>());
+		}
+		cerr << "ไม่สามารถ สลับบิต ของ " << valueToString(operand) << "";
+		exit(1);
+	case TokenType::INCREMENT: // stepValue stores the new value
+		if (operand.holds<int>()) {
+			return operand;
+		}
+		cerr << "ไม่สามารถ เพิ่มค่า ของ " << valueToString(operand) << "";
+		exit(1);
+	case TokenType::DECREMENT:
+		if (operand.holds<int>()) {
+			return operand;
+		}
+		cerr << "ไม่สามารถ ลดค่า ของ " << valueToString(operand) << "";
+		exit(1);
+	case TokenType::SUBTRACTION:
+		if (operand.holds<int>()) {
+			return Value(-(operand.as<int>()));
+		} else if (operand.holds<double>()) {
+			return Value(-operand.as<double>());
+		}
+		cerr << "ค่านี้ " << valueToString(operand) << "ไม่สามารถติดลบได้" << "";
+		exit(1);
+	default:
+		break;
+	}
+	unknownExpression(line, column);
+}
+
+Value naturalLog(const Value &val, int line, int column) {
+	if (val.holds<int>()) {
+		return Value(log(val.as<int>()));
+	} else if (val.holds<double>()) {
+		return Value(log(val.as<double>()));
+	}
+	cerr << "ไม่สามารถหาค่า ลอการิทึมธรรมชาติ ของ" << valueToString(val)
+		 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+		 << "";
+	unknownExpression(line, column);
+}
+
+Value convertValue(const string &typE, const Value &exp, int line, int column) {
+	if (typE == "INTEGER") {
+		if (exp.holds<string>()) {
+			return Value(stoi(exp.as<string>()));
+		} else if (exp.holds<bool>()) {
+			return Value((int)exp.as<bool>());
+		} else if (exp.holds<double>()) {
+			return Value(static_cast<int>(exp.as<double>()));
+		} else if (exp.holds<int>()) {
+			return Value(exp.as<int>());
+		}
+	} else if (typE == "FLOAT") {
+		if (exp.holds<string>()) {
+			return Value(stod(exp.as<string>()));
+		} else if (exp.holds<int>()) {
+			return Value(static_cast<double>(exp.as<int>()));
+		} else if (exp.holds<double>()) {
+			return Value(exp.as<double>());
+		}
+	} else if (typE == "STRING") {
+		if (exp.holds<int>()) {
+			return Value(to_string(exp.as<int>()));
+		} else if (exp.holds<double>()) {
+			return Value(to_string(exp.as<double>()));
+		} else if (exp.holds<string>()) {
+			return Value(exp.as<string>());
+		}
+	} else if (typE == "BOOLEAN") {
+		if (exp.holds<int>()) {
+			return Value(static_cast<bool>(exp.as<int>()));
+		} else if (exp.holds<bool>()) {
+			return Value(exp.as<bool>());
+		}
+	}
+
+	cerr << "ไม่สามารถแปลงเป็นชนิด: " << typE << " ที่บรรทัด: " << line
+		 << " คอลัมน์: " << column << "";
+	exit(1);
+}
+
+// computed key of o[k]; o.k uses the name directly
+string objectKeyOf(const Value &keyVal, int line, int column) {
+	if (!keyVal.holds<std::string>()) {
+		std::cerr << "ผิดพลาด: ออบเจ็ต คีย์ต้องเป็น ข้อความ ที่บรรทัด "
+				  << line << ", คอลัม์ " << column << "";
+		exit(1);
+	}
+	return keyVal.as<std::string>();
+}
+
+Value &objectField(const Value &obj, const string &key, int line, int column) {
+	if (!obj.holds<ValueHolder::ObjecT>()) {
+		std::cerr << "ผิดพลาด: ไม่สามารถเข้าถึง คีย์ '" << key
+				  << "' บน ออบเจกต์ที่ยังไม่ประกาศ ที่บรรทัด " << line
+				  << ", คอลัม์ " << column << "";
+		exit(1);
+	}
+
+	auto &objMap = obj.as<ValueHolder::ObjecT>();
+	auto it = objMap.find(key);
+	if (it == objMap.end()) {
+		std::cerr << "พิดพลาด: คีย์นี้ '" << key << "' ไม่พบใน ออบเจกต์ ที่บรรทัด "
+				  << line << ", คอลัม์ " << column << "";
+		exit(1);
+	}
+	return it->second;
+}
+
+Value getObjectField(const Value &obj, const string &key, int line, int column) {
+	return objectField(obj, key, line, column);
+}
+
+// position of a[i] in an array or string, after the checks a read does
+int checkedIndex(const Value &arrayVal, const Value &indexVal, int line,
+				 int column) {
+	int index;
+
+	if(indexVal.holds<int>() && indexVal.as<int>() >= 0){
+		index = indexVal.as<int>();
+	}else if(indexVal.holds<double>()){
+		double d = indexVal.as<double>();
+		if(d == static_cast<int>(d) && d>=0){
+			index = static_cast<int>(indexVal.as<double>());
+		}else{
+			cerr<<"ผิดพลาด: ไม่สามารถเข้นถึงชุดข้อมูลด้วย ดัชนีที่เป็นทศนิยม ที่ บรรทัด "
+				  << line << ", คอลัมน์ " << column <<"";
+			exit(1);
+		}
+	}else{
+		cerr<<"ผิดพลาด: ไม่สามารถเข้นถึงชุดข้อมูลด้วย ดัชนีที่ไม่ใช่ตัวเลข ที่ บรรทัด "
+			  << line << ", คอลัมน์ " << column <<"";
+	}
+
+	if (!(arrayVal.holds<ValueHolder::ArraY>() ||
+		  arrayVal.holds<std::string>())) {
+		std::cerr << "ผิดพลาด: ไม่สามารถเข้าถึงข้อมูลประเภทนี้ด้วยดัชนี ที่ บรรทัด "
+				  << line << ", คอลัมน์ " << column << "";
+		exit(1);
+	}
+
+	if (arrayVal.holds<ValueHolder::ArraY>()) {
+		auto &arr = arrayVal.as<ValueHolder::ArraY>();
+		if (index >= static_cast<int>(arr.size())) {
+			std::cerr << "ผิดพลาด : ดัชนีเกินขอบเขต ที่ บรรทัด "
+					  << line << ", คอลัมน์ " << column << "";
+			exit(1);
+		}
+		return index;
+	}
+	auto &arr = arrayVal.as<std::string>();
+	if (index >= static_cast<int>(arr.size())) {
+		std::cerr << "ผิดพลาด : ดัชนีเกินขอบเขต ที่ บรรทัด "
+				  << line << ", คอลัมน์ " << column << "";
+		exit(1);
+	}
+	return index;
+}
+
+Value getIndexed(const Value &arrayVal, const Value &indexVal, int line,
+				 int column) {
+	int index = checkedIndex(arrayVal, indexVal, line, column);
+	if (arrayVal.holds<ValueHolder::ArraY>()) {
+		return arrayVal.as<ValueHolder::ArraY>()[index];
+	}
+	return Value(std::string(1, arrayVal.as<std::string>()[index]));
+}
+
+// a[i] once optimizeIr proved i in bounds (ExecArrayAccess::inBounds): an
+// array needs no checks, anything else still gets them
+Value getInBounds(const Value &arrayVal, const Value &indexVal, int line,
+				  int column) {
+	if (arrayVal.holds<ValueHolder::ArraY>()) {
+		return arrayVal.as<ValueHolder::ArraY>()[indexVal.as<int>()];
+	}
+	return getIndexed(arrayVal, indexVal, line, column);
+}
+
+// ++ and -- give the old value and store the new one back into the variable,
+// element or field they were applied to. Anything else is a temporary and
+// only gets the type check.
+Value stepValue(TokenType op, Value &place, int line, int column) {
+	Value old = applyUnary(op, place, line, column);
+	place = Value(old.as<int>() + (op == TokenType::INCREMENT ? 1 : -1));
+	return old;
+}
+
+Value stepIndexed(TokenType op, const Value &arrayVal, const Value &indexVal,
+				  int line, int column) {
+	int index = checkedIndex(arrayVal, indexVal, line, column);
+	if (arrayVal.holds<ValueHolder::ArraY>()) {
+		return stepValue(op, arrayVal.as<ValueHolder::ArraY>()[index], line, column);
+	}
+	return applyUnary(op, Value(std::string(1, arrayVal.as<std::string>()[index])),
+					  line, column);
+}
+
+// ns is empty for a call to a function declared in this program; only
+// those calls have their argument count checked.
+const functionDef &findFunction(const string &ns, const string &funcname,
+								size_t argc, int line, int column) {
+	// เรียกจาก namespace
+	if (!ns.empty()) {
+		auto module = importModules.find(ns);
+		if (module == importModules.end()) {
+			cerr << "ไม่พบเนมสเปซ: \"" << ns << "\" ที่บรรทัด "
+				 << line << " คอลัมน์ " << column << "";
+			exit(1);
+		}
+		auto &functions = module->second;
+		auto it = functions.find(funcname);
+		if (it == functions.end()) {
+			cerr << "โปรแกรม \"" << funcname << "\" ไม่พบในเนมสเปซ \"" << ns
+				 << "\" ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+			exit(1);
+		}
+		return it->second;
+	}
+	// เรียกฟังก์ชันโลคัล
+	auto it = functionTable.find(funcname);
+	if (it == functionTable.end()) {
+		cerr << "โปรแกรม '" << funcname << "' ยังไม่ถูกประกาศ ที่บรรทัด "
+			 << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+	const functionDef &def = it->second;
+	if (argc != def.parameter.size()) {
+		cerr << "จำนวนอากิวเมนต์ไม่ตรงกัน สำหรับ '" << funcname << "' ต้องการ "
+			 << def.parameter.size() << ", ได้รับ " << argc
+			 << " ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+	return def;
+}
+
+const functionDef &resolveCall(CallCache &cache, const string &ns,
+							   const string &funcname, size_t argc, int line,
+							   int column) {
+	if (cache.def && cache.def->body == cache.body &&
+		cache.def->native == cache.native && cache.generation == moduleGeneration) {
+		return *cache.def;
+	}
+	const functionDef &def = findFunction(ns, funcname, argc, line, column);
+	cache = {&def, def.body, def.native, moduleGeneration};
+	return def;
+}
+
+Value lengthOf(const Value &target, int line, int column) {
+	if (target.holds<ValueHolder::ArraY>()) {
+		return Value(static_cast<int>(target.as<ValueHolder::ArraY>().size()));
+	} else if (target.holds<ValueHolder::ObjecT>()) {
+		return Value(static_cast<int>(target.as<ValueHolder::ObjecT>().size()));
+	} else if (target.holds<string>()) {
+		return Value(static_cast<int>(target.as<string>().size()));
+	}
+	std::cerr << "เกิดข้อพิดพลาด: ขนาด() ไม่รองรับข้อมูลประเภทนี้ ที่บรรทัด : "
+			  << line << ", คอลัม์: " << column << "";
+	exit(1);
+}
+
+// key of an object literal entry, reported at the key's own position
+string literalKeyOf(const Value &keyVal, int line, int column) {
+	if (!keyVal.holds<string>()) {
+		cerr << "ผิดพลาด: คีย์ในออบเจ็กต์ต้องเป็นข้อความ ที่บรรทัด: "
+			 << line
+			 << " คอลัมน์: " << column << "";
+		std::exit(1);
+	}
+	return keyVal.as<string>();
+}
+
+// Shared by the tree walker and the bytecode VM; both evaluate the operands
+// first and land here with the node position for error messages.
+Value applyBinary(TokenType op, const Value &left, const Value &right,
+				  int line, int column) {
+	switch (op) {
+	case TokenType::EXPONENTIATION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+
+			return Value(pow(left.as<int>(), right.as<int>()));
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(pow(left.as<double>(), right.as<double>()));
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(pow(left.as<double>(), right.as<int>()));
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(pow(left.as<int>(), right.as<double>()));
+		}
+
+		cerr << "ไม่สามารถยกกำลัง " << valueToString(left) << " กับ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::ROOT: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(pow(right.as<int>(), 1.0 / left.as<int>()));
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(pow(right.as<double>(), 1.0 / left.as<double>()));
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(pow(right.as<double>(), 1.0 / left.as<int>()));
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(pow(right.as<double>(), 1.0 / left.as<int>()));
+		}
+
+		cerr << "ไม่สามารถถอดรากที่ " << valueToString(left) << " ของ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::MULTIPLICATION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() * right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() * right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() * right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() * right.as<int>());
+		}
+		cerr << "ไม่สามารถคูณ " << valueToString(left) << "กับ" << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+
+	}
+	case TokenType::DIVISION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(static_cast<double>(left.as<int>()) /
+						 static_cast<double>(right.as<int>()));
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() / right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() / right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() / right.as<int>());
+		}
+		cerr << "ไม่สามารถหาร " << valueToString(left) << "กับ" << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+
+	}
+	case TokenType::FLOORDIVISION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(floor(left.as<int>() / right.as<int>()));
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(floor(left.as<double>() / right.as<double>()));
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(floor(left.as<int>() / right.as<double>()));
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(floor(left.as<double>() / right.as<int>()));
+		}
+		cerr << "ไม่สามารถหารเอาส่วน " << valueToString(left) << "กับ" << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+
+	}
+	case TokenType::MODULAS: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() % right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(fmod(left.as<double>(), right.as<double>()));
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(
+				fmod(static_cast<double>(left.as<int>()),
+					 right.as<double>()));
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(
+				fmod(left.as<double>(),
+					 static_cast<double>(right.as<int>())));
+		}
+		cerr << "ไม่สามารถMOD " << valueToString(left) << "กับ" << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+
+	}
+	case TokenType::ADDITION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() + right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() + right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() + right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() + right.as<int>());
+		} else if (left.holds<string>() &&
+				   right.holds<string>()) {
+			return Value(left.as<string>() + right.as<string>());
+		} else if (left.holds<ValueHolder::ObjecT>() &&
+				   right.holds<ValueHolder::ObjecT>()) {
+			auto merged = left.as<ValueHolder::ObjecT>();
+			const auto &rightobj = right.as<ValueHolder::ObjecT>();
+			for (const auto &[k, v] : rightobj) {
+				merged[k] = v;
+			}
+			return Value(merged);
+		} else if (left.holds<ValueHolder::ArraY>() &&
+				   right.holds<ValueHolder::ArraY>()) {
+			auto merged = left.as<ValueHolder::ArraY>();
+			const auto &rightarr = right.as<ValueHolder::ArraY>();
+			merged.insert(merged.end(), rightarr.begin(), rightarr.end());
+			return Value(merged);
+		}
+
+		cerr << "ไม่สามารถบวก " << valueToString(left) << " กับ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::SUBTRACTION: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() - right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() - right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() - right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() - right.as<int>());
+		}
+		cerr << "ไม่สามารถลบ " << valueToString(left) << " กับ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::SHIFT_LEFT: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() << right.as<int>());
+		}
+		cerr << "ไม่สามารถ เลื่อนบิตของ " << valueToString(left) << " ไปทางซ้าย " << valueToString(right)
+			 << "ตำแหน่ง ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+	}
+	case TokenType::SHIFT_RIGHT: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() >> right.as<int>());
+		}
+		cerr << "ไม่สามารถ เลื่อนบิตของ " << valueToString(left) << " ไปทางซ้าย " << valueToString(right)
+			 << "ตำแหน่ง ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+	}
+	case TokenType::GREATER: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() > right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() > right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() > right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() > right.as<int>());
+		}
+		cerr << "ไม่สามารถเปรียบเทียบมากกว่า " << valueToString(left) << " กับ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::LESSER: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() < right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() < right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() < right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() < right.as<int>());
+		}
+		cerr << "ไม่สามารถเปรียบเทียบน้อยกว่า " << valueToString(left) << " กับ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::GREATEROREQUAL: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() >= right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() >= right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() >= right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() >= right.as<int>());
+		}
+		cerr << "ไม่สามารถเปรียบเทียบมากกว่าหรือเท่ากับ " << valueToString(left) << " กับ "
+			 << valueToString(right) << " ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+	}
+	case TokenType::LESSEROREQUAL: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() <= right.as<int>());
+		} else if (left.holds<double>() &&
+				   right.holds<double>()) {
+			return Value(left.as<double>() <= right.as<double>());
+		} else if (left.holds<int>() &&
+				   right.holds<double>()) {
+			return Value(left.as<int>() <= right.as<double>());
+		} else if (left.holds<double>() &&
+				   right.holds<int>()) {
+			return Value(left.as<double>() <= right.as<int>());
+		}
+		cerr << "ไม่สามารถเปรียบเทียบน้อยกว่าหรือเท่ากับ " << valueToString(left) << " กับ "
+			 << valueToString(right) << " ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+
+	}
+	case TokenType::EQUALTO: {
+		return Value(left == right);
+	}
+	case TokenType::NOTEQUAL: {
+		return Value(left != right);
+	}
+	case TokenType::BITWISE_AND: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() & right.as<int>());
+		} else if (left.holds<bool>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<bool>() & right.as<bool>());
+		} else if (left.holds<int>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<int>() & right.as<bool>());
+		} else if (left.holds<bool>() &&
+				   right.holds<int>()) {
+			return Value(left.as<bool>() & right.as<int>());
+		}
+		cerr << "ไม่สามารถใช้ ตัวนำเนินการ & กับ " << valueToString(left) << " และ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+
+	}
+	case TokenType::XOR: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() ^ right.as<int>());
+		} else if (left.holds<bool>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<bool>() ^ right.as<bool>());
+		} else if (left.holds<int>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<int>() ^ right.as<bool>());
+		} else if (left.holds<bool>() &&
+				   right.holds<int>()) {
+			return Value(left.as<bool>() ^ right.as<int>());
+		}
+		cerr << "ไม่สามารถใช้ ตัวนำเนินการ ซอร์ กับ " << valueToString(left) << " และ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::BITWISE_OR: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() | right.as<int>());
+		} else if (left.holds<bool>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<bool>() | right.as<bool>());
+		} else if (left.holds<int>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<int>() | right.as<bool>());
+		} else if (left.holds<bool>() &&
+				   right.holds<int>()) {
+			return Value(left.as<bool>() | right.as<int>());
+		}
+		cerr << "ไม่สามารถใช้ ตัวนำเนินการ | กับ " << valueToString(left) << " และ " << valueToString(right)
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+	case TokenType::AND: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() && right.as<int>());
+		} else if (left.holds<bool>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<bool>() && right.as<bool>());
+		} else if (left.holds<int>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<int>() && right.as<bool>());
+		} else if (left.holds<bool>() &&
+				   right.holds<int>()) {
+			return Value(left.as<bool>() && right.as<int>());
+		}
+		cerr << "ไม่สามารถใช้ ตัวนำเนินการ 'และ' กับ " << valueToString(left) << " และ "
+			 << valueToString(right) << " ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+	}
+	case TokenType::OR: {
+		if (left.holds<int>() &&
+			right.holds<int>()) {
+			return Value(left.as<int>() || right.as<int>());
+		} else if (left.holds<bool>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<bool>() || right.as<bool>());
+		} else if (left.holds<int>() &&
+				   right.holds<bool>()) {
+			return Value(left.as<int>() || right.as<bool>());
+		} else if (left.holds<bool>() &&
+				   right.holds<int>()) {
+			return Value(left.as<bool>() || right.as<int>());
+		}
+		cerr << "ไม่สามารถใช้ ตัวนำเนินการ 'หรือ' กับ " << valueToString(left) << " และ "
+			 << valueToString(right) << " ที่บรรทัด: " << line
+			 << " คอลัมน์: " << column << "";
+		exit(1);
+	}
+	default:
+		break;
+	}
+	unknownExpression(line, column);
+}
+
+void printValue(const Value &val) {
+	struct {
+		void operator()(std::monostate) const { std::cout << "ว่าง"; }
+		void operator()(int v) const { std::cout << v; }
+		void operator()(double v) const { std::cout << v; }
+		void operator()(const std::string &v) const {
+			std::cout <<v;
+		}
+		void operator()(bool v) const { std::cout << (v ? "จริง" : "เท็จ"); }
+		void operator()(const ValueHolder::ArraY &arr) const {
+			std::cout << "[";
+			bool first = true;
+			for (const auto &e : arr) {
+				if (!first)
+					std::cout << ", ";
+				printValue(e); // เรียกซ้ำ
+				first = false;
+			}
+			std::cout << "]";
+		}
+		void operator()(const ValueHolder::ObjecT &obj) const {
+			std::cout << "{";
+			bool first = true;
+			for (const auto &[k, v] : obj) {
+				if (!first)
+					std::cout << ", ";
+				std::cout << '"' << k << "\": ";
+				printValue(v); // เรียกซ้ำ
+				first = false;
+			}
+			std::cout << "}";
+		}
+	} visitor;
+
+	val.visit(visitor);
+}
+// ออก/ถัดไป outside a loop and คืนค่า outside a โปรแกรม are marked when the
+// program is lowered and fail here when they are reached.
+[[noreturn]] void misplacedStatement(const char *keyword, const char *place,
+									 int line, int column) {
+	cerr << "ใช้คำสั่ง " << keyword << " นอก" << place << "ไม่ได้ ที่บรรทัด " << line
+		 << " คอลัมน์ " << column << "";
+	exit(1);
+}
+
+// Statement semantics shared by the tree walker and the bytecode VM. The
+// callers evaluate the operand expressions in source order first.
+
+void assignField(const Value &obj, const Value &key, const Value &val, int line,
+				 int column) {
+	if (!obj.holds<ValueHolder::ObjecT>()) {
+		cerr << "ค่าที่จะกำหนดไม่ใช่ ออบเจต์ ที่บรรทัด " << line
+			 << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+	obj.as<ValueHolder::ObjecT>()[key.as<string>()] = val;
+}
+
+void assignIndex(const Value &arr, const Value &indexVal, const Value &val,
+				 int line, int column) {
+	int index = indexVal.as<int>();
+	if (!arr.holds<ValueHolder::ArraY>()) {
+		cerr << "ค่าที่จะกำหนดไม่ใช่ ชุดข้อมูล ที่บรรทัด " << line
+			 << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+	auto &vec = arr.as<ValueHolder::ArraY>();
+	if (index < 0 || index >= static_cast<int>(vec.size())) {
+		cerr << "index ของ array เกินขอบเขต ที่บรรทัด " << line
+			 << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+	vec[index] = val;
+}
+
+void assignInBounds(const Value &arr, const Value &indexVal, const Value &val,
+					int line, int column) {
+	if (arr.holds<ValueHolder::ArraY>()) {
+		arr.as<ValueHolder::ArraY>()[indexVal.as<int>()] = val;
+		return;
+	}
+	assignIndex(arr, indexVal, val, line, column);
+}
+
+void pushItem(const Value &arrayVal, const Value &value, int line, int column) {
+	if(arrayVal.holds<ValueHolder::ArraY>()){
+		arrayVal.as<ValueHolder::ArraY>().push_back(value);
+	}
+	else if(arrayVal.holds<string>()){
+		arrayVal.as<string>() += value.as<string>();
+	}else{
+		cerr << "ไม่สามารถเพิ่มสมาชิกเข้า  ชุดข้อมูลได้"
+			 << " ได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ "
+			 << "ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+}
+
+void popItem(const Value &arrayVal, int line, int column) {
+	if(arrayVal.holds<ValueHolder::ArraY>()){
+	auto &arr = arrayVal.as<ValueHolder::ArraY>();
+	if (arr.empty()) {
+		cerr << "ไม่สามารถ ดึงข้อมูลออก จาก ชุดข้อมูล ที่ว่าง "
+			 << " ได้ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+
+	arr.pop_back();
+	}
+	else if(arrayVal.holds<string>()){
+		auto &arr = arrayVal.as<string>();
+		if (arr.empty()) {
+			cerr << "ไม่สามารถ ดึงข้อมูลออก จาก ข้อความ ที่ว่าง "
+				 << " ได้ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+			exit(1);
+		}
+
+		arr.pop_back();
+		}
+	else{
+		cerr << "ไม่สามารถลบสมาชิกนี้ได้ '"
+			 << " ได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ "
+			 << "ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+}
+
+void insertItem(const Value &arrayVal, const Value &indexVal,
+				const Value &valueToInsert, int line, int column) {
+	if (!indexVal.holds<int>()) {
+		cerr << "ดัชนี ต้องเป็นจำนวนเต็ม "
+			 << "ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+
+	int index = indexVal.as<int>();
+
+	if(arrayVal.holds<ValueHolder::ArraY>()){
+		auto &array = arrayVal.as<ValueHolder::ArraY>();
+		if (index < 0 || index > static_cast<int>(array.size())) {
+			cerr << "ดัชนี อยู่นอกขอบเขตของ ชุดข้อมูล ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+			exit(1);
+		}
+
+		array.insert(array.begin() + index, valueToInsert);
+	}else if (arrayVal.holds<string>()) {
+		auto &array = arrayVal.as<string>();
+
+		if (index < 0 || index > static_cast<int>(array.size())) {
+			cerr << "ดัชนีอยู่นอกขอบเขตของข้อความ ที่บรรทัด "
+			     << line << " คอลัมน์ " << column << "";
+			exit(1);
+		}
+
+		// ดึง string มา insert
+		const string &strToInsert = valueToInsert.as<string>();
+		array.insert(index, strToInsert);
+	}else{
+		cerr << "ไม่สามารถแทรกได้ เนื่องจากค่าไม่ใช่ชุดข้อมูล หรือ ข้อความ "
+			 << "ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+}
+
+void eraseItem(const Value &arrayVal, const Value &indexVal, int line,
+			   int column) {
+	int index;
+
+	if (!indexVal.holds<int>()) {
+		if (indexVal.holds<double>()) {
+			double b = indexVal.as<double>();
+			if (b != static_cast<int>(b)) {
+				cerr << "ดัชนีที่ต้องการลบจาก ชุดข้อมูล ต้องเป็นจำนวนเต็ม"
+					 << "ที่บรรทัด: " << line << " คอลัมน์: " << column
+					 << "";
+				exit(1);
+			}
+			index = static_cast<int>(b);
+		} else {
+			cerr << "ดัชนีที่ต้องการลบจาก ชุดข้อมูล ต้องเป็นจำนวนเต็ม"
+				 << "ที่บรรทัด: " << line << " คอลัมน์: " << column
+				 << "";
+			exit(1);
+		}
+	} else {
+		index = indexVal.as<int>();
+	}
+
+
+	if(arrayVal.holds<ValueHolder::ArraY>()){
+
+		auto &arr = arrayVal.as<ValueHolder::ArraY>();
+
+		if (index < 0 || index >= static_cast<int>(arr.size())) {
+			cerr << "ไม่สามารถลบ ดัชนี ที่อยู่นอกขอบเขต ชุดข้อมูล ได้ "
+				 << "ดัชนี: " << index << ", ขนาด ชุดข้อมูล: " << arr.size()
+				 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+				 << "";
+			exit(1);
+		}
+
+		arr.erase(arr.begin() + index);
+	}else if(arrayVal.holds<string>()){
+		auto &arr = arrayVal.as<string>();
+
+		if (index < 0 || index >= static_cast<int>(arr.size())) {
+			cerr << "ไม่สามารถลบ ดัชนี ที่อยู่นอกขอบเขต ชุดข้อมูล ได้ "
+				 << "ดัชนี: " << index << ", ขนาด ชุดข้อมูล: " << arr.size()
+				 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+				 << "";
+			exit(1);
+		}
+
+		arr.erase(index,1);
+	}else{
+		cerr << "ไม่สามารถลบสมาชิกได้ เนื่องจากไม่ใช่ชุดข้อมูล หรือ ข้อความ"
+			 << " ที่บรรทัด: " << line << " คอลัมน์: " << column
+			 << "";
+		exit(1);
+	}
+}
+
+// ฟังก์ชันแปลง Value เป็น double สำหรับลูป สำหรับ
+double loopNumber(const Value &v) {
+	if (v.holds<int>()) return v.as<int>();
+	else if (v.holds<double>()) return v.as<double>();
+	else {
+		cerr << "ในลูปต้องเป็นตัวเลข" << endl;
+		exit(1);
+	}
+}
+
+// The step keeps its type, so a loop whose start, stop and step are all int
+// never converts the counter to double.
+Value forLoopStep(const Value &stepVal, int line, int column) {
+	if (loopNumber(stepVal) == 0) {
+		cerr << "ขั้นตอนที่3ต้องไม่เป็นศูนย์ ที่บรรทัด " << line
+			 << " คอลัมน์ " << column << endl;
+		exit(1);
+	}
+	return stepVal;
+}
+
+// ฟังก์ชันตรวจสอบเงื่อนไข
+bool forLoopContinues(int varName, const Value &stopVal, const Value &stepVal,
+					  int line, int column) {
+	// ตัวนับเป็น int: เทียบกันตรงๆ ไม่ต้องคัดลอกหรือแปลงเป็น double
+	const Value &counter = variables[varName].value;
+	if (counter.holds<int>() && stopVal.holds<int>() && stepVal.holds<int>()) {
+		return stepVal.as<int>() > 0 ? counter.as<int>() < stopVal.as<int>()
+									 : counter.as<int>() > stopVal.as<int>();
+	}
+
+	Value cur = getVar(varName, line, column);
+	double current_val = loopNumber(cur);
+	double stop = loopNumber(stopVal);
+	if (loopNumber(stepVal) > 0) {
+		return current_val < stop;
+	} else {
+		return current_val > stop;
+	}
+}
+
+// อัปเดตค่าตัวแปรสำหรับรอบถัดไป (รักษา type เดิมถ้าเป็นไปได้)
+void forLoopAdvance(int varName, const Value &stepVal, int line, int column) {
+	// The loop's own assignment bound the counter and would have failed on a
+	// ค่าคงที่. Nothing inside the loop can close the scope holding that
+	// binding, so the update skips setvar's const check.
+	Value &counter = variables[varName].value;
+	if (counter.holds<int>() && stepVal.holds<int>()) {
+		long long next = (long long)counter.as<int>() + stepVal.as<int>();
+		if (next >= INT_MIN && next <= INT_MAX) {
+			counter = Value((int)next);
+			return;
+		}
+	}
+
+	Value cur = getVar(varName, line, column);
+	double step = loopNumber(stepVal);
+	double new_val = loopNumber(cur) + step;
+
+	Value newVal;
+	if (cur.holds<int>() && step == (int)step && new_val == (int)new_val) {
+		newVal = Value((int)new_val);
+	} else {
+		newVal = Value(new_val);
+	}
+	variables[varName].value = std::move(newVal);
+}
+
+Value callNative(const functionDef &def, size_t argc) {
+	// a body that is not native came from a module, which switched
+	// callFunction to the interpreter when it was imported
+	return callFunctionWith(def, argc, [](const vector<ExecNodePtr> &) -> Completion {
+		abort();
+	});
+}
+
+Value (*callFunction)(const functionDef &def, size_t argc) = callNative;
+
+functionDef nativeFunctionDef(const char *name, vector<int> parameter,
+							  Completion (*native)()) {
+	functionDef def;
+	def.name = name;
+	def.parameter = std::move(parameter);
+	def.native = native;
+	return def;
+}
+
+Value nativeCall(CallSite &site, int line, int column) {
+	const functionDef &def = resolveCall(site.cache, site.ns, site.name,
+										 site.argc, line, column);
+	enterCall(line, column);
+	Value ret = callFunction(def, site.argc);
+	callDepth--;
+	return ret;
+}
+
+// คืนค่า f(...) from generated code; see PendingTailCall
+Completion nativeTailCall(CallSite &site, int line, int column) {
+	tailCall.target = &resolveCall(site.cache, site.ns, site.name, site.argc,
+								   line, column);
+	tailCall.argc = site.argc;
+	return Flow::TailCall;
+}
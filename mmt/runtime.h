@@ -0,0 +1,531 @@
+// The mmt runtime
+//
+// What a .thl program needs while it runs, whichever way it is run: Value,
+// variables and scopes, the function table and calls, printing and the
+// built-in operations. The interpreter in compiler.cpp is built on it, and
+// the C++ that `mmt <file>.thl <target>.cpp` writes is compiled against this
+// header and linked with runtime.cpp alone.
+#ifndef MMT_RUNTIME_H
+#define MMT_RUNTIME_H
+
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+using namespace std;
+
+struct ValueHolder;
+
+// Token kinds. NULL and EOF are macros in the C headers, so those two
+// enumerators carry a suffix; tokenTypeName() still reports the old names.
+enum class TokenType : uint8_t {
+	PROGRAM, EXITPROCESS, OPEN_BRACKETS, CLOSE_BRACKETS, DECLARE, INTEGER, FLOAT,
+	STRING, ARRAY, OBJECT, CONST, BOOLLEAN, NULL_VALUE, CONVERTDATATYPE, LENGTH,
+	POP, PUSH, INSERT, ERASE, BE, ARROW, EQUALSSIGN, AS, INCREMENT, ADDITION,
+	DECREMENT, SUBTRACTION, STRING_VALUE, FLOAT_VALUE, INTEGER_VALUE, ROOT,
+	TRUE_VALUE, FALSE_VALUE, BRACKET_OPENING, BRACKET_CLOSEING, EXPONENTIATION,
+	MULTIPLICATION, FLOORDIVISION, DIVISION, MODULAS, SHIFT_LEFT, SHIFT_RIGHT,
+	EQUALTO, NOTEQUAL, GREATEROREQUAL, LESSEROREQUAL, LN, GREATER, LESSER,
+	BITWISE_NOT, BITWISE_AND, BITWISE_OR, NOT, OR, AND, XOR, DOT, COMMA, INPUT,
+	PRINT, IF, OPEN_PAREN, CLOSE_PAREN, WHILE, FOR, RANGE, DO, IMPORT, EXPORT,
+	BREAK, CONTINUE, ELIF, ELSE, VOID, RETURN, COLON, IDENTIFIER, NEWLINE, INDENT,
+	DEDENT, COMMENT, END_OF_FILE
+};
+
+const string &tokenTypeName(TokenType type);
+
+// Value
+//
+// int, double, bool and ว่าง are stored inline, so arithmetic and
+// comparisons never allocate. Strings, arrays and objects live in a
+// ValueHolder on the heap that every copy shares, which keeps เพิ่ม/แทรก/ลบ
+// and element assignment visible through all of them. The reference count
+// is not atomic; the interpreter runs on one thread. A default Value is "no
+// value", what a statement without a result returns, and tests false.
+// as<T>() on the wrong type throws bad_variant_access like std::get did,
+// with the same message (WrongValueType).
+class Value {
+public:
+	enum class Type : uint8_t {
+		None, Null, Int, Double, Bool, String, Array, Object
+	};
+	using ArraY = vector<Value>;
+	using ObjecT = unordered_map<string, Value>;
+
+	Value() = default;
+	Value(nullptr_t) {}
+	Value(monostate) : type_(Type::Null) {}
+	Value(int v) : type_(Type::Int), int_(v) {}
+	Value(double v) : type_(Type::Double), double_(v) {}
+	Value(bool v) : type_(Type::Bool), bool_(v) {}
+	Value(string v);
+	Value(const char *v) : Value(string(v)) {}
+	Value(ArraY v);
+	Value(ObjecT v);
+	Value(const Value &other) noexcept : type_(other.type_), bits_(other.bits_) {
+		retain();
+	}
+	Value(Value &&other) noexcept : type_(other.type_), bits_(other.bits_) {
+		other.type_ = Type::None;
+	}
+	Value &operator=(const Value &other) noexcept {
+		return *this = Value(other);
+	}
+	// other may live inside the array or object this value releases
+	Value &operator=(Value &&other) noexcept {
+		Type type = other.type_;
+		uint64_t bits = other.bits_;
+		other.type_ = Type::None;
+		release();
+		type_ = type;
+		bits_ = bits;
+		return *this;
+	}
+	~Value() { release(); }
+
+	explicit operator bool() const { return type_ != Type::None; }
+	Type type() const { return type_; }
+	// where the tag and the scalar payload sit, for the JIT's generated code
+	static size_t tagOffset() { return offsetof(Value, type_); }
+	static size_t payloadOffset() { return offsetof(Value, bits_); }
+
+	template <class T> bool holds() const;
+	// int, double and bool by value; string, ArraY and ObjecT by reference
+	template <class T> decltype(auto) as() const;
+	// as<int>() or as<double>() without the check, for a value whose type
+	// inferTypes proved
+	template <class T> T known() const;
+	// calls f with monostate, int, double, string, bool, ArraY or ObjecT
+	template <class F> decltype(auto) visit(F &&f) const;
+
+private:
+	bool onHeap() const { return type_ >= Type::String; }
+	void retain() const;
+	void release();
+
+	Type type_ = Type::None;
+	union {
+		uint64_t bits_ = 0;
+		int int_;
+		double double_;
+		bool bool_;
+		ValueHolder *heap_;
+	};
+};
+bool operator==(const Value &a, const Value &b);
+inline bool operator!=(const Value &a, const Value &b) { return !(a == b); }
+string valueToString(const Value& val); // ประกาศก่อน เพราะใช้แบบเรียกซ้ำได้
+
+struct ExecNode;
+using ExecNodePtr = unique_ptr<ExecNode>;
+struct Completion;
+
+struct functionDef {
+	string name;
+	vector<int> parameter; // variable slots
+	const vector<ExecNodePtr> *body = nullptr; // owned by a loaded program
+	Completion (*native)() = nullptr; // instead of body in C++ output
+	mutable uint32_t calls = 0; // counted for --jit
+};
+
+struct ValueHolder {
+	using ArraY = Value::ArraY;
+	using ObjecT = Value::ObjecT;
+	variant<string, ArraY, ObjecT> data;
+	uint32_t refs = 1;
+};
+
+inline Value::Value(string v) : type_(Type::String), heap_(new ValueHolder{std::move(v)}) {}
+inline Value::Value(ArraY v) : type_(Type::Array), heap_(new ValueHolder{std::move(v)}) {}
+inline Value::Value(ObjecT v) : type_(Type::Object), heap_(new ValueHolder{std::move(v)}) {}
+
+inline void Value::retain() const {
+	if (onHeap()) {
+		heap_->refs++;
+	}
+}
+
+inline void Value::release() {
+	if (onHeap() && --heap_->refs == 0) {
+		delete heap_;
+	}
+}
+
+template <class T> bool Value::holds() const {
+	if constexpr (is_same_v<T, monostate>) {
+		return type_ == Type::Null;
+	} else if constexpr (is_same_v<T, int>) {
+		return type_ == Type::Int;
+	} else if constexpr (is_same_v<T, double>) {
+		return type_ == Type::Double;
+	} else if constexpr (is_same_v<T, bool>) {
+		return type_ == Type::Bool;
+	} else if constexpr (is_same_v<T, string>) {
+		return type_ == Type::String;
+	} else if constexpr (is_same_v<T, ArraY>) {
+		return type_ == Type::Array;
+	} else {
+		static_assert(is_same_v<T, ObjecT>, "not a Value type");
+		return type_ == Type::Object;
+	}
+}
+
+// what std::get threw before, message and all, for the places that still
+// report it (an ถ้า condition that is not a bool, for one)
+struct WrongValueType : bad_variant_access {
+	const char *what() const noexcept override {
+		return "std::get: wrong index for variant";
+	}
+};
+
+template <class T> decltype(auto) Value::as() const {
+	if (!holds<T>()) {
+		throw WrongValueType();
+	}
+	if constexpr (is_same_v<T, int>) {
+		return int_;
+	} else if constexpr (is_same_v<T, double>) {
+		return double_;
+	} else if constexpr (is_same_v<T, bool>) {
+		return bool_;
+	} else {
+		return std::get<T>(heap_->data);
+	}
+}
+
+template <class T> T Value::known() const {
+	if constexpr (is_same_v<T, int>) {
+		return int_;
+	} else {
+		return double_;
+	}
+}
+
+template <class F> decltype(auto) Value::visit(F &&f) const {
+	switch (type_) {
+	case Type::Int:
+		return f(int_);
+	case Type::Double:
+		return f(double_);
+	case Type::Bool:
+		return f(bool_);
+	case Type::String:
+	case Type::Array:
+	case Type::Object:
+		return std::visit(f, heap_->data);
+	default: // a missing value prints like ว่าง
+		return f(monostate{});
+	}
+}
+
+struct EnvStruct {
+	Value value;
+	// std::string type;
+	bool isConst = false;
+	bool bound = false; // false until assigned and after its scope closes
+};
+
+template<class... Ts>
+struct overloaded : Ts... { using Ts::operator()...; };
+template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
+
+extern unordered_map<string, unordered_map<string, functionDef>> importModules;
+extern unordered_map<string, functionDef> exportedFunctions;
+// Variables
+//
+// Scoping is dynamic and a name is bound in at most one open scope: setvar
+// updates the existing binding wherever it is and only creates one, in the
+// innermost scope, when there is none. So every name gets a fixed slot in
+// `variables` when the program is lowered and the slot holds its current
+// binding; reads and writes are an index instead of a hash per scope level.
+// A scope only lists the slots it bound so closing it can release them.
+// Those lists share one stack, scopeSlots, and each open scope just records
+// where its part starts, so opening or closing a scope per loop iteration or
+// call reuses the same storage instead of allocating.
+extern vector<EnvStruct> variables;
+extern vector<string> variableNames;
+extern unordered_map<string, int> variableSlots;
+extern vector<int> scopeSlots;		// slots bound by the open scopes, innermost last
+extern vector<size_t> scopeStarts; // where each open scope begins in scopeSlots
+extern unordered_map<string, functionDef> functionTable;
+
+// --max-depth=N: how many .thl calls may be open at once. The VM keeps its
+// calls on the heap; the tree walker nests C++ frames and can run out of
+// native stack well before this.
+extern size_t maxCallDepth;
+
+inline bool getBool(Value val) {
+	if (!val) {
+		cerr << "ค่าที่ส่งมาตรวจสอบเป็น nullptr\n";
+		exit(1);
+	}
+
+	if (val.holds<bool>()) {
+		return val.as<bool>();
+	}
+
+	cerr << "ค่าที่ส่งมาตรวจสอบไม่ใช่ boolean\n";
+	exit(1);
+}
+
+int variableSlot(const string &name);
+
+inline void pushScope() {
+	scopeStarts.push_back(scopeSlots.size());
+}
+
+inline void popScope() {
+	size_t start = scopeStarts.back();
+	for (size_t i = start; i < scopeSlots.size(); i++) {
+		variables[scopeSlots[i]] = EnvStruct();
+	}
+	scopeSlots.resize(start);
+	scopeStarts.pop_back();
+}
+
+inline EnvStruct *lookvar(int slot, int line, int column) {
+	EnvStruct &var = variables[slot];
+	if (var.bound) {
+		return &var;
+	}
+	cerr << "ไม่พบตัวแปร " << variableNames[slot] << " ในขอบเขตนี้ ที่บรรทัด " << line
+		 << "คอลัม์" << column << "";
+	exit(1);
+}
+inline Value getVar(int slot, int line, int column) {
+    const EnvStruct &var = variables[slot];
+    if (var.bound) {
+        return var.value;
+    }
+
+    cerr << "ไม่พบตัวแปร " << variableNames[slot] << " ในขอบเขตนี้ ที่บรรทัด "
+         << line << " คอลัมน์ " << column << endl;
+    exit(1);
+}
+
+inline void setvar(int slot, Value val, int line, int column, bool isconst) {
+    EnvStruct &var = variables[slot];
+    if (var.bound) {
+        if (var.isConst) {
+            cerr << "ไม่สามารถเปลี่ยนแปลงค่าคงที่ " << variableNames[slot]
+                 << " ได้ ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+            std::exit(1);
+        }
+        var.value = std::move(val);  // อัปเดตค่าตัวแปร
+        return;
+    }
+
+    // Variable not bound, create it in the innermost scope
+    var = {std::move(val), isconst, true};
+    scopeSlots.push_back(slot);
+}
+
+// Callers leave the argc arguments on top of a value stack (callArgs for the
+// tree walker, vmStack for the VM). Once the callee's scope is open they are
+// moved from there into the parameters' slots and popped, so a call copies
+// no argument and, once the stack has grown, allocates nothing.
+extern vector<Value> callArgs;
+
+// .thl calls open in either engine; a tail call reuses its caller's.
+extern size_t callDepth;
+
+inline void enterCall(int line, int column) {
+	if (++callDepth > maxCallDepth) {
+		cerr << "เรียกโปรแกรมซ้อนกันเกิน " << maxCallDepth
+			 << " ชั้น ที่บรรทัด " << line << " คอลัมน์ " << column << "";
+		exit(1);
+	}
+}
+
+inline void bindParameters(const vector<int> &params, vector<Value> &stack,
+					size_t argc) {
+	Value *args = stack.data() + stack.size() - argc;
+	// namespaced calls are not arity-checked; extra arguments are dropped
+	size_t n = min(argc, params.size());
+	for (size_t i = 0; i < n; i++) {
+		setvar(params[i], std::move(args[i]), 0, 0, false);
+	}
+	stack.resize(stack.size() - argc);
+}
+
+// The function a call site resolved to last time. Redeclaring a function
+// overwrites its functionTable entry in place, so the entry is still the
+// right one to look at and the cache holds while that entry keeps the same
+// body, whose parameter count was already checked for this site. Importing
+// a namespace replaces its whole table instead, which moduleGeneration
+// counts.
+struct CallCache {
+	const functionDef *def = nullptr;
+	const vector<ExecNodePtr> *body = nullptr;
+	Completion (*native)() = nullptr;
+	uint32_t generation = 0;
+};
+extern uint32_t moduleGeneration;
+
+struct CallSite {
+	string name;
+	string ns;
+	int argc = 0;
+	mutable CallCache cache = {};
+};
+
+// How a statement finished. Return carries the returned value, and a Normal
+// statement can carry one too: a call, or an if that ran one (see
+// evalBranch). Loops and functions act on the flow and close the scopes they
+// opened on the way out.
+enum class Flow : uint8_t { Normal, Return, Break, Continue, TailCall };
+
+struct Completion {
+	Flow flow = Flow::Normal;
+	Value value;
+	Completion(nullptr_t = nullptr) {}
+	Completion(Value v) : value(std::move(v)) {}
+	Completion(Flow f, Value v = nullptr) : flow(f), value(std::move(v)) {}
+};
+
+// A TailCall completion is a return whose value comes from calling
+// tailCall.target with the tailCall.argc arguments left on top of callArgs.
+// Nothing runs between the caller's scopes closing and the callee's, so the
+// scopes stay open on the way out and the callee runs in the caller's frame
+// with all of them merged into it; see callFunctionWith().
+struct PendingTailCall {
+	const functionDef *target = nullptr;
+	size_t argc = 0;
+};
+extern PendingTailCall tailCall;
+
+// Built-in operations. Each takes the position of the node it runs for, for
+// its error messages.
+[[noreturn]] void unknownExpression(int line, int column);
+Value applyUnary(TokenType op, const Value &operand, int line, int column);
+Value applyBinary(TokenType op, const Value &left, const Value &right,
+				  int line, int column);
+Value naturalLog(const Value &val, int line, int column);
+Value convertValue(const string &typE, const Value &exp, int line, int column);
+string objectKeyOf(const Value &keyVal, int line, int column);
+string literalKeyOf(const Value &keyVal, int line, int column);
+Value &objectField(const Value &obj, const string &key, int line, int column);
+Value getObjectField(const Value &obj, const string &key, int line, int column);
+Value getIndexed(const Value &arrayVal, const Value &indexVal, int line,
+				 int column);
+Value getInBounds(const Value &arrayVal, const Value &indexVal, int line,
+				  int column);
+Value stepValue(TokenType op, Value &place, int line, int column);
+Value stepIndexed(TokenType op, const Value &arrayVal, const Value &indexVal,
+				  int line, int column);
+Value lengthOf(const Value &target, int line, int column);
+void printValue(const Value &val);
+[[noreturn]] void misplacedStatement(const char *keyword, const char *place,
+									 int line, int column);
+void assignField(const Value &obj, const Value &key, const Value &val, int line,
+				 int column);
+void assignIndex(const Value &arr, const Value &indexVal, const Value &val,
+				 int line, int column);
+void assignInBounds(const Value &arr, const Value &indexVal, const Value &val,
+					int line, int column);
+void pushItem(const Value &arrayVal, const Value &value, int line, int column);
+void popItem(const Value &arrayVal, int line, int column);
+void insertItem(const Value &arrayVal, const Value &indexVal,
+				const Value &valueToInsert, int line, int column);
+void eraseItem(const Value &arrayVal, const Value &indexVal, int line,
+			   int column);
+double loopNumber(const Value &v);
+Value forLoopStep(const Value &stepVal, int line, int column);
+bool forLoopContinues(int varName, const Value &stopVal, const Value &stepVal,
+					  int line, int column);
+void forLoopAdvance(int varName, const Value &stepVal, int line, int column);
+
+// Calls
+const functionDef &findFunction(const string &ns, const string &funcname,
+								size_t argc, int line, int column);
+const functionDef &resolveCall(CallCache &cache, const string &ns,
+							   const string &funcname, size_t argc, int line,
+							   int column);
+
+// Runs def on the argc arguments on top of callArgs and returns its result.
+// A native body is called directly; runBody runs any other and returns how
+// it finished, with the value of its last statement that had one when it
+// ran to the end. A TailCall goes on to tailCall.target in the same frame.
+template <class RunBody>
+Value callFunctionWith(const functionDef &def, size_t argc, RunBody runBody) {
+	// Create new scope and bind the arguments on top of callArgs
+	pushScope();
+	const size_t frame = scopeStarts.size();
+	bindParameters(def.parameter, callArgs, argc);
+
+	const functionDef *current = &def;
+	Value result = nullptr;
+	for (;;) {
+		// compiled by CppEmitter, a native body returns from inside loops
+		// without closing their scopes, which are closed below
+		Completion c = current->native ? current->native() : runBody(*current->body);
+		result = std::move(c.value);
+		if (c.flow != Flow::TailCall) {
+			break;
+		}
+		// คืนค่า f(...): run f here, in this frame, with the scopes still
+		// open on the way out merged into the function's own
+		scopeStarts.resize(frame);
+		bindParameters(tailCall.target->parameter, callArgs, tailCall.argc);
+		current = tailCall.target;
+		result = nullptr;
+	}
+
+	// Clean up scope, with any left open inside it
+	scopeStarts.resize(frame);
+	popScope();
+	return result;
+}
+
+// C++ output's own functions are all native. Until an imported module
+// brings in others, callNative runs calls from C++ output; importModule
+// then points callFunction at the interpreter's evalFunctionFromParts.
+Value callNative(const functionDef &def, size_t argc);
+extern Value (*callFunction)(const functionDef &def, size_t argc);
+
+functionDef nativeFunctionDef(const char *name, vector<int> parameter,
+							  Completion (*native)());
+Value nativeCall(CallSite &site, int line, int column);
+Completion nativeTailCall(CallSite &site, int line, int column);
+
+// applyBinary with the int cases of the common operators inlined
+template <TokenType op>
+inline Value nativeBinary(const Value &left, const Value &right, int line,
+						  int column) {
+	if constexpr (op == TokenType::ADDITION || op == TokenType::SUBTRACTION ||
+				  op == TokenType::MULTIPLICATION || op == TokenType::GREATER ||
+				  op == TokenType::LESSER || op == TokenType::GREATEROREQUAL ||
+				  op == TokenType::LESSEROREQUAL) {
+		if (left.holds<int>() && right.holds<int>()) {
+			int a = left.as<int>();
+			int b = right.as<int>();
+			switch (op) {
+			case TokenType::ADDITION: return Value(a + b);
+			case TokenType::SUBTRACTION: return Value(a - b);
+			case TokenType::MULTIPLICATION: return Value(a * b);
+			case TokenType::GREATER: return Value(a > b);
+			case TokenType::LESSER: return Value(a < b);
+			case TokenType::GREATEROREQUAL: return Value(a >= b);
+			default: return Value(a <= b);
+			}
+		}
+	}
+	return applyBinary(op, left, right, line, column);
+}
+
+// นำเข้า from C++ output. Modules are .json ASTs that the interpreter runs,
+// so a program that imports is linked with compiler.cpp as well, built with
+// MMT_RUNTIME to leave out its main().
+void importModule(const string &file, const string &name,
+				  const string &currentFilePath, int line, int column);
+
+#endif
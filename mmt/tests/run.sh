@@ -0,0 +1,20 @@
+#!/bin/sh
+# Runs every script here with each engine and compares what it prints with
+# the .expected file next to it.
+# usage: mmt/tests/run.sh path/to/mmt
+mmt=${1:?usage: $0 path/to/mmt}
+cd "$(dirname "$0")" || exit 1
+failed=0
+for script in *.thl; do
+	expected="${script%.thl}.expected"
+	for flags in "" "--vm" "--opt=0" "--jit --jit-threshold=1" \
+		"--osr --osr-threshold=1" "--osr --osr-threshold=2 --jit --jit-threshold=2"; do
+		# flags is split on purpose
+		if ! "$mmt" $flags "$script" 2>&1 | cmp -s - "$expected"; then
+			echo "FAIL $script $flags"
+			failed=1
+		fi
+	done
+done
+[ $failed = 0 ] && echo "all passed"
+exit $failed